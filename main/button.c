@@ -1,18 +1,28 @@
+#include "cat.h"
 #include "driver/gpio.h"
 #include "esp_log.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include "freertos/timers.h"
+#include "message.h"
 #include "morse.h"
 #include "pins.h"
 #include "tune.h"
 #include <stdio.h>
 
 #define LONG_PRESS_THRESHOLD_MS 500 // Threshold for long press in milliseconds
+#define CLICK_GAP_MS 400            // Quiet time that ends a series of short presses
+
+// Notification bits for button_task
+#define BUTTON_EDGE 0x01       // The button was pressed or released
+#define BUTTON_LONG_PRESS 0x02 // The long press timer ran out
 
 static const char *TAG = "BUTTON";
 
+static TaskHandle_t button_task_handle;
 static TimerHandle_t long_press_timer; // Timer to detect long press
+static TimerHandle_t click_timer;      // Timer to detect the end of a series of presses
+static int click_count = 0;            // Short presses in the current series
 static bool is_long_press = false;     // Flag to indicate a long press
 static tune_data_t tune_data;          // Data to store frequency and mode
 
@@ -20,25 +30,54 @@ static tune_data_t tune_data;          // Data to store frequency and mode
 static void IRAM_ATTR button_isr_handler(void *arg) {
     // Notify the task to handle the button press
     BaseType_t xHigherPriorityTaskWoken = pdFALSE;
-    xTaskNotifyFromISR((TaskHandle_t)arg, 0, eNoAction, &xHigherPriorityTaskWoken);
+    xTaskNotifyFromISR((TaskHandle_t)arg, BUTTON_EDGE, eSetBits, &xHigherPriorityTaskWoken);
 
     if (xHigherPriorityTaskWoken) {
         portYIELD_FROM_ISR();
     }
 }
 
-// Callback for the long press timer
+// Callback for the long press timer. Tuning takes CAT round trips, which must not hold up
+// the timer task, so it is left to button_task.
 static void long_press_timer_callback(TimerHandle_t xTimer) {
-    is_long_press = true;
-    ESP_LOGI(TAG, "Long press detected, starting tuning...");
-    tune_start(&tune_data); // Start tuning
+    xTaskNotify(button_task_handle, BUTTON_LONG_PRESS, eSetBits);
+}
+
+// Callback for the click timer: N short presses send memory MN
+static void click_timer_callback(TimerHandle_t xTimer) {
+    int memory = click_count;
+    click_count = 0;
+
+    if (memory > MESSAGE_COUNT) {
+        ESP_LOGW(TAG, "%d presses, no memory M%d", memory, memory);
+        return;
+    }
+
+    ESP_LOGI(TAG, "%d press(es), sending M%d...", memory, memory);
+    if (send_morse_code(memory - 1, false) != ESP_OK) {
+        ESP_LOGW(TAG, "Morse code queue full, message not sent");
+    }
 }
 
 // Task to handle the button press
 void button_task(void *arg) {
+    cat_register_client("button", CAT_PRIORITY_NORMAL); // tune_start() and tune_stop() run here
+
     while (1) {
-        // Wait for notification from the ISR
-        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        // Wait for notification from the ISR or the long press timer
+        uint32_t events;
+        xTaskNotifyWait(0, UINT32_MAX, &events, portMAX_DELAY);
+
+        // The timer may have run out just as the button came up; only a button still held
+        // starts tuning, and its release then stops it
+        if ((events & BUTTON_LONG_PRESS) && gpio_get_level(BUTTON_GPIO_PIN) == 0) {
+            is_long_press = true;
+            ESP_LOGI(TAG, "Long press detected, starting tuning...");
+            tune_start(&tune_data);
+        }
+        if (!(events & BUTTON_EDGE)) {
+            continue;
+        }
 
         // Check if the button is pressed
         if (gpio_get_level(BUTTON_GPIO_PIN) == 0) {
@@ -55,8 +94,16 @@ void button_task(void *arg) {
                 is_long_press = false;
             } else {
                 // If it was a short press, execute the momentary action
-                ESP_LOGI(TAG, "Button pressed momentarily, executing send_morse_code...");
-                send_morse_code();
+                morse_status_t morse_status;
+                morse_get_status(&morse_status);
+                if (morse_status.busy) {
+                    ESP_LOGI(TAG, "Button pressed momentarily while sending, aborting...");
+                    morse_abort();
+                } else {
+                    // Count presses; the memory is sent once the series ends
+                    click_count++;
+                    xTimerReset(click_timer, 0);
+                }
             }
         }
     }
@@ -74,9 +121,8 @@ void button_init(void) {
     };
     gpio_config(&io_conf);
 
-    // Create a task to handle the button press
-    TaskHandle_t button_task_handle;
-    xTaskCreate(button_task, "button_task", 2048, NULL, 10, &button_task_handle);
+    // Create a task to handle the button press; it also runs tuning, which needs the stack
+    xTaskCreate(button_task, "button_task", 3072, NULL, 10, &button_task_handle);
 
     // Install the ISR handler
     gpio_install_isr_service(0);
@@ -85,5 +131,8 @@ void button_init(void) {
     // Create the long press timer
     long_press_timer = xTimerCreate("long_press_timer", pdMS_TO_TICKS(LONG_PRESS_THRESHOLD_MS), pdFALSE, NULL, long_press_timer_callback);
 
+    // Create the click timer
+    click_timer = xTimerCreate("click_timer", pdMS_TO_TICKS(CLICK_GAP_MS), pdFALSE, NULL, click_timer_callback);
+
     ESP_LOGI(TAG, "Button initialized on GPIO %d", BUTTON_GPIO_PIN);
 }
@@ -1,58 +1,146 @@
 #include "cat.h"
+#include "cat_codec.h"
+#include "cat_sim.h"
 #include "driver/uart.h"
 #include "esp_log.h"
+#include "esp_timer.h"
 #include "freertos/queue.h"
+#include "freertos/semphr.h"
+#include "freertos/stream_buffer.h"
 #include "freertos/task.h"
+#include "config.h"
 #include "pins.h"
 #include "settings.h"
+#include "sdkconfig.h"
+#include <stdio.h>
 #include <string.h>
 
 #define TAG "UART"
 
+#ifndef CONFIG_RADIO_SIMULATOR
 static QueueHandle_t uart_queue;
-static QueueHandle_t data_queue;
-#define DATA_QUEUE_SIZE 1024
-#define RESPONSE_TIMEOUT_MS 1000
+#endif
+static StreamBufferHandle_t rx_stream;
+#define RX_STREAM_SIZE 1024
+#define RESPONSE_TIMEOUT_MS 1000 // Longest wait for a reply, and the timeout before any RTT sample
+#define MIN_TIMEOUT_MS 50        // Shortest timeout, whatever the measured RTT
+#define NO_REPLY_SETTLE_MS 20    // Time the radio is given to act on a command it does not answer
+#define RTT_TABLE_SIZE 8
+#define TEXT_TERMINATOR ';'
+#define BAUD_PROBE_FAILURES 3      // Timeouts in a row before the rate is searched for again
+#define BAUD_SEARCH_RETRY_MS 10000 // Pause after a search that found no radio
 
-// UART interrupt handler task
+static const int standard_baud_rates[] = {4800, 9600, 19200, 38400};
+
+// A task that talks to the radio. Each client queues into its own queue, so one busy
+// client cannot fill the slots another needs, and the CAT task, the only reader and
+// writer of the UART, picks the next request by priority and then round-robin.
+typedef struct {
+    TaskHandle_t task;
+    QueueHandle_t queue;
+    cat_client_stats_t stats;
+} cat_client_t;
+
+static cat_client_t clients[CAT_MAX_CLIENTS];
+static volatile int client_count = 0;
+static int other_client = 0; // Requests from tasks that never registered
+static int last_served[CAT_PRIORITY_COUNT];
+static portMUX_TYPE clients_lock = portMUX_INITIALIZER_UNLOCKED;
+static TaskHandle_t cat_task_handle = NULL;
+
+// Frames the radio sends on its own, e.g. FT-991A Auto Information. While a handler is
+// set, received data wakes the CAT task so they are parsed as they arrive.
+static cat_frame_handler_t unsolicited_handler = NULL;
+static char unsolicited_terminator;
+
+// Baud rate changes are applied by the CAT task between transactions, never mid-reply
+static volatile int pending_baud_rate = 0;
+static int current_baud_rate = 0;
+static uint32_t consecutive_timeouts = 0;
+static cat_probe_t baud_probe = NULL;
+static TaskHandle_t baud_task_handle = NULL;
+static int baud_client = -1;
+
+// Round-trip time per command, smoothed as TCP does (RFC 6298): the timeout is the mean
+// plus four deviations, so a healthy radio gets a timeout of tens of ms instead of a
+// second. Keyed by the two-letter text command or the binary opcode.
+typedef struct {
+    uint16_t key; // 0 = unused
+    bool sampled;
+    uint32_t srtt_us;
+    uint32_t rttvar_us;
+    uint32_t rto_us;
+    uint32_t last_rtt_us;
+    uint32_t samples;
+    uint32_t timeouts;
+} rtt_entry_t;
+
+static rtt_entry_t rtt_table[RTT_TABLE_SIZE];
+static int rtt_victim = 0;
+
+// After BAUD_PROBE_FAILURES timeouts in a row the radio counts as missing, and requests
+// fail at once instead of each waiting out a timeout. The baud task's probes still run
+// and clear it when the radio answers.
+static volatile bool radio_missing = false;
+
+// A session keeps other clients off the port between cat_begin() and cat_end(), so a
+// read-modify-write sequence is atomic. Only PTT may cut in.
+static SemaphoreHandle_t session_mutex = NULL;
+static volatile int session_client = -1;
+static int64_t session_start_us;
+
+// Bytes read from the stream past a terminator, kept for the next read
+static uint8_t carry[BUF_SIZE];
+static size_t carry_length = 0;
+
+static cat_stats_t stats;
+
+// Move received bytes into the stream buffer in one piece, so a whole response costs a
+// couple of kernel calls rather than two per byte
+static void receive_bytes(const uint8_t *data, size_t len) {
+    size_t sent = xStreamBufferSend(rx_stream, data, len, 0);
+    stats.rx_bytes += len;
+    stats.rx_chunks++;
+    if (sent < len) {
+        ESP_LOGE(TAG, "RX stream overflow, %d bytes dropped", len - sent);
+        stats.rx_dropped += len - sent;
+    }
+    if (unsolicited_handler != NULL && cat_task_handle != NULL) {
+        xTaskNotifyGive(cat_task_handle);
+    }
+}
+
+#ifndef CONFIG_RADIO_SIMULATOR
+// UART interrupt handler task. Each UART_DATA event goes to the receive path whole.
 static void uart_event_task(void *pvParameters) {
+    static uint8_t data[BUF_SIZE];
     uart_event_t event;
-    uint8_t *data = malloc(BUF_SIZE);
-    if (data == NULL) {
-        ESP_LOGE(TAG, "Failed to allocate memory for data buffer");
-        vTaskDelete(NULL);
-        return;
-    }
 
     while (1) {
         // Wait for UART events
         if (xQueueReceive(uart_queue, (void *)&event, portMAX_DELAY)) {
             switch (event.type) {
             case UART_DATA:
-                ESP_LOGI(TAG, "Data received: %d bytes", event.size);
-                if (event.size > BUF_SIZE) {
-                    ESP_LOGE(TAG, "Received data length exceeds buffer size");
-                    break;
-                }
-                int len = uart_read_bytes(UART_NUM, data, event.size, portMAX_DELAY);
+                ESP_LOGD(TAG, "Data received: %d bytes", event.size);
+                size_t size = event.size < sizeof(data) ? event.size : sizeof(data);
+                int len = uart_read_bytes(UART_NUM, data, size, portMAX_DELAY);
                 if (len > 0) {
-                    for (int i = 0; i < len; i++) {
-                        if (xQueueSend(data_queue, &data[i], portMAX_DELAY) != pdPASS) {
-                            ESP_LOGE(TAG, "Data queue overflow");
-                            break;
-                        }
-                    }
+                    receive_bytes(data, len);
                 }
                 break;
 
+            // Bytes were lost. The CAT task sees the overflow count move, drops the
+            // damaged reply and runs the request again.
             case UART_FIFO_OVF:
                 ESP_LOGW(TAG, "UART FIFO overflow");
+                stats.overflows++;
                 uart_flush_input(UART_NUM);
                 xQueueReset(uart_queue);
                 break;
 
             case UART_BUFFER_FULL:
                 ESP_LOGW(TAG, "UART buffer full");
+                stats.overflows++;
                 uart_flush_input(UART_NUM);
                 xQueueReset(uart_queue);
                 break;
@@ -71,20 +159,641 @@ static void uart_event_task(void *pvParameters) {
             }
         }
     }
+}
+#endif // CONFIG_RADIO_SIMULATOR
+
+// Send a CAT command
+static esp_err_t cat_send(const uint8_t *command, size_t command_size) {
+#ifdef CONFIG_RADIO_SIMULATOR
+    int bytes_written = cat_sim_write(command, command_size);
+#else
+    int bytes_written = uart_write_bytes(UART_NUM, (const char *)command, command_size);
+#endif
+    if (bytes_written < 0) {
+        ESP_LOGE(TAG, "Failed to write CAT command");
+        return ESP_FAIL;
+    }
+    if (bytes_written != command_size) {
+        ESP_LOGE(TAG, "Number of bytes written does not match command size: expected %d, got %d", command_size, bytes_written);
+        return ESP_FAIL;
+    }
+
+    ESP_LOGD(TAG, "CAT command sent");
+    return ESP_OK;
+}
+
+// Move up to `size` bytes into `buffer`, taking carried-over bytes first and then
+// whatever the stream has, waiting until `deadline` for at least one byte
+static size_t read_some(uint8_t *buffer, size_t size, TickType_t deadline) {
+    if (carry_length > 0) {
+        size_t n = carry_length < size ? carry_length : size;
+        memcpy(buffer, carry, n);
+        memmove(carry, carry + n, carry_length - n);
+        carry_length -= n;
+        return n;
+    }
+
+    // Signed, so a deadline already passed waits 0 whatever the timeout it came from
+    int32_t remaining = (int32_t)(deadline - xTaskGetTickCount());
+    TickType_t wait = remaining > 0 ? (TickType_t)remaining : 0;
+    stats.rx_reads++;
+    return xStreamBufferReceive(rx_stream, buffer, size, wait);
+}
+
+// Read a fixed-size reply
+static esp_err_t recv_fixed(uint8_t *response, size_t response_size, TickType_t deadline) {
+    size_t received = 0;
+
+    while (received < response_size) {
+        size_t n = read_some(response + received, response_size - received, deadline);
+        if (n == 0) {
+            return ESP_ERR_TIMEOUT;
+        }
+        received += n;
+    }
+    return ESP_OK;
+}
+
+// Read one frame up to and including the terminator and NUL-terminate it. Anything after
+// the terminator is kept for the next read.
+static esp_err_t recv_frame(uint8_t *response, size_t response_size, char terminator, size_t *length, TickType_t deadline) {
+    size_t received = 0;
+
+    while (received < response_size - 1) {
+        size_t n = read_some(response + received, response_size - 1 - received, deadline);
+        if (n == 0) {
+            // Keep the partial frame; the rest may still be on its way. The carry is
+            // empty here, as read_some() only waits on the stream once it has run dry.
+            memcpy(carry, response, received);
+            carry_length = received;
+            return ESP_ERR_TIMEOUT;
+        }
+
+        uint8_t *end = memchr(response + received, terminator, n);
+        received += n;
+        if (end != NULL) {
+            size_t used = end - response + 1;
+            size_t leftover = received - used;
+            memmove(carry + leftover, carry, carry_length); // Still in order ahead of older carry
+            memcpy(carry, response + used, leftover);
+            carry_length += leftover;
+            response[used] = '\0';
+            *length = used;
+            return ESP_OK;
+        }
+    }
+
+    ESP_LOGE(TAG, "Terminator not found in response");
+    return ESP_ERR_INVALID_SIZE;
+}
+
+// Hand every complete frame already received to the unsolicited handler. A partial
+// frame stays in the carry for the next call.
+static void dispatch_unsolicited(void) {
+    static uint8_t frame[CAT_RESPONSE_MAX_SIZE];
+    size_t length;
+
+    while (recv_frame(frame, sizeof(frame), unsolicited_terminator, &length, xTaskGetTickCount()) == ESP_OK) {
+        stats.unsolicited++;
+        radio_missing = false;
+        unsolicited_handler(frame, length);
+    }
+}
+
+// Clear out anything received before the command goes out, so whatever is read after
+// sending is ours: the tail of a reply that arrived after its request timed out, or
+// noise. With an unsolicited handler, complete frames are status from the radio and are
+// passed on instead, and a frame still arriving is left to finish ahead of the reply.
+static void discard_stale(void) {
+    uint8_t scratch[64];
+    size_t discarded = carry_length;
+    size_t n;
+
+    if (unsolicited_handler != NULL) {
+        dispatch_unsolicited();
+        return;
+    }
+
+    carry_length = 0;
+    while ((n = xStreamBufferReceive(rx_stream, scratch, sizeof(scratch), 0)) > 0) {
+        discarded += n;
+    }
+    if (discarded > 0) {
+        ESP_LOGW(TAG, "Discarded %u stale bytes", discarded);
+        stats.discarded += discarded;
+    }
+}
+
+static uint32_t elapsed_us(int64_t since_us, int64_t now_us) {
+    int64_t elapsed = now_us - since_us;
+    return elapsed > UINT32_MAX ? UINT32_MAX : (uint32_t)elapsed;
+}
+
+static uint16_t rtt_key(const cat_request_t *request) {
+    if (request->frame == CAT_FRAME_TERMINATED && request->command_size >= 2) {
+        return (uint16_t)(request->command[0] << 8 | request->command[1]);
+    }
+    return 0x8000 | request->command[request->command_size - 1]; // FT-857D opcode byte
+}
+
+static rtt_entry_t *rtt_entry(uint16_t key) {
+    for (int i = 0; i < RTT_TABLE_SIZE; i++) {
+        if (rtt_table[i].key == key) {
+            return &rtt_table[i];
+        }
+    }
+
+    rtt_entry_t *entry = &rtt_table[rtt_victim];
+    rtt_victim = (rtt_victim + 1) % RTT_TABLE_SIZE;
+    *entry = (rtt_entry_t){.key = key, .rto_us = RESPONSE_TIMEOUT_MS * 1000};
+    return entry;
+}
+
+static void rtt_sample(rtt_entry_t *entry, uint32_t rtt_us) {
+    if (!entry->sampled) {
+        entry->srtt_us = rtt_us;
+        entry->rttvar_us = rtt_us / 2;
+        entry->sampled = true;
+    } else {
+        uint32_t delta = rtt_us > entry->srtt_us ? rtt_us - entry->srtt_us : entry->srtt_us - rtt_us;
+        entry->rttvar_us = (3 * entry->rttvar_us + delta) / 4;
+        entry->srtt_us = (7 * entry->srtt_us + rtt_us) / 8;
+    }
+
+    uint32_t granularity_us = portTICK_PERIOD_MS * 1000;
+    uint32_t rto_us = entry->srtt_us + (4 * entry->rttvar_us > granularity_us ? 4 * entry->rttvar_us : granularity_us);
+    if (rto_us < MIN_TIMEOUT_MS * 1000) {
+        rto_us = MIN_TIMEOUT_MS * 1000;
+    } else if (rto_us > RESPONSE_TIMEOUT_MS * 1000) {
+        rto_us = RESPONSE_TIMEOUT_MS * 1000;
+    }
+    entry->rto_us = rto_us;
+    entry->last_rtt_us = rtt_us;
+    entry->samples++;
+}
+
+// A timeout doubles the command's timeout, up to the maximum, until it answers again
+static void rtt_backoff(rtt_entry_t *entry) {
+    entry->timeouts++;
+    entry->rto_us = entry->rto_us < RESPONSE_TIMEOUT_MS * 500 ? entry->rto_us * 2 : RESPONSE_TIMEOUT_MS * 1000;
+}
+
+// Drop everything received after an overflow; the reply in it is damaged
+static void resync(void) {
+    uint8_t scratch[64];
+    size_t n;
+
+    carry_length = 0;
+    while ((n = xStreamBufferReceive(rx_stream, scratch, sizeof(scratch), 0)) > 0) {
+        stats.discarded += n;
+    }
+    stats.resyncs++;
+    ESP_LOGW(TAG, "Resynchronized after overflow");
+}
+
+// Frame the reply to a command already sent. Terminated frames that do not start with
+// the command's match bytes (a late reply to an earlier command, unsolicited status) are
+// skipped, or passed to the unsolicited handler, until the right one arrives or the
+// deadline passes.
+static esp_err_t recv_reply(const cat_request_t *request, uint8_t *response, size_t *length, TickType_t deadline) {
+    esp_err_t err;
+
+    *length = 0;
+    if (request->frame == CAT_FRAME_FIXED) {
+        err = recv_fixed(response, request->response_size, deadline);
+        if (err == ESP_OK) {
+            *length = request->response_size;
+        }
+        return err;
+    }
+
+    while ((err = recv_frame(response, CAT_RESPONSE_MAX_SIZE, request->terminator, length, deadline)) == ESP_OK) {
+        if (*length == 2 && response[0] == '?') {
+            ESP_LOGE(TAG, "Command rejected: %.*s", request->command_size, request->command);
+            return ESP_ERR_INVALID_RESPONSE;
+        }
+        if (memcmp(response, request->command, request->match_size) == 0) {
+            return ESP_OK;
+        }
+        stats.unmatched++;
+        if (unsolicited_handler != NULL) {
+            stats.unsolicited++;
+            unsolicited_handler(response, *length);
+        } else {
+            ESP_LOGW(TAG, "Discarded unmatched frame: %s", response);
+        }
+    }
+    return err;
+}
+
+// Send one command and frame its reply
+static esp_err_t attempt_request(const cat_request_t *request, uint8_t *response, size_t *length, TickType_t timeout) {
+    *length = 0;
+    discard_stale();
+
+    esp_err_t err = cat_send(request->command, request->command_size);
+    if (err != ESP_OK || request->frame == CAT_FRAME_NONE) {
+        return err;
+    }
+    return recv_reply(request, response, length, xTaskGetTickCount() + timeout);
+}
+
+// The command's current timeout, or the longest one for a command never timed
+static TickType_t request_timeout(rtt_entry_t *entry) {
+    if (entry == NULL) {
+        return pdMS_TO_TICKS(RESPONSE_TIMEOUT_MS);
+    }
+    return pdMS_TO_TICKS((entry->rto_us + 999) / 1000) + 1; // +1: the first tick may be partial
+}
+
+// Count the outcome of a request. Timeouts back the command's timeout off and, after a
+// run of them, mark the radio missing; a reply clears both and, if `rtt_us` is not 0,
+// is a round-trip sample.
+static void note_result(esp_err_t err, rtt_entry_t *entry, uint32_t rtt_us) {
+    if (err == ESP_ERR_TIMEOUT) {
+        ESP_LOGE(TAG, "Timeout while reading response");
+        stats.timeouts++;
+        if (entry != NULL) {
+            rtt_backoff(entry);
+        }
+        if (++consecutive_timeouts == BAUD_PROBE_FAILURES) {
+            ESP_LOGW(TAG, "Radio not answering");
+            radio_missing = true;
+            if (baud_task_handle != NULL) {
+                xTaskNotifyGive(baud_task_handle); // The radio may have been set to another rate
+            }
+        }
+    } else if (err == ESP_OK) {
+        stats.responses++;
+        consecutive_timeouts = 0;
+        radio_missing = false;
+        if (entry != NULL && rtt_us != 0) {
+            rtt_sample(entry, rtt_us);
+        }
+    }
+}
+
+// While the radio is missing only the baud rate probe gets through, so callers fail at
+// once instead of each waiting out a timeout
+static bool fast_fail(const cat_request_t *request) {
+    if (radio_missing && request->client != baud_client && baud_task_handle != NULL) {
+        stats.fast_failures++;
+        return true;
+    }
+    return false;
+}
+
+// Run one request with the command's current timeout. A reply damaged by a UART
+// overflow is thrown away and the command sent once more; the retry is not timed, as
+// its RTT could belong to either attempt.
+static esp_err_t run_request(const cat_request_t *request, uint8_t *response, size_t *length) {
+    if (fast_fail(request)) {
+        *length = 0;
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    rtt_entry_t *entry = request->frame == CAT_FRAME_NONE ? NULL : rtt_entry(rtt_key(request));
+    TickType_t timeout = request_timeout(entry);
+
+    uint32_t overflows = stats.overflows;
+    int64_t start_us = esp_timer_get_time();
+    esp_err_t err = attempt_request(request, response, length, timeout);
+    bool timed = true;
+    if (stats.overflows != overflows) {
+        resync();
+        err = attempt_request(request, response, length, timeout);
+        timed = false;
+    }
+
+    note_result(err, entry, timed ? elapsed_us(start_us, esp_timer_get_time()) : 0);
+    return err;
+}
+
+// Switch the UART to a requested rate once the last command has left. Anything received
+// so far was clocked at the old rate and is dropped.
+static void apply_baud_rate(void) {
+    int rate = pending_baud_rate;
+    uint8_t scratch[64];
+
+    if (rate == 0) {
+        return;
+    }
+    pending_baud_rate = 0;
+    if (rate == current_baud_rate) {
+        return;
+    }
+
+#ifdef CONFIG_RADIO_SIMULATOR
+    cat_sim_wait_tx_done();
+    cat_sim_set_baud_rate(rate);
+    cat_sim_flush_input();
+#else
+    uart_wait_tx_done(UART_NUM, pdMS_TO_TICKS(RESPONSE_TIMEOUT_MS));
+    if (uart_set_baudrate(UART_NUM, rate) != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to set baud rate %d", rate);
+        return;
+    }
+    uart_flush_input(UART_NUM);
+#endif
+    carry_length = 0;
+    while (xStreamBufferReceive(rx_stream, scratch, sizeof(scratch), 0) > 0) {
+    }
+
+    current_baud_rate = rate;
+    stats.baud_rate = rate;
+    memset(rtt_table, 0, sizeof(rtt_table)); // Round trips measured at the old rate no longer apply
+    ESP_LOGI(TAG, "Baud rate set to %d", rate);
+}
+
+// Take the next request: highest priority first, and within a priority the client after
+// the one served last, so equal clients alternate however fast each of them queues
+static bool next_request(cat_request_t *request) {
+    int count = client_count;
+
+    for (int priority = CAT_PRIORITY_COUNT - 1; priority >= 0; priority--) {
+        for (int i = 1; i <= count; i++) {
+            int index = (last_served[priority] + i) % count;
+            cat_client_t *client = &clients[index];
+            if (client->stats.priority != priority || client->queue == NULL) {
+                continue;
+            }
+            if (session_client >= 0 && index != session_client && priority != CAT_PRIORITY_PTT) {
+                continue;
+            }
+            if (xQueueReceive(client->queue, request, 0) == pdTRUE) {
+                last_served[priority] = index;
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+// Account for a finished request and hand its result to the caller
+static void complete_request(const cat_request_t *request, esp_err_t result, const uint8_t *response, size_t length, int64_t start_us) {
+    cat_client_stats_t *client = &clients[request->client].stats;
+    uint32_t wait_us = elapsed_us(request->queued_us, start_us);
+    uint32_t hold_us = elapsed_us(start_us, esp_timer_get_time());
+
+    client->transactions++;
+    client->wait_us += wait_us;
+    client->hold_us += hold_us;
+    if (wait_us > client->max_wait_us) {
+        client->max_wait_us = wait_us;
+    }
+    if (hold_us > client->max_hold_us) {
+        client->max_hold_us = hold_us;
+    }
+
+    if (request->callback != NULL) {
+        request->callback(result, response, length, request->arg);
+    }
+}
+
+// True if a client other than `index` has a request waiting, or holds a session
+static bool others_waiting(int index) {
+    if (session_client >= 0 && session_client != index) {
+        return true;
+    }
+    for (int i = 0; i < client_count; i++) {
+        if (i != index && clients[i].queue != NULL && uxQueueMessagesWaiting(clients[i].queue) > 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// How long `size` bytes take on the line: a start bit, 8 data bits and a stop bit each
+static int64_t line_time_us(size_t size) {
+    return (int64_t)size * 10 * 1000000 / current_baud_rate;
+}
+
+// Run pipelined requests from one client with up to CAT_PIPELINE_DEPTH of them on the
+// wire: each command goes out as soon as it is queued, without waiting for the replies
+// ahead of it, so the line stays busy in both directions. This assumes the radio buffers
+// commands that arrive while it answers and answers them in order (see
+// CONFIG_CAT_PIPELINE_DEPTH). Each reply is framed against the oldest request in flight;
+// a command with no reply leaves the window once it has had time to cross the line and
+// be acted on, so a run of writes is held to the depth as well. After a timeout or an
+// overflow it is no longer known which reply is which, and the requests still in flight
+// fail with it. The pipeline drains as soon as another client is waiting.
+static void run_pipeline(const cat_request_t *first) {
+    static cat_request_t window[CAT_PIPELINE_DEPTH];
+    static uint8_t response[CAT_RESPONSE_MAX_SIZE];
+    int64_t sent_us[CAT_PIPELINE_DEPTH];
+    int64_t done_us[CAT_PIPELINE_DEPTH]; // When a command with no reply counts as taken
+    int64_t line_clear_us = 0;           // When the commands sent so far have all left
+    int head = 0;
+    int count = 0;
+    cat_client_t *client = &clients[first->client];
+    cat_request_t next = *first;
+    bool have_next = true;
+
+    if (fast_fail(first)) {
+        complete_request(first, ESP_ERR_INVALID_STATE, response, 0, esp_timer_get_time());
+        return;
+    }
+    discard_stale();
+
+    while (have_next || count > 0) {
+        // Fill the window
+        while (have_next && count < CAT_PIPELINE_DEPTH) {
+            int slot = (head + count) % CAT_PIPELINE_DEPTH;
+            window[slot] = next;
+            sent_us[slot] = esp_timer_get_time();
+            line_clear_us = (line_clear_us > sent_us[slot] ? line_clear_us : sent_us[slot]) + line_time_us(next.command_size);
+            done_us[slot] = line_clear_us + NO_REPLY_SETTLE_MS * 1000;
+            if (cat_send(next.command, next.command_size) != ESP_OK) {
+                complete_request(&next, ESP_FAIL, response, 0, sent_us[slot]);
+            } else {
+                count++;
+            }
+            have_next = !others_waiting(first->client) && xQueuePeek(client->queue, &next, 0) == pdTRUE &&
+                        next.pipelined && xQueueReceive(client->queue, &next, 0) == pdTRUE;
+        }
+        if (count == 0) {
+            continue;
+        }
+
+        // Frame the oldest reply
+        cat_request_t *request = &window[head];
+        rtt_entry_t *entry = request->frame == CAT_FRAME_NONE ? NULL : rtt_entry(rtt_key(request));
+        uint32_t overflows = stats.overflows;
+        size_t length = 0;
+        esp_err_t err = ESP_OK;
+        if (request->frame != CAT_FRAME_NONE) {
+            // The replies in flight come back to back, and the UART hands a burst over
+            // once the line goes quiet, so the oldest may arrive only with the newest
+            err = recv_reply(request, response, &length, xTaskGetTickCount() + request_timeout(entry) * count);
+        } else {
+            int64_t wait_us = done_us[head] - esp_timer_get_time();
+            if (wait_us > 0) {
+                vTaskDelay(pdMS_TO_TICKS((wait_us + 999) / 1000) + 1); // +1: the first tick may be partial
+            }
+        }
+        bool lost = err == ESP_ERR_TIMEOUT || stats.overflows != overflows;
+        if (stats.overflows != overflows) {
+            resync();
+            err = ESP_FAIL;
+        }
+
+        note_result(err, entry, 0); // Not a round trip: the command went out early
+        complete_request(request, err, response, length, sent_us[head]);
+        head = (head + 1) % CAT_PIPELINE_DEPTH;
+        count--;
+
+        if (lost) {
+            while (count > 0) {
+                complete_request(&window[head], err, response, 0, sent_us[head]);
+                head = (head + 1) % CAT_PIPELINE_DEPTH;
+                count--;
+            }
+            have_next = false; // Left queued for the next turn
+            discard_stale();
+        }
+    }
+}
+
+// Owns the UART: runs each request to completion and reports the result, then passes on
+// unsolicited frames. Woken by cat_submit(), cat_end(), cat_set_baud_rate() and, with an
+// unsolicited handler, received data; the notification count covers anything that arrived during a scan.
+static void cat_task(void *arg) {
+    static uint8_t response[CAT_RESPONSE_MAX_SIZE];
+    cat_request_t request;
+
+    while (1) {
+        while (next_request(&request)) {
+            apply_baud_rate();
+
+            if (request.pipelined) {
+                run_pipeline(&request);
+                continue;
+            }
+
+            int64_t start_us = esp_timer_get_time();
+            size_t length;
+            esp_err_t result = run_request(&request, response, &length);
+            complete_request(&request, result, response, length, start_us);
+        }
+        apply_baud_rate();
+        if (unsolicited_handler != NULL) {
+            dispatch_unsolicited();
+        }
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+    }
+}
+
+// The client registered by the calling task
+static int current_client(void) {
+    TaskHandle_t task = xTaskGetCurrentTaskHandle();
+    int count = client_count;
+
+    for (int i = 0; i < count; i++) {
+        if (clients[i].task == task) {
+            return i;
+        }
+    }
+    return other_client;
+}
+
+static int add_client(TaskHandle_t task, const char *name, cat_priority_t priority) {
+    int index = -1;
+
+    portENTER_CRITICAL(&clients_lock);
+    for (int i = 0; i < client_count; i++) {
+        if (task != NULL && clients[i].task == task) {
+            portEXIT_CRITICAL(&clients_lock);
+            return i;
+        }
+    }
+    if (client_count < CAT_MAX_CLIENTS) {
+        index = client_count;
+        clients[index].task = task;
+        clients[index].stats.name = name;
+        clients[index].stats.priority = priority;
+        client_count++;
+    }
+    portEXIT_CRITICAL(&clients_lock);
+
+    if (index < 0) {
+        ESP_LOGE(TAG, "Too many CAT clients, %s shares the default queue", name);
+        return -1;
+    }
+
+    // Not picked by the CAT task until the queue exists
+    clients[index].queue = xQueueCreate(CAT_CLIENT_QUEUE_LENGTH, sizeof(cat_request_t));
+    if (clients[index].queue == NULL) {
+        ESP_LOGE(TAG, "Failed to create CAT queue for %s", name);
+    }
+    ESP_LOGI(TAG, "CAT client %d: %s", index, name);
+    return index;
+}
+
+// Register the calling task as a CAT client. A task registers once; calling again
+// returns the same client. Returns the client index, or -1 when the table is full.
+int cat_register_client(const char *name, cat_priority_t priority) {
+    return add_client(xTaskGetCurrentTaskHandle(), name, priority);
+}
+
+// Start an atomic sequence of transactions for the calling task's client. Other
+// sessions wait for it to end; requests from other clients are held back except PTT.
+esp_err_t cat_begin(void) {
+    int client = current_client();
+    int64_t start_us = esp_timer_get_time();
+
+    if (session_mutex == NULL || xSemaphoreTake(session_mutex, portMAX_DELAY) != pdTRUE) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    session_start_us = esp_timer_get_time();
+    session_client = client;
+
+    uint32_t wait_us = elapsed_us(start_us, session_start_us);
+    clients[client].stats.wait_us += wait_us;
+    if (wait_us > clients[client].stats.max_wait_us) {
+        clients[client].stats.max_wait_us = wait_us;
+    }
+    return ESP_OK;
+}
+
+// End the calling task's session and let the other clients back in
+void cat_end(void) {
+    if (session_mutex == NULL) {
+        return; // No CAT port (mock radio), so cat_begin() did nothing either
+    }
+    if (session_client < 0 || session_client != current_client()) {
+        ESP_LOGE(TAG, "cat_end() without cat_begin()");
+        return;
+    }
 
-    free(data);
-    vTaskDelete(NULL);
+    cat_client_stats_t *client = &clients[session_client].stats;
+    uint32_t session_us = elapsed_us(session_start_us, esp_timer_get_time());
+    client->sessions++;
+    if (session_us > client->max_session_us) {
+        client->max_session_us = session_us;
+    }
+
+    session_client = -1;
+    xSemaphoreGive(session_mutex);
+    xTaskNotifyGive(cat_task_handle);
 }
 
 // Initialize the UART driver with interrupt-based reading
 esp_err_t cat_init(void) {
-    // Create the data queue
-    data_queue = xQueueCreate(DATA_QUEUE_SIZE, sizeof(uint8_t));
-    if (data_queue == NULL) {
-        ESP_LOGE(TAG, "Failed to create data queue");
+    // Create the receive stream; a reader wakes as soon as any byte arrives
+    rx_stream = xStreamBufferCreate(RX_STREAM_SIZE, 1);
+    if (rx_stream == NULL) {
+        ESP_LOGE(TAG, "Failed to create RX stream");
         return ESP_FAIL;
     }
 
+    current_baud_rate = baud_rate;
+    stats.baud_rate = baud_rate;
+#ifdef CONFIG_RADIO_SIMULATOR
+    if (cat_sim_start(baud_rate, receive_bytes) != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to start the radio simulator");
+        return ESP_FAIL;
+    }
+#else
     uart_config_t uart_config = {
         .baud_rate = baud_rate,
         .data_bits = UART_DATA_8_BITS,
@@ -114,57 +823,302 @@ esp_err_t cat_init(void) {
         ESP_LOGE(TAG, "Failed to create UART event task");
         return ESP_FAIL;
     }
+#endif // CONFIG_RADIO_SIMULATOR
+
+    session_mutex = xSemaphoreCreateMutex();
+    if (session_mutex == NULL) {
+        ESP_LOGE(TAG, "Failed to create CAT session mutex");
+        return ESP_FAIL;
+    }
+
+    other_client = add_client(NULL, "other", CAT_PRIORITY_NORMAL);
+
+    if (xTaskCreate(cat_task, "cat_task", 3072, NULL, 11, &cat_task_handle) != pdPASS) {
+        ESP_LOGE(TAG, "Failed to create CAT task");
+        return ESP_FAIL;
+    }
 
     ESP_LOGI(TAG, "UART initialized with interrupt-based reading");
     return ESP_OK;
 }
 
-// Send a CAT command
-esp_err_t cat_send(const uint8_t *command, size_t command_size) {
-    int bytes_written = uart_write_bytes(UART_NUM, (const char *)command, command_size);
-    if (bytes_written < 0) {
-        ESP_LOGE(TAG, "Failed to write CAT command");
-        return ESP_FAIL;
+
+// Queue a request for the calling task's client without waiting for it. Its callback
+// runs from the CAT task once the reply has been framed, or on timeout.
+esp_err_t cat_submit(const cat_request_t *request) {
+    if (request->command_size > CAT_COMMAND_MAX_SIZE ||
+        (request->frame == CAT_FRAME_FIXED && request->response_size > CAT_RESPONSE_MAX_SIZE) ||
+        (request->frame == CAT_FRAME_TERMINATED && request->match_size > request->command_size)) {
+        return ESP_ERR_INVALID_ARG;
     }
-    if (bytes_written != command_size) {
-        ESP_LOGE(TAG, "Number of bytes written does not match command size: expected %d, got %d", command_size, bytes_written);
-        return ESP_FAIL;
+    if (cat_task_handle == NULL) {
+        return ESP_ERR_INVALID_STATE;
     }
 
-    ESP_LOGI(TAG, "CAT command sent");
+    cat_request_t queued = *request;
+    queued.client = current_client();
+    queued.queued_us = esp_timer_get_time();
+
+    cat_client_t *client = &clients[queued.client];
+    if (client->queue == NULL || xQueueSend(client->queue, &queued, 0) != pdTRUE) {
+        ESP_LOGE(TAG, "CAT queue full for %s", client->stats.name);
+        client->stats.queue_full++;
+        stats.queue_full++;
+        return ESP_ERR_NO_MEM;
+    }
+    stats.requests++;
+    xTaskNotifyGive(cat_task_handle);
     return ESP_OK;
 }
 
-// Read a CAT response
-esp_err_t cat_recv(uint8_t *response, size_t response_size) {
-    for (size_t i = 0; i < response_size; i++) {
-        if (xQueueReceive(data_queue, &response[i], pdMS_TO_TICKS(RESPONSE_TIMEOUT_MS)) != pdPASS) {
-            ESP_LOGE(TAG, "Timeout while reading response");
-            return ESP_FAIL;
+// A caller blocked in cat_transact(), woken by the CAT task
+typedef struct {
+    SemaphoreHandle_t done;
+    esp_err_t result;
+    uint8_t *response;
+    size_t response_size;
+    size_t length;
+} cat_future_t;
+
+static void complete_future(esp_err_t result, const uint8_t *response, size_t length, void *arg) {
+    cat_future_t *future = arg;
+
+    if (result == ESP_OK && future->response != NULL) {
+        if (length < future->response_size) {
+            memcpy(future->response, response, length);
+            future->response[length] = '\0';
+        } else if (length == future->response_size) {
+            memcpy(future->response, response, length); // Fixed frames need no NUL
+        } else {
+            result = ESP_ERR_INVALID_SIZE;
         }
     }
+    future->result = result;
+    future->length = length;
+    xSemaphoreGive(future->done);
+}
+
+// Queue a request and wait for its reply. Every request completes within the response
+// timeout once it reaches the wire, so the wait needs no timeout of its own.
+esp_err_t cat_transact(cat_request_t *request, uint8_t *response, size_t response_size, size_t *length) {
+    StaticSemaphore_t done_buffer;
+    cat_future_t future = {
+        .done = xSemaphoreCreateBinaryStatic(&done_buffer),
+        .response = response,
+        .response_size = response_size,
+    };
+
+    request->callback = complete_future;
+    request->arg = &future;
+    esp_err_t err = cat_submit(request);
+    if (err != ESP_OK) {
+        return err;
+    }
+
+    xSemaphoreTake(future.done, portMAX_DELAY);
+    if (length != NULL) {
+        *length = future.length;
+    }
+    return future.result;
+}
+
+// Send a binary command and wait for a reply of exactly `response_size` bytes, or for
+// the command to go out when `response_size` is 0
+esp_err_t cat_transact_fixed(const uint8_t *command, size_t command_size, uint8_t *response, size_t response_size) {
+    cat_request_t request = {
+        .command_size = command_size,
+        .frame = response_size > 0 ? CAT_FRAME_FIXED : CAT_FRAME_NONE,
+        .response_size = response_size,
+    };
+
+    if (command_size > sizeof(request.command)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    memcpy(request.command, command, command_size);
+    return cat_transact(&request, response, response_size, NULL);
+}
+
+// Send a ';'-terminated text command and wait for the reply that repeats its first
+// `match_size` characters, NUL-terminated in `response`. With no response buffer the
+// command is only sent.
+esp_err_t cat_transact_text(const char *command, size_t match_size, char *response, size_t response_size) {
+    size_t command_size = strlen(command);
+    cat_request_t request = {
+        .command_size = command_size,
+        .frame = response != NULL ? CAT_FRAME_TERMINATED : CAT_FRAME_NONE,
+        .terminator = TEXT_TERMINATOR,
+        .match_size = match_size,
+    };
+
+    if (command_size > sizeof(request.command)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    memcpy(request.command, command, command_size);
+    return cat_transact(&request, (uint8_t *)response, response_size, NULL);
+}
+
+void cat_batch_init(cat_batch_t *batch) {
+    batch->size = 0;
+    batch->overflow = false;
+    batch->data[0] = '\0';
+}
+
+// Append one command, `prefix` followed by `value` in `digits` digits of `base`, to the batch
+esp_err_t cat_batch_add(cat_batch_t *batch, const char *prefix, uint32_t value, int digits, int base) {
+    if (batch->overflow) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+
+    size_t len = codec_encode_text(batch->data + batch->size, sizeof(batch->data) - batch->size, prefix, value, digits, base);
+    if (len == 0) {
+        ESP_LOGE(TAG, "CAT batch full");
+        batch->data[batch->size] = '\0';
+        batch->overflow = true;
+        return ESP_ERR_INVALID_SIZE;
+    }
+    batch->size += len;
+    return ESP_OK;
+}
+
+// Write the whole batch as one request and wait for it to go out. The commands get no
+// reply; a rejection ('?;') arrives later as an unmatched frame.
+esp_err_t cat_batch_send(const cat_batch_t *batch) {
+    if (batch->overflow) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    if (batch->size == 0) {
+        return ESP_OK;
+    }
+
+    cat_request_t request = {
+        .command_size = batch->size,
+        .frame = CAT_FRAME_NONE,
+    };
+    memcpy(request.command, batch->data, batch->size);
+    return cat_transact(&request, NULL, 0, NULL);
+}
+
+void cat_get_stats(cat_stats_t *out) {
+    *out = stats;
+    out->radio_missing = radio_missing;
+}
+
+// Change the UART rate without a restart. Applied by the CAT task after the transaction
+// in flight, so a command is never split across two rates.
+esp_err_t cat_set_baud_rate(int rate) {
+    bool standard = false;
+    for (size_t i = 0; i < sizeof(standard_baud_rates) / sizeof(standard_baud_rates[0]); i++) {
+        standard |= standard_baud_rates[i] == rate;
+    }
+    if (!standard) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    if (cat_task_handle != NULL) {
+        pending_baud_rate = rate;
+        xTaskNotifyGive(cat_task_handle);
+    }
     return ESP_OK;
 }
 
-// Read response until a terminator is found
-esp_err_t cat_recv_until(uint8_t *response, size_t response_size, char terminator) {
-    size_t i = 0;
-    while (i < response_size) {
-        if (xQueueReceive(data_queue, &response[i], pdMS_TO_TICKS(RESPONSE_TIMEOUT_MS)) != pdPASS) {
-            ESP_LOGE(TAG, "Timeout while reading response");
-            return ESP_FAIL;
+// Try each standard rate until the radio answers the probe, then keep that rate and
+// save it. The configured rate is tried first.
+static bool search_baud_rate(void) {
+    int rates[1 + sizeof(standard_baud_rates) / sizeof(standard_baud_rates[0])];
+    size_t count = 0;
+
+    rates[count++] = baud_rate;
+    for (size_t i = 0; i < sizeof(standard_baud_rates) / sizeof(standard_baud_rates[0]); i++) {
+        if (standard_baud_rates[i] != baud_rate) {
+            rates[count++] = standard_baud_rates[i];
         }
-        if (response[i] == terminator) {
-            if (i > response_size) {
-                ESP_LOGE(TAG, "Response size exceeds buffer size");
-                return ESP_FAIL;
+    }
+
+    for (size_t i = 0; i < count; i++) {
+        cat_set_baud_rate(rates[i]);
+        if (baud_probe() == ESP_OK) {
+            if (rates[i] != baud_rate) {
+                baud_rate = rates[i];
+                set_u32("baud_rate", (uint32_t)baud_rate);
+                ESP_LOGI(TAG, "Radio found at %d baud, saved", baud_rate);
             }
+            return true;
+        }
+    }
 
-            response[i + 1] = '\0';
-            return ESP_OK;
+    cat_set_baud_rate(baud_rate); // Leave the configured rate in place until the radio shows up
+    return false;
+}
+
+// Probes the radio after boot, and again whenever it stops answering
+static void baud_task(void *arg) {
+    baud_client = cat_register_client("baud", CAT_PRIORITY_NORMAL);
+
+    while (1) {
+        if (baud_probe() != ESP_OK) {
+            ESP_LOGW(TAG, "No answer from the radio at %d baud, searching", current_baud_rate);
+            stats.baud_searches++;
+            while (!search_baud_rate()) {
+                ESP_LOGW(TAG, "Radio not found at any rate");
+                vTaskDelay(pdMS_TO_TICKS(BAUD_SEARCH_RETRY_MS));
+            }
         }
-        i++;
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
     }
-    ESP_LOGE(TAG, "Terminator not found in response");
-    return ESP_FAIL;
+}
+
+// Start background baud rate detection. `probe` is one read the radio always answers;
+// the driver supplies it, as only it knows a harmless command.
+esp_err_t cat_start_baud_detect(cat_probe_t probe) {
+    baud_probe = probe;
+    if (xTaskCreate(baud_task, "baud_task", 3072, NULL, 5, &baud_task_handle) != pdPASS) {
+        ESP_LOGE(TAG, "Failed to create baud detect task");
+        return ESP_FAIL;
+    }
+    return ESP_OK;
+}
+
+// Take frames ending in `terminator` that answer no request. Set once, before the radio
+// is asked to send them; the handler runs in the CAT task and must not block.
+void cat_set_unsolicited_handler(cat_frame_handler_t handler, char terminator) {
+    unsolicited_terminator = terminator;
+    unsolicited_handler = handler;
+    if (cat_task_handle != NULL) {
+        xTaskNotifyGive(cat_task_handle);
+    }
+}
+
+// Copy out the round-trip figures per command; returns the number of commands
+int cat_get_rtt_stats(cat_rtt_stats_t *out, int max_commands) {
+    int count = 0;
+
+    for (int i = 0; i < RTT_TABLE_SIZE && count < max_commands; i++) {
+        rtt_entry_t *entry = &rtt_table[i];
+        if (entry->key == 0) {
+            continue;
+        }
+        if (entry->key & 0x8000) {
+            snprintf(out[count].command, sizeof(out[count].command), "0x%02X", entry->key & 0xFF);
+        } else {
+            snprintf(out[count].command, sizeof(out[count].command), "%c%c", entry->key >> 8, entry->key & 0xFF);
+        }
+        out[count].srtt_us = entry->srtt_us;
+        out[count].rttvar_us = entry->rttvar_us;
+        out[count].timeout_us = entry->rto_us;
+        out[count].last_rtt_us = entry->last_rtt_us;
+        out[count].samples = entry->samples;
+        out[count].timeouts = entry->timeouts;
+        count++;
+    }
+    return count;
+}
+
+// Copy out the per-client counters; returns the number of clients
+int cat_get_client_stats(cat_client_stats_t *out, int max_clients) {
+    int count = client_count < max_clients ? client_count : max_clients;
+
+    for (int i = 0; i < count; i++) {
+        out[i] = clients[i].stats;
+    }
+    return count;
 }
@@ -2,6 +2,8 @@
 #define CAT_H
 
 #include "esp_err.h"
+#include "sdkconfig.h"
+#include <stdbool.h>
 #include <stddef.h>
 #include <stdint.h>
 
@@ -10,10 +12,126 @@
 #define UART_BAUD_RATE 4800
 #define BUF_SIZE 1024
 
+#define CAT_COMMAND_MAX_SIZE 48 // Also the limit for a batch of text commands
+#define CAT_RESPONSE_MAX_SIZE 64 // Including the NUL added after a terminated frame
+#define CAT_MAX_CLIENTS 8 // "other", PTT, the button and each rigctld connection, with one spare
+#define CAT_CLIENT_QUEUE_LENGTH 4
+#define CAT_PIPELINE_DEPTH CONFIG_CAT_PIPELINE_DEPTH // Pipelined commands on the wire at once
+
+// Clients with a higher priority are served first; clients of equal priority take turns
+typedef enum {
+    CAT_PRIORITY_POLL,
+    CAT_PRIORITY_NORMAL,
+    CAT_PRIORITY_PTT,
+    CAT_PRIORITY_COUNT,
+} cat_priority_t;
+
+// How the reply to a command is framed
+typedef enum {
+    CAT_FRAME_NONE,       // No reply expected
+    CAT_FRAME_FIXED,      // Exactly response_size bytes (FT-857D)
+    CAT_FRAME_TERMINATED, // Up to and including `terminator` (FT-991A ';')
+} cat_frame_t;
+
+// Called from the CAT task when a request completes, so it must not block. `response` is
+// only valid for the duration of the call.
+typedef void (*cat_callback_t)(esp_err_t result, const uint8_t *response, size_t length, void *arg);
+
+// One read the radio answers at the right baud rate, supplied by the driver
+typedef esp_err_t (*cat_probe_t)(void);
+
+// Called from the CAT task with a NUL-terminated frame the radio sent on its own
+typedef void (*cat_frame_handler_t)(const uint8_t *frame, size_t length);
+
+// One command and the reply it expects. Requests are copied into the queue by cat_submit().
+typedef struct {
+    uint8_t command[CAT_COMMAND_MAX_SIZE];
+    size_t command_size;
+    cat_frame_t frame;
+    size_t response_size; // CAT_FRAME_FIXED only
+    char terminator;      // CAT_FRAME_TERMINATED only
+    size_t match_size;    // Leading command bytes the reply must repeat; other frames are discarded
+    bool pipelined;       // May go out before the replies to the client's pipelined requests ahead of it
+    cat_callback_t callback;
+    void *arg;
+    uint8_t client;     // Set by cat_submit()
+    int64_t queued_us;  // Set by cat_submit()
+} cat_request_t;
+
+// Several text commands built into one buffer and written in one burst, for radios that
+// accept concatenated commands (FT-991A). Nothing is allocated; a command that does not
+// fit marks the batch as overflowed and cat_batch_send() refuses it.
+typedef struct {
+    char data[CAT_COMMAND_MAX_SIZE + 1]; // Room for the codec's NUL
+    size_t size;
+    bool overflow;
+} cat_batch_t;
+
+// Receive path counters: rx_chunks and rx_reads are the stream buffer calls, so
+// (rx_chunks + rx_reads) / responses is the kernel cost of one response
+typedef struct {
+    uint32_t rx_bytes;
+    uint32_t rx_chunks; // UART events moved into the stream
+    uint32_t rx_reads;  // Stream reads by the CAT task
+    uint32_t rx_dropped;
+    uint32_t overflows;
+    uint32_t responses;
+    uint32_t timeouts;
+    uint32_t requests;
+    uint32_t queue_full;
+    uint32_t discarded; // Stale bytes dropped before a command was sent
+    uint32_t unmatched;   // Whole frames that did not answer the command in flight
+    uint32_t unsolicited; // Frames passed to the unsolicited handler
+    uint32_t baud_rate;
+    uint32_t baud_searches;
+    uint32_t resyncs;       // Replies dropped and retried after an overflow
+    uint32_t fast_failures; // Requests failed at once while the radio was missing
+    bool radio_missing;
+} cat_stats_t;
+
+// Round-trip time and timeout for one command
+typedef struct {
+    char command[5]; // Two letters, or the binary opcode as 0xNN
+    uint32_t srtt_us;
+    uint32_t rttvar_us;
+    uint32_t timeout_us;
+    uint32_t last_rtt_us;
+    uint32_t samples;
+    uint32_t timeouts;
+} cat_rtt_stats_t;
+
+// Per-client arbitration counters. Wait is from queueing (or cat_begin()) until the
+// client gets the port; hold is from the command going out until its reply is framed.
+typedef struct {
+    const char *name;
+    cat_priority_t priority;
+    uint32_t transactions;
+    uint32_t queue_full;
+    uint64_t wait_us;
+    uint32_t max_wait_us;
+    uint64_t hold_us;
+    uint32_t max_hold_us;
+    uint32_t sessions;
+    uint32_t max_session_us;
+} cat_client_stats_t;
+
 // Function prototypes
 esp_err_t cat_init(void);
-esp_err_t cat_send(const uint8_t *command, size_t command_size);
-esp_err_t cat_recv(uint8_t *response, size_t response_size);
-esp_err_t cat_recv_until(uint8_t *response, size_t response_size, char terminator);
+int cat_register_client(const char *name, cat_priority_t priority);
+esp_err_t cat_begin(void);
+void cat_end(void);
+esp_err_t cat_submit(const cat_request_t *request);
+esp_err_t cat_transact(cat_request_t *request, uint8_t *response, size_t response_size, size_t *length);
+esp_err_t cat_transact_fixed(const uint8_t *command, size_t command_size, uint8_t *response, size_t response_size);
+esp_err_t cat_transact_text(const char *command, size_t match_size, char *response, size_t response_size);
+esp_err_t cat_set_baud_rate(int rate);
+esp_err_t cat_start_baud_detect(cat_probe_t probe);
+void cat_batch_init(cat_batch_t *batch);
+esp_err_t cat_batch_add(cat_batch_t *batch, const char *prefix, uint32_t value, int digits, int base);
+esp_err_t cat_batch_send(const cat_batch_t *batch);
+void cat_set_unsolicited_handler(cat_frame_handler_t handler, char terminator);
+void cat_get_stats(cat_stats_t *stats);
+int cat_get_rtt_stats(cat_rtt_stats_t *stats, int max_commands);
+int cat_get_client_stats(cat_client_stats_t *stats, int max_clients);
 
 #endif // CAT_H
@@ -0,0 +1,95 @@
+#include "cat_codec.h"
+
+static const char hex_digits[] = "0123456789ABCDEF";
+
+static int digit_value(char c, int base) {
+    int value;
+
+    if (c >= '0' && c <= '9') {
+        value = c - '0';
+    } else if (c >= 'A' && c <= 'F') {
+        value = c - 'A' + 10;
+    } else if (c >= 'a' && c <= 'f') {
+        value = c - 'a' + 10;
+    } else {
+        return -1;
+    }
+    return value < base ? value : -1;
+}
+
+size_t codec_encode_text(char *out, size_t size, const char *prefix, uint32_t value, int digits, int base) {
+    size_t length = 0;
+
+    while (prefix[length] != '\0') {
+        if (length >= size) {
+            return 0;
+        }
+        out[length] = prefix[length];
+        length++;
+    }
+    if (length + digits + 2 > size) { // Digits, ';' and NUL
+        return 0;
+    }
+
+    // Fill the field from its last digit back
+    for (int i = digits - 1; i >= 0; i--) {
+        out[length + i] = hex_digits[value % base];
+        value /= base;
+    }
+    if (value != 0) {
+        return 0; // Does not fit in the field
+    }
+    length += digits;
+
+    out[length++] = ';';
+    out[length] = '\0';
+    return length;
+}
+
+bool codec_text_has_prefix(const char *frame, size_t length, const char *prefix) {
+    for (size_t i = 0; prefix[i] != '\0'; i++) {
+        if (i >= length || frame[i] != prefix[i]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool codec_decode_text_field(const char *frame, size_t length, size_t offset, int digits, int base, uint32_t *value) {
+    uint32_t result = 0;
+
+    if (offset + digits > length) {
+        return false;
+    }
+    for (int i = 0; i < digits; i++) {
+        int digit = digit_value(frame[offset + i], base);
+        if (digit < 0 || result > (UINT32_MAX - digit) / base) {
+            return false; // Not a digit, or more than 32 bits
+        }
+        result = result * base + digit;
+    }
+    *value = result;
+    return true;
+}
+
+void codec_encode_bcd(uint32_t value, uint8_t *bcd, size_t length) {
+    for (size_t i = length; i > 0; i--) {
+        bcd[i - 1] = (value % 10) | ((value / 10 % 10) << 4);
+        value /= 100;
+    }
+}
+
+bool codec_decode_bcd(const uint8_t *bcd, size_t length, uint32_t *value) {
+    uint32_t result = 0;
+
+    for (size_t i = 0; i < length; i++) {
+        uint8_t high = bcd[i] >> 4;
+        uint8_t low = bcd[i] & 0x0F;
+        if (high > 9 || low > 9 || result > (UINT32_MAX - high * 10 - low) / 100) {
+            return false;
+        }
+        result = result * 100 + high * 10 + low;
+    }
+    *value = result;
+    return true;
+}
@@ -0,0 +1,34 @@
+#ifndef CAT_CODEC_H
+#define CAT_CODEC_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Encoding and decoding of CAT frames without stdio or the heap. Everything is written
+// straight into the caller's buffer.
+//
+// Text frames (FT-991A) are a command prefix, an optional fixed-width number and ';',
+// e.g. "FA014074000;" or "MD0C;". Binary frames (FT-857D) carry packed BCD digits.
+
+#define CODEC_DECIMAL 10
+#define CODEC_HEX 16
+
+// Write `prefix`, then `value` in exactly `digits` digits of `base` (none when `digits`
+// is 0), then ';' and a NUL. Returns the frame length without the NUL, or 0 if it does
+// not fit in `size` or `value` needs more digits.
+size_t codec_encode_text(char *out, size_t size, const char *prefix, uint32_t value, int digits, int base);
+
+// True if the frame starts with `prefix`
+bool codec_text_has_prefix(const char *frame, size_t length, const char *prefix);
+
+// Read `digits` digits of `base` at `offset` in the frame. False if the frame is too
+// short, any of them is not a digit or the value does not fit in 32 bits.
+bool codec_decode_text_field(const char *frame, size_t length, size_t offset, int digits, int base, uint32_t *value);
+
+// Packed BCD, most significant pair first, two digits per byte. Decoding fails on a
+// nibble above 9 or a value that does not fit in 32 bits.
+void codec_encode_bcd(uint32_t value, uint8_t *bcd, size_t length);
+bool codec_decode_bcd(const uint8_t *bcd, size_t length, uint32_t *value);
+
+#endif // CAT_CODEC_H
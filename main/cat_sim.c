@@ -0,0 +1,143 @@
+#include "cat_sim.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+#include "sdkconfig.h"
+
+#ifdef CONFIG_RADIO_SIMULATOR
+static const char *TAG = "CAT_SIM";
+
+#ifdef CONFIG_RADIO_SIMULATOR_FT857D
+#define SIM_PROTOCOL RADIO_SIM_FT857D
+#else
+#define SIM_PROTOCOL RADIO_SIM_FT991A
+#endif
+
+#define TUNE_STEP_HZ 10
+
+static radio_sim_t sim;
+static SemaphoreHandle_t sim_mutex = NULL;
+static TaskHandle_t sim_task_handle = NULL;
+static esp_timer_handle_t burst_timer = NULL; // Fires when the next burst has fully arrived
+static esp_timer_handle_t tune_timer = NULL;
+static cat_sim_receive_t receive_callback = NULL;
+static volatile int line_rate;
+
+static void burst_timer_callback(void *arg) {
+    xTaskNotifyGive(sim_task_handle);
+}
+
+// The operator turns the VFO a step, so Auto Information has something to report
+static void tune_timer_callback(void *arg) {
+    xSemaphoreTake(sim_mutex, portMAX_DELAY);
+    radio_sim_tune(&sim, sim.frequency + TUNE_STEP_HZ, esp_timer_get_time());
+    xSemaphoreGive(sim_mutex);
+    xTaskNotifyGive(sim_task_handle);
+}
+
+// Stands in for the UART event task: hands each burst of reply bytes to the receive path
+// once its last byte has arrived
+static void sim_task(void *arg) {
+    uint8_t data[64];
+
+    while (1) {
+        xSemaphoreTake(sim_mutex, portMAX_DELAY);
+        int64_t now_us = esp_timer_get_time();
+        size_t size = radio_sim_read(&sim, data, sizeof(data), now_us);
+        int64_t due_us = radio_sim_burst_due_us(&sim);
+        xSemaphoreGive(sim_mutex);
+
+        if (size > 0) {
+            receive_callback(data, size);
+            continue; // The rest of a burst larger than `data`
+        }
+
+        if (due_us >= 0) {
+            esp_timer_stop(burst_timer);
+            esp_timer_start_once(burst_timer, due_us > now_us ? due_us - now_us : 1);
+        }
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+    }
+}
+
+esp_err_t cat_sim_start(int baud_rate, cat_sim_receive_t receive) {
+    radio_sim_config_t config = {
+        .protocol = SIM_PROTOCOL,
+        .baud_rate = CONFIG_RADIO_SIMULATOR_BAUD_RATE,
+        .latency_us = CONFIG_RADIO_SIMULATOR_LATENCY_US,
+        .drop_per_mille = CONFIG_RADIO_SIMULATOR_DROP_PER_MILLE,
+        .seed = CONFIG_RADIO_SIMULATOR_SEED,
+    };
+    radio_sim_init(&sim, &config);
+    line_rate = baud_rate;
+    receive_callback = receive;
+
+    sim_mutex = xSemaphoreCreateMutex();
+    if (sim_mutex == NULL) {
+        ESP_LOGE(TAG, "Failed to create simulator mutex");
+        return ESP_FAIL;
+    }
+
+    esp_timer_create_args_t burst_args = {.callback = burst_timer_callback, .name = "sim_burst"};
+    if (esp_timer_create(&burst_args, &burst_timer) != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to create simulator timer");
+        return ESP_FAIL;
+    }
+
+    if (xTaskCreate(sim_task, "radio_sim_task", 2048, NULL, 12, &sim_task_handle) != pdPASS) {
+        ESP_LOGE(TAG, "Failed to create simulator task");
+        return ESP_FAIL;
+    }
+
+    if (CONFIG_RADIO_SIMULATOR_TUNE_INTERVAL_MS > 0) {
+        esp_timer_create_args_t tune_args = {.callback = tune_timer_callback, .name = "sim_tune"};
+        if (esp_timer_create(&tune_args, &tune_timer) != ESP_OK ||
+            esp_timer_start_periodic(tune_timer, CONFIG_RADIO_SIMULATOR_TUNE_INTERVAL_MS * 1000ULL) != ESP_OK) {
+            ESP_LOGE(TAG, "Failed to start simulated tuning");
+            return ESP_FAIL;
+        }
+    }
+
+    ESP_LOGI(TAG, "Simulated %s at %d baud, %d us latency, %d/1000 bytes dropped",
+             SIM_PROTOCOL == RADIO_SIM_FT857D ? "FT-857D" : "FT-991A", CONFIG_RADIO_SIMULATOR_BAUD_RATE,
+             CONFIG_RADIO_SIMULATOR_LATENCY_US, CONFIG_RADIO_SIMULATOR_DROP_PER_MILLE);
+    return ESP_OK;
+}
+
+int cat_sim_write(const uint8_t *data, size_t size) {
+    xSemaphoreTake(sim_mutex, portMAX_DELAY);
+    radio_sim_write(&sim, data, size, line_rate, esp_timer_get_time());
+    xSemaphoreGive(sim_mutex);
+    xTaskNotifyGive(sim_task_handle);
+    return size;
+}
+
+// Like uart_wait_tx_done(): returns once the last byte written has left
+void cat_sim_wait_tx_done(void) {
+    xSemaphoreTake(sim_mutex, portMAX_DELAY);
+    int64_t wait_us = radio_sim_write_done_us(&sim) - esp_timer_get_time();
+    xSemaphoreGive(sim_mutex);
+
+    if (wait_us > 0) {
+        vTaskDelay(pdMS_TO_TICKS((wait_us + 999) / 1000) + 1);
+    }
+}
+
+void cat_sim_set_baud_rate(int baud_rate) {
+    line_rate = baud_rate;
+}
+
+void cat_sim_flush_input(void) {
+    xSemaphoreTake(sim_mutex, portMAX_DELAY);
+    radio_sim_flush(&sim, esp_timer_get_time());
+    xSemaphoreGive(sim_mutex);
+}
+
+void cat_sim_get_stats(radio_sim_stats_t *stats) {
+    xSemaphoreTake(sim_mutex, portMAX_DELAY);
+    radio_sim_get_stats(&sim, stats);
+    xSemaphoreGive(sim_mutex);
+}
+#endif // CONFIG_RADIO_SIMULATOR
@@ -0,0 +1,23 @@
+#ifndef CAT_SIM_H
+#define CAT_SIM_H
+
+#include "esp_err.h"
+#include "radio_sim.h"
+#include <stddef.h>
+#include <stdint.h>
+
+// Pseudo-UART for CONFIG_RADIO_SIMULATOR: the CAT task writes commands to a simulated
+// radio instead of UART_NUM, and replies reach the receive path with the timing the
+// serial line would give them
+
+// Called from the simulator task with each burst of reply bytes, as UART_DATA is
+typedef void (*cat_sim_receive_t)(const uint8_t *data, size_t size);
+
+esp_err_t cat_sim_start(int baud_rate, cat_sim_receive_t receive);
+int cat_sim_write(const uint8_t *data, size_t size);
+void cat_sim_wait_tx_done(void);
+void cat_sim_set_baud_rate(int baud_rate);
+void cat_sim_flush_input(void);
+void cat_sim_get_stats(radio_sim_stats_t *stats);
+
+#endif // CAT_SIM_H
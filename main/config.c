@@ -144,3 +144,50 @@ esp_err_t get_string(const char *key, char *value, size_t max_len) {
     nvs_close(nvs_handle);
     return err;
 }
+
+esp_err_t set_blob(const char *key, const void *value, size_t length) {
+    nvs_handle_t nvs_handle;
+    esp_err_t err;
+
+    err = nvs_open(NVS_NAMESPACE, NVS_READWRITE, &nvs_handle);
+    if (err != ESP_OK) {
+        ESP_LOGE("NVS", "Error opening NVS handle: %s", esp_err_to_name(err));
+        return err;
+    }
+
+    err = nvs_set_blob(nvs_handle, key, value, length);
+    if (err != ESP_OK) {
+        ESP_LOGE("NVS", "Error saving blob to NVS: %s", esp_err_to_name(err));
+        nvs_close(nvs_handle);
+        return err;
+    }
+
+    err = nvs_commit(nvs_handle);
+    if (err != ESP_OK) {
+        ESP_LOGE("NVS", "Error committing changes to NVS: %s", esp_err_to_name(err));
+    }
+
+    nvs_close(nvs_handle);
+    return err;
+}
+
+esp_err_t get_blob(const char *key, void *value, size_t *length) {
+    nvs_handle_t nvs_handle;
+    esp_err_t err;
+
+    err = nvs_open(NVS_NAMESPACE, NVS_READONLY, &nvs_handle);
+    if (err != ESP_OK) {
+        ESP_LOGE("NVS", "Error opening NVS handle: %s", esp_err_to_name(err));
+        return err;
+    }
+
+    err = nvs_get_blob(nvs_handle, key, value, length);
+    if (err == ESP_ERR_NVS_NOT_FOUND) {
+        ESP_LOGW("NVS", "Key '%s' not found in NVS", key);
+    } else if (err != ESP_OK) {
+        ESP_LOGE("NVS", "Error reading blob from NVS: %s", esp_err_to_name(err));
+    }
+
+    nvs_close(nvs_handle);
+    return err;
+}
@@ -10,5 +10,7 @@ esp_err_t set_u32(const char *key, uint32_t value); // Add set_u32 prototype
 esp_err_t get_u32(const char *key, uint32_t *value); // Add get_u32 prototype
 esp_err_t set_string(const char *key, const char *value);
 esp_err_t get_string(const char *key, char *value, size_t max_len);
+esp_err_t set_blob(const char *key, const void *value, size_t length);
+esp_err_t get_blob(const char *key, void *value, size_t *length);
 
 #endif // CONFIG_H
\ No newline at end of file
@@ -0,0 +1,216 @@
+#include "contest.h"
+#include "cJSON.h"
+#include "config.h"
+#include "esp_http_server.h"
+#include "esp_log.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "http.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static const char *TAG = "CONTEST";
+
+// NVS only holds the end of a block of reserved serials, so it is written once every
+// SERIAL_BLOCK QSOs. After a reboot counting resumes at the end of the block: a few
+// numbers may be skipped, but a number is never sent twice.
+#define SERIAL_LIMIT_KEY "serial_limit"
+#define SERIAL_BLOCK 10
+
+static char call[CONTEST_CALL_MAX_SIZE] = "";
+static char rst[CONTEST_RST_MAX_SIZE] = "5NN";
+static uint32_t serial = 1;      // Next serial to send
+static uint32_t last_serial = 0; // Serial sent most recently, 0 if none yet
+static uint32_t serial_limit = 0;
+static SemaphoreHandle_t contest_mutex = NULL;
+
+// Caller must hold contest_mutex
+static void reserve_serials(void) {
+    serial_limit = serial + SERIAL_BLOCK;
+    esp_err_t err = set_u32(SERIAL_LIMIT_KEY, serial_limit);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to save serial limit to NVS: %s", esp_err_to_name(err));
+    } else {
+        ESP_LOGI(TAG, "Reserved serials %lu-%lu", serial, serial_limit - 1);
+    }
+}
+
+void contest_init(void) {
+    contest_mutex = xSemaphoreCreateMutex();
+    if (contest_mutex == NULL) {
+        ESP_LOGE(TAG, "Failed to create contest mutex");
+        return;
+    }
+
+    uint32_t u32_v;
+    if (get_u32(SERIAL_LIMIT_KEY, &u32_v) == ESP_OK && u32_v >= 1 && u32_v <= CONTEST_SERIAL_MAX) {
+        serial = u32_v;
+        ESP_LOGI(TAG, "Resuming serials at %lu", serial);
+    } else {
+        ESP_LOGW(TAG, "No serial limit in NVS, starting at %lu", serial);
+    }
+
+    xSemaphoreTake(contest_mutex, portMAX_DELAY);
+    reserve_serials();
+    xSemaphoreGive(contest_mutex);
+}
+
+void contest_get_call(char *value, size_t size) {
+    xSemaphoreTake(contest_mutex, portMAX_DELAY);
+    strncpy(value, call, size - 1);
+    value[size - 1] = '\0';
+    xSemaphoreGive(contest_mutex);
+}
+
+void contest_get_rst(char *value, size_t size) {
+    xSemaphoreTake(contest_mutex, portMAX_DELAY);
+    strncpy(value, rst, size - 1);
+    value[size - 1] = '\0';
+    xSemaphoreGive(contest_mutex);
+}
+
+uint32_t contest_get_serial(void) {
+    xSemaphoreTake(contest_mutex, portMAX_DELAY);
+    uint32_t value = serial;
+    xSemaphoreGive(contest_mutex);
+    return value;
+}
+
+uint32_t contest_get_last_serial(void) {
+    xSemaphoreTake(contest_mutex, portMAX_DELAY);
+    uint32_t value = last_serial;
+    xSemaphoreGive(contest_mutex);
+    return value;
+}
+
+// Called once a message carrying {NR} has been keyed in full. Repeats of an older
+// number (or a number changed in the meantime) leave the counter alone.
+void contest_serial_sent(uint32_t sent) {
+    xSemaphoreTake(contest_mutex, portMAX_DELAY);
+    if (sent == serial) {
+        last_serial = serial;
+        serial = serial < CONTEST_SERIAL_MAX ? serial + 1 : 1;
+        if (serial >= serial_limit || serial == 1) {
+            reserve_serials();
+        }
+    }
+    xSemaphoreGive(contest_mutex);
+}
+
+esp_err_t contest_set_serial(uint32_t value) {
+    if (value < 1 || value > CONTEST_SERIAL_MAX) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    xSemaphoreTake(contest_mutex, portMAX_DELAY);
+    if (value != serial) {
+        serial = value;
+        reserve_serials();
+    }
+    xSemaphoreGive(contest_mutex);
+    return ESP_OK;
+}
+
+// Serials are sent with at least three digits, e.g. 7 -> "007", or "TT7" with CUT_T
+void contest_format_serial(uint32_t value, uint8_t cut, char *text, size_t size) {
+    snprintf(text, size, "%03lu", value);
+    for (char *p = text; *p != '\0'; p++) {
+        if (*p == '0' && (cut & CUT_T)) {
+            *p = 'T';
+        } else if (*p == '9' && (cut & CUT_N)) {
+            *p = 'N';
+        } else if (*p == '1' && (cut & CUT_A)) {
+            *p = 'A';
+        }
+    }
+}
+
+static esp_err_t get_contest_handler(httpd_req_t *req) {
+    cJSON *json = cJSON_CreateObject();
+    if (!json) {
+        ESP_LOGE(TAG, "Failed to create JSON object");
+        httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Failed to create JSON response");
+        return ESP_FAIL;
+    }
+
+    xSemaphoreTake(contest_mutex, portMAX_DELAY);
+    cJSON_AddStringToObject(json, "call", call);
+    cJSON_AddStringToObject(json, "rst", rst);
+    cJSON_AddNumberToObject(json, "serial", serial);
+    cJSON_AddNumberToObject(json, "last_serial", last_serial);
+    xSemaphoreGive(contest_mutex);
+
+    const char *response = cJSON_PrintUnformatted(json);
+    if (!response) {
+        ESP_LOGE(TAG, "Failed to print JSON response");
+        cJSON_Delete(json);
+        httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Failed to create JSON response");
+        return ESP_FAIL;
+    }
+
+    httpd_resp_set_type(req, "application/json");
+    httpd_resp_send(req, response, strlen(response));
+
+    cJSON_Delete(json);
+    free((void *)response);
+    return ESP_OK;
+}
+
+// Any of "call", "rst" and "serial" may be given; the others are left as they are
+static esp_err_t set_contest_handler(httpd_req_t *req) {
+    char buffer[128];
+    int received = httpd_req_recv(req, buffer, sizeof(buffer) - 1);
+
+    if (received <= 0) {
+        ESP_LOGE(TAG, "Failed to receive request body");
+        httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Failed to receive request body");
+        return ESP_FAIL;
+    }
+
+    buffer[received] = '\0';
+    ESP_LOGI(TAG, "Received body: %s", buffer);
+
+    cJSON *json = cJSON_Parse(buffer);
+    if (!json) {
+        ESP_LOGE(TAG, "Failed to parse JSON");
+        httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Invalid JSON");
+        return ESP_FAIL;
+    }
+
+    cJSON *serial_json = cJSON_GetObjectItem(json, "serial");
+    if (serial_json && (!cJSON_IsNumber(serial_json) || contest_set_serial(serial_json->valueint) != ESP_OK)) {
+        ESP_LOGE(TAG, "Invalid 'serial' field");
+        httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Invalid 'serial' field");
+        cJSON_Delete(json);
+        return ESP_FAIL;
+    }
+
+    cJSON *call_json = cJSON_GetObjectItem(json, "call");
+    cJSON *rst_json = cJSON_GetObjectItem(json, "rst");
+
+    xSemaphoreTake(contest_mutex, portMAX_DELAY);
+    if (cJSON_IsString(call_json)) {
+        strncpy(call, call_json->valuestring, sizeof(call) - 1);
+        call[sizeof(call) - 1] = '\0';
+        ESP_LOGI(TAG, "Call: %s", call);
+    }
+    if (cJSON_IsString(rst_json)) {
+        strncpy(rst, rst_json->valuestring, sizeof(rst) - 1);
+        rst[sizeof(rst) - 1] = '\0';
+        ESP_LOGI(TAG, "RST: %s", rst);
+    }
+    xSemaphoreGive(contest_mutex);
+
+    httpd_resp_set_type(req, "application/json");
+    httpd_resp_send(req, "{\"result\": \"Contest updated\"}", HTTPD_RESP_USE_STRLEN);
+
+    cJSON_Delete(json);
+    return ESP_OK;
+}
+
+void register_contest_endpoints(void) {
+    register_html_page("/api/contest", HTTP_GET, get_contest_handler);
+    register_html_page("/api/contest", HTTP_POST, set_contest_handler);
+    ESP_LOGI(TAG, "Contest API endpoints registered");
+}
@@ -0,0 +1,28 @@
+#ifndef CONTEST_H
+#define CONTEST_H
+
+#include "esp_err.h"
+#include <stddef.h>
+#include <stdint.h>
+
+#define CONTEST_CALL_MAX_SIZE 16
+#define CONTEST_RST_MAX_SIZE 8
+#define CONTEST_SERIAL_MAX 9999
+
+// Cut numbers for {NR}: 0 -> T, 9 -> N, 1 -> A
+#define CUT_T 0x01
+#define CUT_N 0x02
+#define CUT_A 0x04
+
+void contest_init(void);
+void contest_get_call(char *call, size_t size);
+void contest_get_rst(char *rst, size_t size);
+uint32_t contest_get_serial(void);
+uint32_t contest_get_last_serial(void);
+void contest_serial_sent(uint32_t serial);
+esp_err_t contest_set_serial(uint32_t serial);
+void contest_format_serial(uint32_t serial, uint8_t cut, char *text, size_t size);
+
+void register_contest_endpoints(void);
+
+#endif // CONTEST_H
@@ -1,5 +1,5 @@
-#include "bcd.h"
 #include "cat.h"
+#include "cat_codec.h"
 #include "driver/uart.h"
 #include "esp_log.h"
 #include "radio.h"
@@ -7,7 +7,7 @@
 #include <string.h>
 #include "sdkconfig.h"
 
-#ifdef CONFIG_RADIO_FT857D
+#ifdef CONFIG_RADIO_PROTOCOL_FT857D
 #define CAT_COMMAND_SIZE 5           // CAT commands and responses are always 5 bytes
 
 // Mode definitions for FT-857D
@@ -49,31 +49,36 @@
 
 #define TAG "FT857D"
 
-// Initialize the FT-857D radio
-esp_err_t init_radio() {
-    if (cat_init() != ESP_OK) {
-        ESP_LOGE(TAG, "Failed to initialize UART for FT-857D");
-        return ESP_FAIL;
-    }
-
-    ESP_LOGI(TAG, "FT-857D initialized");
-    return ESP_OK;
-}
 
-esp_err_t get_frequency_and_mode(uint8_t *response) {
+// Read the 5-byte frequency and mode frame; frequency and mode both come from it
+static esp_err_t read_frequency_and_mode(uint8_t *response) {
     uint8_t command[CAT_COMMAND_SIZE] = {0, 0, 0, 0, CMD_READ_FREQ};
 
     ESP_LOGI(TAG, "Sending get frequency and mode command: %02X %02X %02X %02X %02X", command[0], command[1], command[2], command[3], command[4]);
-    if (cat_send(command, CAT_COMMAND_SIZE) != ESP_OK) {
+    if (cat_transact_fixed(command, CAT_COMMAND_SIZE, response, CAT_COMMAND_SIZE) != ESP_OK) {
+        ESP_LOGE(TAG, "Invalid get frequency and mode response");
         return ESP_FAIL;
     }
+    ESP_LOGI(TAG, "Get frequency and mode response: %02X %02X %02X %02X %02X", response[0], response[1], response[2], response[3], response[4]);
 
-    if (cat_recv(response, CAT_COMMAND_SIZE) != ESP_OK) {
-        ESP_LOGE(TAG, "Invalid get frequency and mode response");
+    return ESP_OK;
+}
+
+// Baud rate probe: a read, so a command garbled by a wrong rate changes nothing
+static esp_err_t probe_radio(void) {
+    uint8_t response[CAT_COMMAND_SIZE];
+    return read_frequency_and_mode(response);
+}
+
+// Initialize the FT-857D radio
+esp_err_t init_radio() {
+    if (cat_init() != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to initialize UART for FT-857D");
         return ESP_FAIL;
     }
-    ESP_LOGI(TAG, "Get frequency and mode response: %02X %02X %02X %02X %02X", response[0], response[1], response[2], response[3], response[4]);
+    cat_start_baud_detect(probe_radio);
 
+    ESP_LOGI(TAG, "FT-857D initialized");
     return ESP_OK;
 }
 
@@ -81,12 +86,16 @@ esp_err_t get_frequency_and_mode(uint8_t *response) {
 esp_err_t get_frequency(uint32_t *frequency) {
     uint8_t response[CAT_COMMAND_SIZE] = {0};
 
-    if (get_frequency_and_mode(response) != ESP_OK) {
+    if (read_frequency_and_mode(response) != ESP_OK) {
         ESP_LOGE(TAG, "Failed to get frequency and mode");
         return ESP_FAIL;
     }
 
-    *frequency = bcd_to_uint32(&response[0], CAT_COMMAND_SIZE - 1) * 10;
+    if (!codec_decode_bcd(&response[0], CAT_COMMAND_SIZE - 1, frequency)) {
+        ESP_LOGE(TAG, "Invalid BCD frequency in response");
+        return ESP_FAIL;
+    }
+    *frequency *= 10;
 
     ESP_LOGI(TAG, "Frequency: %lu Hz", *frequency);
     return ESP_OK;
@@ -96,11 +105,29 @@ esp_err_t get_frequency(uint32_t *frequency) {
 esp_err_t get_mode(uint8_t *mode) {
     uint8_t response[CAT_COMMAND_SIZE] = {0, 0, 0, 0, 0};
 
-    if (get_frequency_and_mode(response) != ESP_OK) {
+    if (read_frequency_and_mode(response) != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to get frequency and mode");
+        return ESP_FAIL;
+    }
+
+    *mode = response[4];
+    return ESP_OK;
+}
+
+// Get frequency and mode from the FT-857D in one transaction
+esp_err_t get_frequency_and_mode(uint32_t *frequency, uint8_t *mode) {
+    uint8_t response[CAT_COMMAND_SIZE] = {0};
+
+    if (read_frequency_and_mode(response) != ESP_OK) {
         ESP_LOGE(TAG, "Failed to get frequency and mode");
         return ESP_FAIL;
     }
 
+    if (!codec_decode_bcd(&response[0], CAT_COMMAND_SIZE - 1, frequency)) {
+        ESP_LOGE(TAG, "Invalid BCD frequency in response");
+        return ESP_FAIL;
+    }
+    *frequency *= 10;
     *mode = response[4];
     return ESP_OK;
 }
@@ -109,17 +136,12 @@ esp_err_t get_mode(uint8_t *mode) {
 esp_err_t set_frequency(uint32_t frequency) {
     uint8_t command[CAT_COMMAND_SIZE] = {0, 0, 0, 0, CMD_SET_FREQ};
 
-    uint32_to_bcd(frequency / 10, command, CAT_COMMAND_SIZE - 1);
+    codec_encode_bcd(frequency / 10, command, CAT_COMMAND_SIZE - 1);
 
     ESP_LOGI(TAG, "Sending set frequency command: %02X %02X %02X %02X %02X", command[0], command[1], command[2], command[3], command[4]);
-    if (cat_send(command, CAT_COMMAND_SIZE) != ESP_OK) {
-        ESP_LOGE(TAG, "Failed to set frequency");
-        return ESP_FAIL;
-    }
-
     uint8_t response = 0;
-    if (cat_recv(&response, 1) != ESP_OK) {
-        ESP_LOGE(TAG, "Failed to read response");
+    if (cat_transact_fixed(command, CAT_COMMAND_SIZE, &response, 1) != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to set frequency");
         return ESP_FAIL;
     }
     if (response != 0) {
@@ -135,14 +157,9 @@ esp_err_t set_mode(uint8_t mode) {
     uint8_t command[CAT_COMMAND_SIZE] = {mode, 0, 0, 0, CMD_SET_MODE};
 
     ESP_LOGI(TAG, "Sending set mode command: %02X %02X %02X %02X %02X", command[0], command[1], command[2], command[3], command[4]);
-    if (cat_send(command, CAT_COMMAND_SIZE) != ESP_OK) {
-        ESP_LOGE(TAG, "Failed to set mode");
-        return ESP_FAIL;
-    }
-
     uint8_t response = 0;
-    if (cat_recv(&response, 1) != ESP_OK) {
-        ESP_LOGE(TAG, "Failed to read response");
+    if (cat_transact_fixed(command, CAT_COMMAND_SIZE, &response, 1) != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to set mode");
         return ESP_FAIL;
     }
     if (response != 0) {
@@ -153,19 +170,29 @@ esp_err_t set_mode(uint8_t mode) {
     return ESP_OK;
 }
 
+// Set mode and frequency. Each FT-857D command is acknowledged on its own, so they
+// cannot share a write; power has no CAT command.
+esp_err_t set_mode_power_frequency(uint8_t mode, uint8_t power, uint32_t frequency, uint8_t fields) {
+    if ((fields & RADIO_SET_MODE) && set_mode(mode) != ESP_OK) {
+        return ESP_FAIL;
+    }
+    if ((fields & RADIO_SET_POWER) && set_power(power) != ESP_OK) {
+        return ESP_FAIL;
+    }
+    if ((fields & RADIO_SET_FREQUENCY) && set_frequency(frequency) != ESP_OK) {
+        return ESP_FAIL;
+    }
+    return ESP_OK;
+}
+
 // Set PTT (Push-to-Talk) on the FT-857D
 esp_err_t set_ptt(bool enable) {
     uint8_t command[CAT_COMMAND_SIZE] = {0, 0, 0, 0, enable ? CMD_PTT_ON : CMD_PTT_OFF};
 
     ESP_LOGI(TAG, "Sending set ptt command: %02X %02X %02X %02X %02X", command[0], command[1], command[2], command[3], command[4]);
-    if (cat_send(command, CAT_COMMAND_SIZE) != ESP_OK) {
-        ESP_LOGE(TAG, "Failed to set PTT");
-        return ESP_FAIL;
-    }
-
     uint8_t response = 0;
-    if (cat_recv(&response, 1) != ESP_OK) {
-        ESP_LOGE(TAG, "Failed to read response");
+    if (cat_transact_fixed(command, CAT_COMMAND_SIZE, &response, 1) != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to set PTT");
         return ESP_FAIL;
     }
     if (response != 0) {
@@ -189,6 +216,24 @@ esp_err_t set_power(uint8_t power) {
     return ESP_OK;
 }
 
+// The FT-857D's CAT protocol has no command that reads or writes a memory channel;
+// CMD_READ_MEMORY and CMD_WRITE_MEMORY are not in the manual, so there is nothing to back up
+uint16_t memory_channel_count(void) {
+    return 0;
+}
+
+esp_err_t memory_read_request(uint16_t channel, cat_request_t *request) {
+    return ESP_ERR_NOT_SUPPORTED;
+}
+
+esp_err_t memory_decode(uint16_t channel, esp_err_t result, const uint8_t *response, size_t length, radio_memory_t *memory) {
+    return ESP_ERR_NOT_SUPPORTED;
+}
+
+esp_err_t memory_write_request(const radio_memory_t *memory, cat_request_t *request) {
+    return ESP_ERR_NOT_SUPPORTED;
+}
+
 uint8_t string_to_mode(const char* mode) {
     if (strcmp(mode, "LSB") == 0) return MODE_LSB;
     if (strcmp(mode, "USB") == 0) return MODE_USB;
@@ -221,5 +266,5 @@ const char* mode_to_string(uint8_t mode) {
         default:         return "UNKNOWN"; // Unknown mode
     }
 }
-#endif // CONFIG_RADIO_FT857D
+#endif // CONFIG_RADIO_PROTOCOL_FT857D
 
@@ -1,26 +1,57 @@
 #include "cat.h"
+#include "cat_codec.h"
 #include "driver/uart.h"
 #include "esp_log.h"
 #include "pins.h"
 #include "radio.h"
-#include <stdio.h>
+#include "radio_cache.h"
 #include <string.h>
 #include "sdkconfig.h"
 
-#ifdef CONFIG_RADIO_FT991A
+#ifdef CONFIG_RADIO_PROTOCOL_FT991A
 #define TAG "FT991A"
 
-// CAT command definitions for FT-991A
-#define CMD_GET_FREQ       "FA;"     // Get frequency
-#define CMD_SET_FREQ       "FA%09lu;" // Set frequency (9 digits)
-#define CMD_GET_MODE       "MD;"     // Get mode
-#define CMD_SET_MODE       "MD%01u;" // Set mode (1 digit)
-#define CMD_PTT_ON         "TX0;"    // Enable PTT
-#define CMD_PTT_OFF        "TX1;"    // Disable PTT
-
-// CAT command definitions for power control
-#define CMD_GET_POWER      "PC;"     // Get power level
-#define CMD_SET_POWER      "PC%03u;" // Set power level (3 digits)
+// CAT commands for FT-991A: the prefix alone with ';' reads, the prefix followed by the
+// value in its fixed number of digits and ';' sets
+#define CMD_FREQ           "FA"      // Frequency in Hz
+#define FREQ_DIGITS        9
+#define CMD_MODE           "MD0"     // Mode of the main receiver
+#define MODE_DIGITS        1         // One hex digit, 1..E
+#define CMD_POWER          "PC"      // Power level in percent
+#define POWER_DIGITS       3
+#define CMD_PTT            "TX"      // 0 = receive, 1 = transmit by CAT, 2 = by PTT line or microphone
+#define CMD_INFO           "IF"      // Frequency, mode and status in one reply
+#define CMD_AUTO_INFO      "AI"      // 1 = report changes unasked
+
+// IF reply: IF, memory channel (3), frequency (9), clarifier (5), RX and TX clarifier
+// (1 each), mode (1 hex digit), then status fields up to the ';'
+#define INFO_FREQ_OFFSET   5
+#define INFO_MODE_OFFSET   21
+
+// MR reply and MW command: MR or MW, channel (3), then the same fields as IF from the
+// frequency on, with the tone setting where IF has the VFO/memory field
+#define CMD_MEMORY_READ    "MR"
+#define CMD_MEMORY_WRITE   "MW"
+#define MEMORY_CHANNELS    117       // 1-99, then the PMS pairs P1L-P9U
+#define MEMORY_FREQ_OFFSET 5
+#define MEMORY_CLAR_OFFSET 14        // Sign, then 4 digits
+#define MEMORY_RX_CLAR_OFFSET 19
+#define MEMORY_TX_CLAR_OFFSET 20
+#define MEMORY_MODE_OFFSET 21
+#define MEMORY_TONE_OFFSET 23
+#define MEMORY_SHIFT_OFFSET 26
+#define MEMORY_FRAME_SIZE  28
+
+// What MW accepts in each field
+#define MEMORY_MIN_FREQ    30000     // 30 kHz to 470 MHz
+#define MEMORY_MAX_FREQ    470000000
+#define MEMORY_MAX_CLAR    9999      // Hz either side
+#define MEMORY_MAX_MODE    0xE
+#define MEMORY_MAX_TONE    4         // Off, CTCSS encode/decode, CTCSS encode, DCS encode/decode, DCS encode
+#define MEMORY_MAX_SHIFT   2         // Simplex, plus, minus
+
+#define CMD_MATCH_SIZE     2         // A reply repeats the two-letter command
+#define MEMORY_MATCH_SIZE  5         // MR and the channel, so a late reply for another channel is skipped
 
 // Mode definitions for FT-991A
 #define MODE_LSB       1  // Lower Sideband
@@ -32,36 +63,119 @@
 #define MODE_DIG       9  // Digital
 #define MODE_PKT       10 // Packet
 
-#define RESP_BUF_SIZE 64
-static char command[RESP_BUF_SIZE];
-static char response[RESP_BUF_SIZE];
+#define RESP_BUF_SIZE CAT_RESPONSE_MAX_SIZE
 
-// Initialize the UART driver
-esp_err_t init_radio() {
-    if (cat_init() != ESP_OK) {
-        ESP_LOGE(TAG, "Failed to initialize UART for FT-857D");
+// Value field of a reply to `prefix`, right after the prefix
+static bool decode_field(const char *frame, size_t length, const char *prefix, int digits, int base, uint32_t *value) {
+    return codec_text_has_prefix(frame, length, prefix) &&
+           codec_decode_text_field(frame, length, strlen(prefix), digits, base, value) &&
+           length == strlen(prefix) + digits + 1;
+}
+
+static bool decode_information(const char *frame, size_t length, uint32_t *frequency, uint8_t *mode) {
+    uint32_t value;
+
+    if (!codec_text_has_prefix(frame, length, CMD_INFO) ||
+        !codec_decode_text_field(frame, length, INFO_FREQ_OFFSET, FREQ_DIGITS, CODEC_DECIMAL, frequency) ||
+        !codec_decode_text_field(frame, length, INFO_MODE_OFFSET, MODE_DIGITS, CODEC_HEX, &value)) {
+        return false;
+    }
+    *mode = value;
+    return true;
+}
+
+// Send the read command for `prefix` and decode the value in the reply
+static esp_err_t read_field(const char *prefix, int digits, int base, uint32_t *value) {
+    char command[CAT_COMMAND_MAX_SIZE];
+    char response[RESP_BUF_SIZE] = {0};
+
+    codec_encode_text(command, sizeof(command), prefix, 0, 0, CODEC_DECIMAL);
+    if (cat_transact_text(command, CMD_MATCH_SIZE, response, sizeof(response)) != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to read %s response", prefix);
         return ESP_FAIL;
     }
 
-    ESP_LOGI(TAG, "FT-991A initialized");
+    if (!decode_field(response, strlen(response), prefix, digits, base, value)) {
+        ESP_LOGE(TAG, "Failed to parse %s response: %s", prefix, response);
+        return ESP_FAIL;
+    }
     return ESP_OK;
 }
 
-// Get frequency from the FT-991A
-esp_err_t get_frequency(uint32_t *frequency) {
-    if (cat_send((uint8_t *)CMD_GET_FREQ, strlen(CMD_GET_FREQ)) != ESP_OK) {
-        ESP_LOGE(TAG, "Failed to send get frequency command");
+// Send the set command for `prefix`; sets get no reply
+static esp_err_t write_field(const char *prefix, uint32_t value, int digits, int base) {
+    char command[CAT_COMMAND_MAX_SIZE];
+
+    if (codec_encode_text(command, sizeof(command), prefix, value, digits, base) == 0) {
+        ESP_LOGE(TAG, "Value %lu does not fit %s", value, prefix);
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (cat_transact_text(command, 0, NULL, 0) != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to send %s command", prefix);
         return ESP_FAIL;
     }
+    ESP_LOGI(TAG, "Command sent: %s", command);
+    return ESP_OK;
+}
+
+// Auto Information frames: the radio reports each change as the reply it would give
+// to the matching read. Runs in the CAT task.
+static void on_auto_information(const uint8_t *frame, size_t length) {
+    const char *text = (const char *)frame;
+    uint32_t value;
+    uint32_t frequency;
+    uint8_t mode;
+
+    if (decode_field(text, length, CMD_FREQ, FREQ_DIGITS, CODEC_DECIMAL, &value)) {
+        radio_cache_push_frequency(value);
+    } else if (decode_field(text, length, CMD_MODE, MODE_DIGITS, CODEC_HEX, &value)) {
+        radio_cache_push_mode(value);
+    } else if (decode_field(text, length, CMD_POWER, POWER_DIGITS, CODEC_DECIMAL, &value)) {
+        radio_cache_push_power(value);
+    } else if (decode_field(text, length, CMD_PTT, 1, CODEC_DECIMAL, &value)) {
+        radio_cache_push_ptt(value != 0);
+    } else if (decode_information(text, length, &frequency, &mode)) {
+        radio_cache_push_frequency(frequency);
+        radio_cache_push_mode(mode);
+    } else {
+        ESP_LOGD(TAG, "Ignored frame: %s", text);
+    }
+}
+
+// Baud rate probe: read the Auto Information state and turn it on if the radio has lost
+// it, e.g. across a power cycle or while the rate was wrong
+static esp_err_t probe_radio(void) {
+    uint32_t auto_info;
+
+    esp_err_t err = read_field(CMD_AUTO_INFO, 1, CODEC_DECIMAL, &auto_info);
+    if (err != ESP_OK) {
+        return err;
+    }
+    if (auto_info != 1 && write_field(CMD_AUTO_INFO, 1, 1, CODEC_DECIMAL) != ESP_OK) {
+        ESP_LOGW(TAG, "Failed to turn on Auto Information, state will be polled");
+    }
+    return ESP_OK;
+}
 
-    if (cat_recv_until((uint8_t *)response, sizeof(response), ';') != ESP_OK) {
-        ESP_LOGE(TAG, "Failed to read get frequency response");
+// Initialize the UART driver. Once the baud rate probe has reached the radio, Auto
+// Information is on and frequency, mode, power and PTT changes reach the radio cache
+// without polling.
+esp_err_t init_radio() {
+    if (cat_init() != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to initialize UART for FT-991A");
         return ESP_FAIL;
     }
 
-    // Parse frequency from response (9 digits)
-    if (sscanf(response, "FA%9lu;", frequency) != 1) {
-        ESP_LOGE(TAG, "Failed to parse frequency from response");
+    cat_set_unsolicited_handler(on_auto_information, ';');
+    cat_start_baud_detect(probe_radio);
+
+    ESP_LOGI(TAG, "FT-991A initialized");
+    return ESP_OK;
+}
+
+// Get frequency from the FT-991A
+esp_err_t get_frequency(uint32_t *frequency) {
+    if (read_field(CMD_FREQ, FREQ_DIGITS, CODEC_DECIMAL, frequency) != ESP_OK) {
         return ESP_FAIL;
     }
 
@@ -71,76 +185,56 @@ esp_err_t get_frequency(uint32_t *frequency) {
 
 // Set frequency on the FT-991A
 esp_err_t set_frequency(uint32_t frequency) {
-    char command[RESP_BUF_SIZE] = {0};
+    return write_field(CMD_FREQ, frequency, FREQ_DIGITS, CODEC_DECIMAL);
+}
 
-    size_t len = snprintf(command, sizeof(command), CMD_SET_FREQ, frequency);
+// Get mode from the FT-991A
+esp_err_t get_mode(uint8_t *mode) {
+    uint32_t value;
 
-    if (cat_send((uint8_t *)command, len) != ESP_OK) {
-        ESP_LOGE(TAG, "Failed to set frequency");
+    if (read_field(CMD_MODE, MODE_DIGITS, CODEC_HEX, &value) != ESP_OK) {
         return ESP_FAIL;
     }
-    ESP_LOGI(TAG, "Set frequency command sent: %s", command);
 
+    *mode = value;
+    ESP_LOGI(TAG, "Mode: %u", *mode);
     return ESP_OK;
 }
 
-// Get mode from the FT-991A
-esp_err_t get_mode(uint8_t *mode) {
-    if (cat_send((uint8_t *)CMD_GET_MODE, strlen(CMD_GET_MODE)) != ESP_OK) {
-        ESP_LOGE(TAG, "Failed to send get mode command");
-        return ESP_FAIL;
-    }
+// Get frequency and mode from the FT-991A with one IF command
+esp_err_t get_frequency_and_mode(uint32_t *frequency, uint8_t *mode) {
+    char command[CAT_COMMAND_MAX_SIZE];
+    char response[RESP_BUF_SIZE] = {0};
 
-    if (cat_recv_until((uint8_t *)response, sizeof(response), ';') != ESP_OK) {
-        ESP_LOGE(TAG, "Failed to read get mode response");
+    codec_encode_text(command, sizeof(command), CMD_INFO, 0, 0, CODEC_DECIMAL);
+    if (cat_transact_text(command, CMD_MATCH_SIZE, response, sizeof(response)) != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to read get information response");
         return ESP_FAIL;
     }
 
-    // Parse mode from response (1 digit)
-    if (sscanf(response, "MD%1hhu;", mode) != 1) {
-        ESP_LOGE(TAG, "Failed to parse mode from response");
+    if (!decode_information(response, strlen(response), frequency, mode)) {
+        ESP_LOGE(TAG, "Failed to parse information response");
         return ESP_FAIL;
     }
 
-    ESP_LOGI(TAG, "Mode: %u", *mode);
+    ESP_LOGI(TAG, "Frequency: %lu Hz, mode: %u", *frequency, *mode);
     return ESP_OK;
 }
 
 // Set mode on the FT-991A
 esp_err_t set_mode(uint8_t mode) {
-    char command[RESP_BUF_SIZE] = {0};
-
-    size_t len = snprintf(command, sizeof(command), CMD_SET_MODE, mode);
-
-    if (cat_send((uint8_t *)command, len) != ESP_OK) {
-        ESP_LOGE(TAG, "Failed to set mode command");
-        return ESP_FAIL;
-    }
-    ESP_LOGI(TAG, "Set mode command sent: %s", command);
-
-    return ESP_OK;
+    return write_field(CMD_MODE, mode, MODE_DIGITS, CODEC_HEX);
 }
 
 // Get power level from the FT-991A
 esp_err_t get_power(uint8_t *power) {
-    if (cat_send((uint8_t *)CMD_GET_POWER, strlen(CMD_GET_POWER)) != ESP_OK) {
-        ESP_LOGE(TAG, "Failed to send get power command");
-        return ESP_FAIL;
-    }
-
-    if (cat_recv_until((uint8_t *)response, sizeof(response), ';') != ESP_OK) {
-        ESP_LOGE(TAG, "Failed to read get power response");
-        return ESP_FAIL;
-    }
+    uint32_t value;
 
-    // Parse power level from response (3 digits)
-    unsigned int power_level;
-    if (sscanf(response, "PC%03u;", &power_level) != 1) {
-        ESP_LOGE(TAG, "Failed to parse power level from response");
+    if (read_field(CMD_POWER, POWER_DIGITS, CODEC_DECIMAL, &value) != ESP_OK) {
         return ESP_FAIL;
     }
 
-    *power = (uint8_t)power_level;
+    *power = value;
     ESP_LOGI(TAG, "Power level: %u%%", *power);
     return ESP_OK;
 }
@@ -152,28 +246,156 @@ esp_err_t set_power(uint8_t power) {
         return ESP_ERR_INVALID_ARG;
     }
 
-    size_t len = snprintf(command, sizeof(command), CMD_SET_POWER, power);
+    return write_field(CMD_POWER, power, POWER_DIGITS, CODEC_DECIMAL);
+}
+
+// Set any of mode, power and frequency with one write, e.g. "MD03;PC005;FA007030000;"
+esp_err_t set_mode_power_frequency(uint8_t mode, uint8_t power, uint32_t frequency, uint8_t fields) {
+    if ((fields & RADIO_SET_POWER) && power > 100) {
+        ESP_LOGE(TAG, "Invalid power level: %u (must be between 0 and 100)", power);
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    cat_batch_t batch;
+    cat_batch_init(&batch);
+    if (fields & RADIO_SET_MODE) {
+        cat_batch_add(&batch, CMD_MODE, mode, MODE_DIGITS, CODEC_HEX);
+    }
+    if (fields & RADIO_SET_POWER) {
+        cat_batch_add(&batch, CMD_POWER, power, POWER_DIGITS, CODEC_DECIMAL);
+    }
+    if (fields & RADIO_SET_FREQUENCY) {
+        cat_batch_add(&batch, CMD_FREQ, frequency, FREQ_DIGITS, CODEC_DECIMAL);
+    }
 
-    if (cat_send((uint8_t *)command, len) != ESP_OK) {
-        ESP_LOGE(TAG, "Failed to set power command");
+    if (cat_batch_send(&batch) != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to send command batch");
         return ESP_FAIL;
     }
-    ESP_LOGI(TAG, "Set power command sent: %s", command);
+    ESP_LOGI(TAG, "Command batch sent: %s", batch.data);
 
-    ESP_LOGI(TAG, "Power level set to: %u%%", power);
     return ESP_OK;
 }
 
 // Set PTT (Push-to-Talk) on the FT-991A
 esp_err_t set_ptt(bool enable) {
-    strcpy(command, enable ? CMD_PTT_ON : CMD_PTT_OFF);
+    return write_field(CMD_PTT, enable ? 1 : 0, 1, CODEC_DECIMAL);
+}
 
-    if (cat_send((uint8_t *)command, strlen(command)) != ESP_OK) {
-        ESP_LOGE(TAG, "Failed to send PTT command");
-        return ESP_FAIL;
+uint16_t memory_channel_count(void) {
+    return MEMORY_CHANNELS;
+}
+
+// "MRnnn;", pipelined so a backup keeps the line busy
+esp_err_t memory_read_request(uint16_t channel, cat_request_t *request) {
+    if (channel < 1 || channel > MEMORY_CHANNELS) {
+        return ESP_ERR_INVALID_ARG;
     }
-    ESP_LOGI(TAG, "PTT command sent: %s", command);
 
+    *request = (cat_request_t){
+        .frame = CAT_FRAME_TERMINATED,
+        .terminator = ';',
+        .match_size = MEMORY_MATCH_SIZE,
+        .pipelined = true,
+    };
+    request->command_size = codec_encode_text((char *)request->command, sizeof(request->command), CMD_MEMORY_READ, channel, 3, CODEC_DECIMAL);
+    return ESP_OK;
+}
+
+// The radio answers MR for an empty channel with "?;"
+esp_err_t memory_decode(uint16_t channel, esp_err_t result, const uint8_t *response, size_t length, radio_memory_t *memory) {
+    const char *frame = (const char *)response;
+    uint32_t number, frequency, clarifier, rx_clarifier, tx_clarifier, mode, tone, shift;
+
+    if (result == ESP_ERR_INVALID_RESPONSE) {
+        return ESP_ERR_NOT_FOUND;
+    }
+    if (result != ESP_OK) {
+        return result;
+    }
+
+    if (length != MEMORY_FRAME_SIZE || !codec_text_has_prefix(frame, length, CMD_MEMORY_READ) ||
+        !codec_decode_text_field(frame, length, 2, 3, CODEC_DECIMAL, &number) ||
+        !codec_decode_text_field(frame, length, MEMORY_FREQ_OFFSET, FREQ_DIGITS, CODEC_DECIMAL, &frequency) ||
+        (frame[MEMORY_CLAR_OFFSET] != '+' && frame[MEMORY_CLAR_OFFSET] != '-') ||
+        !codec_decode_text_field(frame, length, MEMORY_CLAR_OFFSET + 1, 4, CODEC_DECIMAL, &clarifier) ||
+        !codec_decode_text_field(frame, length, MEMORY_RX_CLAR_OFFSET, 1, CODEC_DECIMAL, &rx_clarifier) ||
+        !codec_decode_text_field(frame, length, MEMORY_TX_CLAR_OFFSET, 1, CODEC_DECIMAL, &tx_clarifier) ||
+        !codec_decode_text_field(frame, length, MEMORY_MODE_OFFSET, MODE_DIGITS, CODEC_HEX, &mode) ||
+        !codec_decode_text_field(frame, length, MEMORY_TONE_OFFSET, 1, CODEC_DECIMAL, &tone) ||
+        !codec_decode_text_field(frame, length, MEMORY_SHIFT_OFFSET, 1, CODEC_DECIMAL, &shift) ||
+        number != channel) {
+        ESP_LOGE(TAG, "Failed to parse memory channel %u: %s", channel, frame);
+        return ESP_ERR_INVALID_RESPONSE;
+    }
+
+    *memory = (radio_memory_t){
+        .channel = channel,
+        .frequency = frequency,
+        .clarifier = frame[MEMORY_CLAR_OFFSET] == '-' ? -(int16_t)clarifier : (int16_t)clarifier,
+        .mode = mode,
+        .flags = (rx_clarifier ? RADIO_MEMORY_RX_CLARIFIER : 0) | (tx_clarifier ? RADIO_MEMORY_TX_CLARIFIER : 0),
+        .tone = tone,
+        .shift = shift,
+    };
+    return ESP_OK;
+}
+
+// Append `value` in `digits` digits to a command being built, without the ';'. Returns
+// the new length, or 0 if it does not fit. A length of 0 stays 0, so after the first
+// failure the rest of the appends fail too.
+static size_t append_digits(char *command, size_t size, size_t length, uint32_t value, int digits, int base) {
+    if (length == 0) {
+        return 0;
+    }
+    size_t added = codec_encode_text(command + length, size - length, "", value, digits, base);
+    return added == 0 ? 0 : length + added - 1;
+}
+
+static size_t append_char(char *command, size_t size, size_t length, char c) {
+    if (length == 0 || length >= size) {
+        return 0;
+    }
+    command[length] = c;
+    return length + 1;
+}
+
+// "MWnnn...;" with the fields in MR order. MW gets no reply; a rejected write shows up as
+// an unmatched "?;". Fields out of range are refused here rather than by the radio, so a
+// backup can be checked with this before anything is written.
+esp_err_t memory_write_request(const radio_memory_t *memory, cat_request_t *request) {
+    char *command = (char *)request->command;
+    size_t size = sizeof(request->command);
+    uint16_t clarifier = memory->clarifier < 0 ? -memory->clarifier : memory->clarifier;
+
+    if (memory->channel < 1 || memory->channel > MEMORY_CHANNELS || memory->frequency < MEMORY_MIN_FREQ ||
+        memory->frequency > MEMORY_MAX_FREQ || clarifier > MEMORY_MAX_CLAR || memory->mode < 1 ||
+        memory->mode > MEMORY_MAX_MODE || memory->tone > MEMORY_MAX_TONE || memory->shift > MEMORY_MAX_SHIFT) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    *request = (cat_request_t){
+        .frame = CAT_FRAME_NONE,
+        .pipelined = true,
+    };
+    size_t length = codec_encode_text(command, size, CMD_MEMORY_WRITE, memory->channel, 3, CODEC_DECIMAL);
+    length = length == 0 ? 0 : length - 1; // Without the ';'
+    length = append_digits(command, size, length, memory->frequency, FREQ_DIGITS, CODEC_DECIMAL);
+    length = append_char(command, size, length, memory->clarifier < 0 ? '-' : '+');
+    length = append_digits(command, size, length, clarifier, 4, CODEC_DECIMAL);
+    length = append_digits(command, size, length, (memory->flags & RADIO_MEMORY_RX_CLARIFIER) ? 1 : 0, 1, CODEC_DECIMAL);
+    length = append_digits(command, size, length, (memory->flags & RADIO_MEMORY_TX_CLARIFIER) ? 1 : 0, 1, CODEC_DECIMAL);
+    length = append_digits(command, size, length, memory->mode, MODE_DIGITS, CODEC_HEX);
+    length = append_digits(command, size, length, 0, 1, CODEC_DECIMAL); // VFO/memory, ignored by MW
+    length = append_digits(command, size, length, memory->tone, 1, CODEC_DECIMAL);
+    length = append_digits(command, size, length, 0, 2, CODEC_DECIMAL);
+    length = append_digits(command, size, length, memory->shift, 1, CODEC_DECIMAL);
+    length = append_char(command, size, length, ';');
+    if (length == 0) {
+        ESP_LOGE(TAG, "Memory channel %u does not fit an MW command", memory->channel);
+        return ESP_ERR_INVALID_ARG;
+    }
+    request->command_size = length;
     return ESP_OK;
 }
 
@@ -204,5 +426,5 @@ const char *mode_to_string(uint8_t mode) {
         default: return "UNKNOWN";
     }
 }
-#endif // CONFIG_RADIO_FT991A
+#endif // CONFIG_RADIO_PROTOCOL_FT991A
 
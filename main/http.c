@@ -9,23 +9,37 @@
 static const char *TAG = "HTTP";
 static httpd_handle_t server = NULL;
 
-void register_html_page(const char *uri, httpd_method_t method, esp_err_t handler(httpd_req_t *)) {
+static void register_uri(const httpd_uri_t *page_uri) {
     if (server == NULL) {
         ESP_LOGE(TAG, "Web server is not running. Cannot register URI.");
         return;
     }
 
+    esp_err_t err = httpd_register_uri_handler(server, page_uri);
+    if (err == ESP_OK) {
+        ESP_LOGI(TAG, "Registered URI: %s", page_uri->uri);
+    } else {
+        ESP_LOGE(TAG, "Failed to register URI: %s", page_uri->uri);
+    }
+}
+
+void register_html_page(const char *uri, httpd_method_t method, esp_err_t handler(httpd_req_t *)) {
     httpd_uri_t page_uri = {
         .uri = uri,
         .method = method,
         .handler = handler};
 
-    esp_err_t err = httpd_register_uri_handler(server, &page_uri);
-    if (err == ESP_OK) {
-        ESP_LOGI(TAG, "Registered URI: %s", uri);
-    } else {
-        ESP_LOGE(TAG, "Failed to register URI: %s", uri);
-    }
+    register_uri(&page_uri);
+}
+
+void register_websocket(const char *uri, esp_err_t handler(httpd_req_t *)) {
+    httpd_uri_t ws_uri = {
+        .uri = uri,
+        .method = HTTP_GET,
+        .handler = handler,
+        .is_websocket = true};
+
+    register_uri(&ws_uri);
 }
 
 static esp_err_t redirect_handler(httpd_req_t *req) {
@@ -83,7 +97,7 @@ static esp_err_t file_handler(httpd_req_t *req) {
 
 bool start_webserver(void) {
     httpd_config_t config = HTTPD_DEFAULT_CONFIG();
-    config.max_uri_handlers = 10;
+    config.max_uri_handlers = 24;
 
     if (httpd_start(&server, &config) == ESP_OK) {
         ESP_LOGI(TAG, "Web server started");
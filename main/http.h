@@ -9,5 +9,6 @@
 bool start_webserver(void);
 void stop_webserver(void);
 void register_html_page(const char *uri, httpd_method_t method, esp_err_t handler(httpd_req_t *));
+void register_websocket(const char *uri, esp_err_t handler(httpd_req_t *));
 
 #endif // HTTP_H
@@ -0,0 +1,43 @@
+#ifndef KEYER_H
+#define KEYER_H
+
+#include "esp_err.h"
+#include "sdkconfig.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// One step of a keying schedule: hold the key at `level` for `duration_us`
+typedef struct {
+    uint32_t level : 1;
+    uint32_t duration_us : 31;
+} keyer_run_t;
+
+// Pulls the next run of live keying (the paddles), called from interrupt context.
+// Returns false once there is nothing more to key.
+typedef bool (*keyer_source_t)(keyer_run_t *run);
+
+esp_err_t keyer_init(void);
+esp_err_t keyer_play(const keyer_run_t *runs, size_t count, bool enable_key);
+void keyer_abort(void);
+
+// Live keying breaks in on a schedule being played, whose keyer_play() then returns
+// ESP_ERR_NOT_FINISHED. Until the source runs dry keyer_play() refuses schedules with
+// ESP_ERR_INVALID_STATE, and keyer_live_idle_us() says how long ago it did, or 0 while
+// the paddles have the key, so callers can hold what they have to send until then.
+void keyer_set_live_source(keyer_source_t source);
+bool keyer_start_live_from_isr(void);
+bool keyer_start_live(void); // The same from a task, for a press held back until PTT is on
+int64_t keyer_live_idle_us(void);
+
+#ifdef CONFIG_KEYER_SIM
+// Edge recorded by the simulated backend, relative to the start of the schedule
+typedef struct {
+    uint32_t time_us;
+    bool level;
+} keyer_sim_edge_t;
+
+size_t keyer_sim_get_edges(const keyer_sim_edge_t **edges);
+#endif // CONFIG_KEYER_SIM
+
+#endif // KEYER_H
@@ -0,0 +1,254 @@
+#include "driver/gptimer.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "gpio.h"
+#include "keyer.h"
+#include "sidetone.h"
+#include "sdkconfig.h"
+
+#ifdef CONFIG_KEYER_GPTIMER
+#define TAG "KEYER"
+#define TIMER_RESOLUTION_HZ 1000000 // 1 tick = 1 us
+
+static gptimer_handle_t timer = NULL;
+static SemaphoreHandle_t done_semaphore = NULL;
+static portMUX_TYPE keyer_lock = portMUX_INITIALIZER_UNLOCKED;
+
+// Schedule being played, only touched by the alarm ISR while the timer runs
+static const keyer_run_t *schedule;
+static size_t schedule_length;
+static size_t position;
+static bool key_enabled;
+static bool playing = false;
+static bool aborted = false;
+
+// Live keying, pulled one run at a time by the alarm ISR
+static keyer_source_t live_source = NULL;
+static bool live = false;
+static int64_t live_ended_us = -1; // When the source last ran dry, -1 if it never has
+
+static inline void set_output(bool level) {
+    if (level) {
+        if (key_enabled) {
+            key_down();
+        }
+        led_on();
+        sidetone_on();
+    } else {
+        if (key_enabled) {
+            key_up();
+        }
+        led_off();
+        sidetone_off();
+    }
+}
+
+static inline void set_alarm(gptimer_handle_t gptimer, uint64_t alarm_count) {
+    gptimer_alarm_config_t alarm_config = {
+        .alarm_count = alarm_count,
+    };
+    gptimer_set_alarm_action(gptimer, &alarm_config);
+}
+
+// Alarm fires at the end of each run; switch to the next one and rearm at its absolute end time
+static bool IRAM_ATTR on_alarm(gptimer_handle_t gptimer, const gptimer_alarm_event_data_t *edata, void *user_ctx) {
+    BaseType_t high_task_woken = pdFALSE;
+
+    if (live) {
+        keyer_run_t run;
+        portENTER_CRITICAL_ISR(&keyer_lock);
+        if (live_source(&run)) {
+            set_output(run.level);
+            set_alarm(gptimer, edata->alarm_value + run.duration_us);
+        } else {
+            live = false;
+            live_ended_us = esp_timer_get_time();
+            set_output(false);
+            gptimer_stop(gptimer);
+        }
+        portEXIT_CRITICAL_ISR(&keyer_lock);
+        return false;
+    }
+
+    position++;
+    if (position >= schedule_length) {
+        portENTER_CRITICAL_ISR(&keyer_lock);
+        if (playing) {
+            playing = false;
+            set_output(false);
+            gptimer_stop(gptimer);
+            xSemaphoreGiveFromISR(done_semaphore, &high_task_woken);
+        }
+        portEXIT_CRITICAL_ISR(&keyer_lock);
+        return high_task_woken == pdTRUE;
+    }
+
+    set_output(schedule[position].level);
+    set_alarm(gptimer, edata->alarm_value + schedule[position].duration_us);
+
+    return false;
+}
+
+esp_err_t keyer_init(void) {
+    done_semaphore = xSemaphoreCreateBinary();
+    if (done_semaphore == NULL) {
+        ESP_LOGE(TAG, "Failed to create semaphore");
+        return ESP_FAIL;
+    }
+
+    gptimer_config_t timer_config = {
+        .clk_src = GPTIMER_CLK_SRC_DEFAULT,
+        .direction = GPTIMER_COUNT_UP,
+        .resolution_hz = TIMER_RESOLUTION_HZ,
+    };
+    if (gptimer_new_timer(&timer_config, &timer) != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to create timer");
+        return ESP_FAIL;
+    }
+
+    gptimer_event_callbacks_t callbacks = {
+        .on_alarm = on_alarm,
+    };
+    if (gptimer_register_event_callbacks(timer, &callbacks, NULL) != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to register timer callback");
+        return ESP_FAIL;
+    }
+
+    if (gptimer_enable(timer) != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to enable timer");
+        return ESP_FAIL;
+    }
+
+    ESP_LOGI(TAG, "GPTimer keyer initialized");
+    return ESP_OK;
+}
+
+// Play a schedule and block until the last run has finished
+esp_err_t keyer_play(const keyer_run_t *runs, size_t count, bool enable_key) {
+    if (timer == NULL) {
+        ESP_LOGE(TAG, "Keyer not initialized");
+        return ESP_ERR_INVALID_STATE;
+    }
+    if (count == 0) {
+        return ESP_OK;
+    }
+
+    portENTER_CRITICAL(&keyer_lock);
+    if (live) {
+        portEXIT_CRITICAL(&keyer_lock);
+        return ESP_ERR_INVALID_STATE; // The paddles have the key
+    }
+
+    schedule = runs;
+    schedule_length = count;
+    position = 0;
+    key_enabled = enable_key;
+    aborted = false;
+    playing = true;
+
+    gptimer_set_raw_count(timer, 0);
+    set_alarm(timer, runs[0].duration_us);
+
+    set_output(runs[0].level);
+    esp_err_t err = gptimer_start(timer);
+    if (err != ESP_OK) {
+        playing = false;
+        set_output(false);
+    }
+    portEXIT_CRITICAL(&keyer_lock);
+
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to start timer");
+        return ESP_FAIL;
+    }
+
+    xSemaphoreTake(done_semaphore, portMAX_DELAY);
+    return aborted ? ESP_ERR_NOT_FINISHED : ESP_OK;
+}
+
+// Stop the schedule being played right away and leave the key up
+void keyer_abort(void) {
+    portENTER_CRITICAL(&keyer_lock);
+    if (playing) {
+        playing = false;
+        aborted = true;
+        gptimer_stop(timer);
+        set_output(false);
+        xSemaphoreGive(done_semaphore);
+    }
+    portEXIT_CRITICAL(&keyer_lock);
+}
+
+void keyer_set_live_source(keyer_source_t source) {
+    live_source = source;
+}
+
+int64_t keyer_live_idle_us(void) {
+    portENTER_CRITICAL(&keyer_lock);
+    int64_t idle_us = live ? 0 : live_ended_us < 0 ? INT64_MAX : esp_timer_get_time() - live_ended_us;
+    portEXIT_CRITICAL(&keyer_lock);
+    return idle_us;
+}
+
+// Key the first live run and cut short any schedule being played, which the caller then
+// wakes. Caller must hold keyer_lock. Returns true if a schedule was cut short.
+static bool IRAM_ATTR start_live(void) {
+    keyer_run_t run;
+    bool broke_in = false;
+
+    if (!live && live_source(&run)) {
+        if (playing) {
+            playing = false;
+            aborted = true;
+            broke_in = true;
+            gptimer_stop(timer);
+        }
+
+        live = true;
+        key_enabled = true;
+        gptimer_set_raw_count(timer, 0);
+        set_alarm(timer, run.duration_us);
+        set_output(run.level);
+        gptimer_start(timer);
+    }
+    return broke_in;
+}
+
+// Key the first live run straight from the caller's ISR, so a paddle press goes out within
+// microseconds. Returns true if a schedule was cut short.
+bool IRAM_ATTR keyer_start_live_from_isr(void) {
+    BaseType_t high_task_woken = pdFALSE;
+
+    if (timer == NULL || live_source == NULL) {
+        return false;
+    }
+
+    portENTER_CRITICAL_ISR(&keyer_lock);
+    bool broke_in = start_live();
+    if (broke_in) {
+        xSemaphoreGiveFromISR(done_semaphore, &high_task_woken);
+    }
+    portEXIT_CRITICAL_ISR(&keyer_lock);
+
+    if (high_task_woken == pdTRUE) {
+        portYIELD_FROM_ISR();
+    }
+    return broke_in;
+}
+
+bool keyer_start_live(void) {
+    if (timer == NULL || live_source == NULL) {
+        return false;
+    }
+
+    portENTER_CRITICAL(&keyer_lock);
+    bool broke_in = start_live();
+    if (broke_in) {
+        xSemaphoreGive(done_semaphore);
+    }
+    portEXIT_CRITICAL(&keyer_lock);
+    return broke_in;
+}
+#endif // CONFIG_KEYER_GPTIMER
@@ -0,0 +1,146 @@
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "keyer.h"
+#include "sdkconfig.h"
+
+#ifdef CONFIG_KEYER_SIM
+#define TAG "KEYER_SIM"
+#define MAX_EDGES 1024
+
+// Edges of the last schedule, timed against a virtual microsecond clock
+static keyer_sim_edge_t edges[MAX_EDGES];
+static size_t edge_count = 0;
+static SemaphoreHandle_t abort_semaphore = NULL;
+
+// Live keying is stepped by an esp_timer and recorded against the real clock
+static keyer_source_t live_source = NULL;
+static esp_timer_handle_t live_timer = NULL;
+static volatile bool live = false;
+static volatile bool playing = false;
+static int64_t live_start_us;
+static volatile int64_t live_ended_us = -1; // When the source last ran dry, -1 if it never has
+
+static void record_edge(uint32_t time_us, bool level) {
+    if (edge_count > 0 && edges[edge_count - 1].level == level) {
+        return; // No transition
+    }
+    if (edge_count >= MAX_EDGES) {
+        return;
+    }
+    edges[edge_count].time_us = time_us;
+    edges[edge_count].level = level;
+    edge_count++;
+}
+
+static void live_step(void *arg) {
+    keyer_run_t run;
+    uint32_t now_us = (uint32_t)(esp_timer_get_time() - live_start_us);
+
+    if (live_source(&run)) {
+        record_edge(now_us, run.level);
+        esp_timer_start_once(live_timer, run.duration_us);
+    } else {
+        record_edge(now_us, false);
+        live_ended_us = esp_timer_get_time();
+        live = false;
+        ESP_LOGI(TAG, "Live keying done, %u edges, %lu us", edge_count, now_us);
+    }
+}
+
+esp_err_t keyer_init(void) {
+    abort_semaphore = xSemaphoreCreateBinary();
+    if (abort_semaphore == NULL) {
+        ESP_LOGE(TAG, "Failed to create semaphore");
+        return ESP_FAIL;
+    }
+
+    const esp_timer_create_args_t timer_args = {
+        .callback = live_step,
+        .name = "keyer_sim_live",
+    };
+    if (esp_timer_create(&timer_args, &live_timer) != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to create live timer");
+        return ESP_FAIL;
+    }
+
+    ESP_LOGI(TAG, "Simulated keyer initialized");
+    return ESP_OK;
+}
+
+esp_err_t keyer_play(const keyer_run_t *runs, size_t count, bool enable_key) {
+    uint32_t now_us = 0;
+
+    if (live) {
+        return ESP_ERR_INVALID_STATE; // The paddles have the key
+    }
+
+    edge_count = 0;
+    for (size_t i = 0; i < count; i++) {
+        record_edge(now_us, runs[i].level);
+        now_us += runs[i].duration_us;
+    }
+    record_edge(now_us, false);
+
+    for (size_t i = 0; i < edge_count; i++) {
+        ESP_LOGD(TAG, "%10lu us: key %s", edges[i].time_us, edges[i].level ? "down" : "up");
+    }
+    ESP_LOGI(TAG, "Played %u runs, %u edges, %lu us total (key %s)", count, edge_count, now_us,
+             enable_key ? "enabled" : "disabled");
+
+    // Hold the caller for the real duration so queueing behaves as on hardware
+    xSemaphoreTake(abort_semaphore, 0);
+    playing = true;
+    BaseType_t aborted = xSemaphoreTake(abort_semaphore, pdMS_TO_TICKS(now_us / 1000));
+    playing = false;
+    if (aborted == pdTRUE) {
+        ESP_LOGI(TAG, "Playback aborted");
+        return ESP_ERR_NOT_FINISHED;
+    }
+    return ESP_OK;
+}
+
+void keyer_abort(void) {
+    xSemaphoreGive(abort_semaphore);
+}
+
+void keyer_set_live_source(keyer_source_t source) {
+    live_source = source;
+}
+
+int64_t keyer_live_idle_us(void) {
+    if (live) {
+        return 0;
+    }
+    return live_ended_us < 0 ? INT64_MAX : esp_timer_get_time() - live_ended_us;
+}
+
+// Unlike the hardware backend the first run is keyed from the timer task, not the ISR
+bool keyer_start_live_from_isr(void) {
+    if (live || live_source == NULL || live_timer == NULL) {
+        return false;
+    }
+
+    live = true;
+    edge_count = 0;
+    live_start_us = esp_timer_get_time();
+    esp_timer_start_once(live_timer, 0);
+
+    if (!playing) {
+        return false;
+    }
+    xSemaphoreGiveFromISR(abort_semaphore, NULL); // Break in on a schedule being played
+    return true;
+}
+
+// Safe from a task as it is, the timer task doing the keying here
+bool keyer_start_live(void) {
+    return keyer_start_live_from_isr();
+}
+
+size_t keyer_sim_get_edges(const keyer_sim_edge_t **out) {
+    *out = edges;
+    return edge_count;
+}
+#endif // CONFIG_KEYER_SIM
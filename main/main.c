@@ -1,12 +1,17 @@
 #include "button.h"
+#include "contest.h"
 #include "esp_log.h"
 #include "esp_littlefs.h"
 #include "freertos/FreeRTOS.h"
 #include "http.h"
+#include "memory_backup.h"
 #include "message.h"
 #include "morse.h"
 #include "network.h"
+#include "paddle.h"
+#include "ptt.h"
 #include "radio.h"
+#include "rigctld.h"
 #include "settings.h"
 #include "status.h"
 
@@ -51,6 +56,9 @@ void app_main(void) {
     ESP_LOGI(TAG, "Loaded settings: WPM=%d, AP SSID=%s, STA SSID=%s", wpm,
              ap_ssid, sta_ssid);
 
+    contest_init();
+    message_init();
+
     wifi_init();
 
     if (!start_webserver()) {
@@ -60,16 +68,22 @@ void app_main(void) {
 
     button_init();
 
+    register_contest_endpoints();
+    register_memory_endpoints();
     register_message_endpoints();
     register_morse_endpoints();
+    register_paddle_endpoints();
     register_settings_endpoints();
     register_status_endpoints();
 
     morse_code_init();
+    paddle_init();
 
     init_radio();
+    ptt_init();
+    rigctld_init();
 
-    queue_morse_code("READY", false);
+    queue_morse_code("READY", false, false);
 
     ESP_LOGI("MAIN", "Application started");
 }
@@ -0,0 +1,495 @@
+#include "memory_backup.h"
+#include "cat.h"
+#include "esp_err.h"
+#include "esp_http_server.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+#include "radio.h"
+#include <stdio.h>
+#include <string.h>
+
+static const char *TAG = "MEMORY";
+
+#define TEMP_PATH HTML_MOUNT_POINT "/memories.tmp"
+#define MAGIC "CWKM"
+#define HEADER_SIZE 8
+#define RECORD_SIZE 12
+#define RECORDS_PER_CHUNK 8 // Records sent to the browser at a time, about 0.5 s of reads at 4800 baud
+#define IN_FLIGHT (CAT_CLIENT_QUEUE_LENGTH + CAT_PIPELINE_DEPTH) // Queued plus on the wire
+#define RESULT_TIMEOUT_MS 5000 // Well past the longest CAT timeout
+#define ATTEMPTS 3 // At a read, or a write and its read-back; one lost on the line fails those behind it
+#define FAILED_REPORT_MAX 16 // Channels listed in a restore's response
+
+// A request's callback argument: the channel, and which attempt at it this is
+#define REQUEST_ARG(channel, attempt) ((uint32_t)(attempt) << 16 | (channel))
+#define ARG_CHANNEL(arg) ((uint16_t)(uintptr_t)(arg))
+#define ARG_ATTEMPT(arg) ((uint8_t)((uintptr_t)(arg) >> 16))
+
+typedef struct {
+    esp_err_t result;
+    uint8_t attempt;
+    bool write; // Of an MW, which only says that it was sent
+    radio_memory_t memory;
+} memory_result_t;
+
+// One record being restored. MW gets no reply, so each write is followed by an MR of the
+// channel, and the read-back is what shows whether the radio took it: a rejected MW
+// answers "?;", which the MR behind it takes as its own.
+typedef struct {
+    radio_memory_t memory;
+    uint8_t attempt;
+    bool written; // MW submitted, the read-back not yet
+} restore_t;
+
+// Results in the order the requests were submitted, filled by the CAT task. The web
+// server runs one handler at a time, so there is only ever one transfer.
+static QueueHandle_t results = NULL;
+
+static void put_u16(uint8_t *data, uint16_t value) {
+    data[0] = value;
+    data[1] = value >> 8;
+}
+
+static void put_u32(uint8_t *data, uint32_t value) {
+    put_u16(data, value);
+    put_u16(data + 2, value >> 16);
+}
+
+static uint16_t get_u16(const uint8_t *data) {
+    return data[0] | data[1] << 8;
+}
+
+static uint32_t get_u32(const uint8_t *data) {
+    return get_u16(data) | (uint32_t)get_u16(data + 2) << 16;
+}
+
+static size_t encode_header(uint8_t *data, uint16_t channels) {
+    memcpy(data, MAGIC, 4);
+    data[4] = MEMORY_BACKUP_VERSION;
+    data[5] = 0;
+    put_u16(data + 6, channels);
+    return HEADER_SIZE;
+}
+
+static size_t encode_record(uint8_t *data, const radio_memory_t *memory) {
+    put_u16(data, memory->channel);
+    put_u32(data + 2, memory->frequency);
+    put_u16(data + 6, (uint16_t)memory->clarifier);
+    data[8] = memory->mode;
+    data[9] = memory->flags;
+    data[10] = memory->tone;
+    data[11] = memory->shift;
+    return RECORD_SIZE;
+}
+
+static void decode_record(const uint8_t *data, radio_memory_t *memory) {
+    *memory = (radio_memory_t){
+        .channel = get_u16(data),
+        .frequency = get_u32(data + 2),
+        .clarifier = (int16_t)get_u16(data + 6),
+        .mode = data[8],
+        .flags = data[9],
+        .tone = data[10],
+        .shift = data[11],
+    };
+}
+
+// Runs on the CAT task, so it only decodes and hands the result over
+static void read_callback(esp_err_t result, const uint8_t *response, size_t length, void *arg) {
+    memory_result_t item = {.attempt = ARG_ATTEMPT(arg), .memory.channel = ARG_CHANNEL(arg)};
+
+    item.result = memory_decode(item.memory.channel, result, response, length, &item.memory);
+    xQueueSend(results, &item, 0); // Never full: it holds every request in flight
+}
+
+static void write_callback(esp_err_t result, const uint8_t *response, size_t length, void *arg) {
+    memory_result_t item = {.result = result, .attempt = ARG_ATTEMPT(arg), .write = true, .memory.channel = ARG_CHANNEL(arg)};
+
+    xQueueSend(results, &item, 0);
+}
+
+// Submit a request if there is room for its result. The CAT task pipelines what it finds
+// queued, so keeping IN_FLIGHT requests submitted keeps the line busy with no round trip
+// per channel. Returns false if the request has to wait for a result first.
+static bool submit(cat_request_t *request, cat_callback_t callback, uint32_t arg, int *in_flight) {
+    if (*in_flight >= IN_FLIGHT) {
+        return false;
+    }
+    request->callback = callback;
+    request->arg = (void *)(uintptr_t)arg;
+    if (cat_submit(request) != ESP_OK) {
+        return false; // The queue is shared with other tasks that never registered
+    }
+    (*in_flight)++;
+    return true;
+}
+
+// Submit a record's write and read-back. Returns false if there was not room for both;
+// what was submitted is remembered, so calling again goes on from there.
+static bool submit_restore(restore_t *restore, int *in_flight) {
+    cat_request_t request;
+    uint32_t arg = REQUEST_ARG(restore->memory.channel, restore->attempt);
+
+    if (!restore->written) {
+        memory_write_request(&restore->memory, &request);
+        if (!submit(&request, write_callback, arg, in_flight)) {
+            return false;
+        }
+        restore->written = true;
+    }
+    memory_read_request(restore->memory.channel, &request);
+    return submit(&request, read_callback, arg, in_flight);
+}
+
+static bool same_memory(const radio_memory_t *a, const radio_memory_t *b) {
+    return a->channel == b->channel && a->frequency == b->frequency && a->clarifier == b->clarifier &&
+           a->mode == b->mode && a->flags == b->flags && a->tone == b->tone && a->shift == b->shift;
+}
+
+static void add_failed(uint16_t *failed, int *failed_count, uint16_t channel) {
+    if (*failed_count < FAILED_REPORT_MAX) {
+        failed[*failed_count] = channel;
+    }
+    (*failed_count)++;
+}
+
+static esp_err_t next_result(memory_result_t *item, int *in_flight) {
+    if (*in_flight == 0) {
+        return ESP_FAIL; // Nothing submitted, so nothing will arrive
+    }
+    if (xQueueReceive(results, item, pdMS_TO_TICKS(RESULT_TIMEOUT_MS)) != pdTRUE) {
+        ESP_LOGE(TAG, "No result from the CAT task");
+        return ESP_ERR_TIMEOUT;
+    }
+    (*in_flight)--;
+    return ESP_OK;
+}
+
+// Wait out the requests still in flight after an error, so their results do not turn
+// up in the next transfer
+static void drain(int in_flight) {
+    memory_result_t item;
+
+    while (next_result(&item, &in_flight) == ESP_OK) {
+    }
+}
+
+static esp_err_t flush_chunk(httpd_req_t *req, FILE *file, const uint8_t *chunk, size_t size) {
+    if (fwrite(chunk, 1, size, file) != size) {
+        ESP_LOGE(TAG, "Failed to write %s", TEMP_PATH);
+        return ESP_FAIL;
+    }
+    return httpd_resp_send_chunk(req, (const char *)chunk, size);
+}
+
+// Reads every channel, sending the records to the browser and to the backup file as
+// they arrive. Empty channels are left out. A failed read is tried again, up to
+// ATTEMPTS in all; the file replaces the last backup only once the whole radio has
+// been read.
+static esp_err_t get_memories_handler(httpd_req_t *req) {
+    uint16_t channels = memory_channel_count();
+    if (channels == 0) {
+        httpd_resp_send_err(req, HTTPD_501_METHOD_NOT_IMPLEMENTED, "The radio has no CAT access to its memories");
+        return ESP_FAIL;
+    }
+
+    FILE *file = fopen(TEMP_PATH, "wb");
+    if (!file) {
+        ESP_LOGE(TAG, "Failed to open %s", TEMP_PATH);
+        httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Failed to open backup file");
+        return ESP_FAIL;
+    }
+
+    httpd_resp_set_type(req, "application/octet-stream");
+    httpd_resp_set_hdr(req, "Content-Disposition", "attachment; filename=\"memories.bin\"");
+    xQueueReset(results);
+
+    uint8_t chunk[HEADER_SIZE + RECORDS_PER_CHUNK * RECORD_SIZE];
+    size_t size = encode_header(chunk, channels);
+    int64_t start_us = esp_timer_get_time();
+    uint16_t next = 1;
+    int in_flight = 0;
+    int saved = 0;
+    int retries = 0;
+    memory_result_t retry = {0}; // A failed read to submit again, channel 0 if none
+    esp_err_t err = ESP_OK;
+
+    for (uint16_t done = 0; done < channels && err == ESP_OK;) {
+        cat_request_t request;
+        if (retry.memory.channel != 0 && memory_read_request(retry.memory.channel, &request) == ESP_OK &&
+            submit(&request, read_callback, REQUEST_ARG(retry.memory.channel, retry.attempt + 1), &in_flight)) {
+            retry.memory.channel = 0;
+        }
+        while (next <= channels && memory_read_request(next, &request) == ESP_OK &&
+               submit(&request, read_callback, REQUEST_ARG(next, 1), &in_flight)) {
+            next++;
+        }
+
+        memory_result_t item;
+        err = next_result(&item, &in_flight);
+        if (err != ESP_OK) {
+            break;
+        }
+        if (item.result != ESP_OK && item.result != ESP_ERR_NOT_FOUND && item.attempt < ATTEMPTS &&
+            retry.memory.channel == 0) {
+            ESP_LOGW(TAG, "Reading channel %u again: %s", item.memory.channel, esp_err_to_name(item.result));
+            retry = item;
+            retries++;
+            continue;
+        }
+        done++;
+        if (item.result == ESP_ERR_NOT_FOUND) {
+            continue;
+        }
+        if (item.result != ESP_OK) {
+            ESP_LOGE(TAG, "Failed to read channel %u: %s", item.memory.channel, esp_err_to_name(item.result));
+            err = item.result;
+            break;
+        }
+
+        size += encode_record(chunk + size, &item.memory);
+        saved++;
+        if (size + RECORD_SIZE > sizeof(chunk)) {
+            err = flush_chunk(req, file, chunk, size);
+            size = 0;
+        }
+    }
+    if (err == ESP_OK && size > 0) {
+        err = flush_chunk(req, file, chunk, size);
+    }
+
+    fclose(file);
+    if (err != ESP_OK) {
+        drain(in_flight);
+        remove(TEMP_PATH);
+        return ESP_FAIL; // Too late for an error status; the browser sees the download cut short
+    }
+
+    if (rename(TEMP_PATH, MEMORY_BACKUP_PATH) != 0) {
+        ESP_LOGE(TAG, "Failed to save %s", MEMORY_BACKUP_PATH);
+    }
+    httpd_resp_send_chunk(req, NULL, 0); // End response
+
+    ESP_LOGI(TAG, "Backed up %d of %u channels in %lld ms, %d reads repeated", saved, channels,
+             (esp_timer_get_time() - start_us) / 1000, retries);
+    return ESP_OK;
+}
+
+// Store the request body as the temporary backup file
+static esp_err_t receive_upload(httpd_req_t *req) {
+    FILE *file = fopen(TEMP_PATH, "wb");
+    if (!file) {
+        ESP_LOGE(TAG, "Failed to open %s", TEMP_PATH);
+        return ESP_FAIL;
+    }
+
+    char buffer[256];
+    size_t remaining = req->content_len;
+    while (remaining > 0) {
+        int received = httpd_req_recv(req, buffer, remaining < sizeof(buffer) ? remaining : sizeof(buffer));
+        if (received == HTTPD_SOCK_ERR_TIMEOUT) {
+            continue;
+        }
+        if (received <= 0 || fwrite(buffer, 1, received, file) != (size_t)received) {
+            ESP_LOGE(TAG, "Failed to receive backup");
+            fclose(file);
+            return ESP_FAIL;
+        }
+        remaining -= received;
+    }
+
+    fclose(file);
+    return ESP_OK;
+}
+
+// Check a backup file from the header to the last record, and count its records. Leaves
+// the file at the first record.
+static esp_err_t check_backup(FILE *file, uint16_t channels, int *records) {
+    uint8_t data[RECORD_SIZE]; // The header, then each record
+    radio_memory_t memory;
+    cat_request_t request;
+
+    if (fread(data, 1, HEADER_SIZE, file) != HEADER_SIZE || memcmp(data, MAGIC, 4) != 0 ||
+        data[4] != MEMORY_BACKUP_VERSION) {
+        ESP_LOGE(TAG, "Not a memory backup");
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (get_u16(data + 6) != channels) {
+        ESP_LOGE(TAG, "Backup is of a radio with %u channels, this one has %u", get_u16(data + 6), channels);
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    *records = 0;
+    size_t size;
+    while ((size = fread(data, 1, RECORD_SIZE, file)) == RECORD_SIZE) {
+        decode_record(data, &memory);
+        if (memory_write_request(&memory, &request) != ESP_OK) {
+            ESP_LOGE(TAG, "Invalid record for channel %u", memory.channel);
+            return ESP_ERR_INVALID_ARG;
+        }
+        (*records)++;
+    }
+    if (size != 0) {
+        ESP_LOGE(TAG, "Backup ends in a partial record");
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    fseek(file, HEADER_SIZE, SEEK_SET);
+    return ESP_OK;
+}
+
+// Writes the channels in the uploaded backup back to the radio, or those in the last
+// backup saved on the keyer if the body is empty. Channels not in the backup are left
+// as they are. Each write is read back; one that does not read back as written is tried
+// again, up to ATTEMPTS in all, and then reported as failed.
+static esp_err_t set_memories_handler(httpd_req_t *req) {
+    uint16_t channels = memory_channel_count();
+    if (channels == 0) {
+        httpd_resp_send_err(req, HTTPD_501_METHOD_NOT_IMPLEMENTED, "The radio has no CAT access to its memories");
+        return ESP_FAIL;
+    }
+
+    bool uploaded = req->content_len > 0;
+    if (uploaded) {
+        if (req->content_len > HEADER_SIZE + (size_t)channels * RECORD_SIZE) {
+            httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Backup too large");
+            return ESP_FAIL;
+        }
+        if (receive_upload(req) != ESP_OK) {
+            remove(TEMP_PATH);
+            httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Failed to receive backup");
+            return ESP_FAIL;
+        }
+    }
+
+    const char *path = uploaded ? TEMP_PATH : MEMORY_BACKUP_PATH;
+    FILE *file = fopen(path, "rb");
+    if (!file) {
+        ESP_LOGE(TAG, "Failed to open %s", path);
+        httpd_resp_send_err(req, HTTPD_404_NOT_FOUND, "No backup saved");
+        return ESP_FAIL;
+    }
+
+    int records;
+    if (check_backup(file, channels, &records) != ESP_OK) {
+        fclose(file);
+        if (uploaded) {
+            remove(TEMP_PATH);
+        }
+        httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Not a memory backup for this radio");
+        return ESP_FAIL;
+    }
+
+    xQueueReset(results);
+    int64_t start_us = esp_timer_get_time();
+    int in_flight = 0;
+    restore_t next;
+    bool have_next = false; // Read from the file or due again, but waiting for room
+    restore_t retry;
+    bool have_retry = false;
+    radio_memory_t expected[IN_FLIGHT]; // Written, in the order the read-backs were submitted
+    int expected_head = 0;
+    int expected_count = 0;
+    uint16_t failed[FAILED_REPORT_MAX];
+    int failed_count = 0;
+    int retries = 0;
+    uint8_t data[RECORD_SIZE];
+    esp_err_t err = ESP_OK;
+
+    for (int done = 0; done < records && err == ESP_OK;) {
+        while (true) {
+            if (!have_next && have_retry) {
+                next = (restore_t){.memory = retry.memory, .attempt = retry.attempt + 1};
+                have_next = true;
+                have_retry = false;
+            } else if (!have_next && fread(data, 1, RECORD_SIZE, file) == RECORD_SIZE) {
+                next = (restore_t){.attempt = 1};
+                decode_record(data, &next.memory);
+                cat_request_t request;
+                if (memory_write_request(&next.memory, &request) != ESP_OK) {
+                    ESP_LOGE(TAG, "Channel %u in the backup cannot be written", next.memory.channel);
+                    add_failed(failed, &failed_count, next.memory.channel);
+                    done++;
+                    continue;
+                }
+                have_next = true;
+            }
+            if (!have_next || !submit_restore(&next, &in_flight)) {
+                break;
+            }
+            expected[(expected_head + expected_count++) % IN_FLIGHT] = next.memory;
+            have_next = false;
+        }
+        if (done == records) {
+            break; // The last records could not be written, so nothing is in flight
+        }
+
+        memory_result_t item;
+        err = next_result(&item, &in_flight);
+        if (err != ESP_OK || item.write) {
+            continue;
+        }
+
+        radio_memory_t written = expected[expected_head];
+        expected_head = (expected_head + 1) % IN_FLIGHT;
+        expected_count--;
+        if (item.result == ESP_OK && same_memory(&item.memory, &written)) {
+            done++;
+        } else if (item.attempt < ATTEMPTS && !have_retry) {
+            ESP_LOGW(TAG, "Writing channel %u again: %s", written.channel,
+                     item.result == ESP_OK ? "read back different" : esp_err_to_name(item.result));
+            retry = (restore_t){.memory = written, .attempt = item.attempt};
+            have_retry = true;
+            retries++;
+        } else {
+            ESP_LOGE(TAG, "Failed to write channel %u", written.channel);
+            add_failed(failed, &failed_count, written.channel);
+            done++;
+        }
+    }
+    fclose(file);
+
+    if (err != ESP_OK) {
+        drain(in_flight);
+        if (uploaded) {
+            remove(TEMP_PATH);
+        }
+        httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Failed to write memories");
+        return ESP_FAIL;
+    }
+
+    if (uploaded) {
+        if (rename(TEMP_PATH, MEMORY_BACKUP_PATH) != 0) {
+            ESP_LOGE(TAG, "Failed to save %s", MEMORY_BACKUP_PATH);
+        }
+    }
+    ESP_LOGI(TAG, "Restored %d of %d channels in %lld ms, %d writes repeated", records - failed_count, records,
+             (esp_timer_get_time() - start_us) / 1000, retries);
+
+    // The first FAILED_REPORT_MAX channels that failed are listed, and all are counted
+    char response[96 + FAILED_REPORT_MAX * 5];
+    int length = snprintf(response, sizeof(response), "{\"result\": \"%s\", \"restored\": %d, \"failed\": %d, \"failed_channels\": [",
+                          failed_count == 0 ? "Memories restored" : "Some memories not restored", records - failed_count,
+                          failed_count);
+    for (int i = 0; i < failed_count && i < FAILED_REPORT_MAX; i++) {
+        length += snprintf(response + length, sizeof(response) - length, "%s%u", i > 0 ? ", " : "", failed[i]);
+    }
+    snprintf(response + length, sizeof(response) - length, "]}");
+    httpd_resp_set_type(req, "application/json");
+    httpd_resp_send(req, response, HTTPD_RESP_USE_STRLEN);
+    return ESP_OK;
+}
+
+void register_memory_endpoints(void) {
+    results = xQueueCreate(IN_FLIGHT, sizeof(memory_result_t));
+    if (results == NULL) {
+        ESP_LOGE(TAG, "Failed to create memory result queue");
+        return;
+    }
+
+    register_html_page("/api/memories", HTTP_GET, get_memories_handler);
+    register_html_page("/api/memories", HTTP_POST, set_memories_handler);
+    ESP_LOGI(TAG, "Memory API endpoints registered");
+}
@@ -0,0 +1,16 @@
+#ifndef MEMORY_BACKUP_H
+#define MEMORY_BACKUP_H
+
+#include "http.h"
+
+// Backup of the radio's memory channels, kept on the html partition and served at
+// /api/memories. The file is an 8-byte header then one 12-byte record per programmed
+// channel, all little-endian:
+//   header: "CWKM", version, reserved, channel count (u16) of the radio it came from
+//   record: channel (u16), frequency (u32), clarifier (i16), mode, flags, tone, shift
+#define MEMORY_BACKUP_PATH HTML_MOUNT_POINT "/memories.bin"
+#define MEMORY_BACKUP_VERSION 1
+
+void register_memory_endpoints(void);
+
+#endif // MEMORY_BACKUP_H
@@ -4,57 +4,222 @@
 #include "esp_err.h"
 #include "esp_http_server.h"
 #include "esp_log.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
 #include "http.h"
-#include "nvs.h"
-#include "nvs_flash.h"
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 
 static const char *TAG = "MESSAGE";
-#define MESSAGE_KEY "message"
+#define MESSAGES_KEY "messages"
+#define LEGACY_MESSAGE_KEY "message"
+#define MESSAGES_VERSION 1
 
-esp_err_t set_message(const char *message) {
-    char current_message[MESSAGE_MAX_SIZE] = "";
-    esp_err_t err = get_message(current_message, sizeof(current_message));
-
-    if (err == ESP_OK || err == ESP_ERR_NVS_NOT_FOUND) {
-        if (strcmp(current_message, message) != 0) {
-            err = set_string(MESSAGE_KEY, message);
-            if (err == ESP_OK) {
-                ESP_LOGI(TAG, "Message saved to NVS: %s", message);
-            } else {
-                ESP_LOGE(TAG, "Failed to save message to NVS: %s", esp_err_to_name(err));
-            }
-        } else {
-            ESP_LOGI(TAG, "Message unchanged, not saving to NVS.");
-            err = ESP_OK;
+// All memories are persisted together as one blob, only when one of them changes
+typedef struct {
+    uint8_t version;
+    char text[MESSAGE_COUNT][MESSAGE_MAX_SIZE];
+} messages_blob_t;
+
+// RAM copy of the memories, each parsed and compiled once when it changes and expanded for every send
+static messages_blob_t messages;
+static template_t templates[MESSAGE_COUNT];
+static SemaphoreHandle_t messages_mutex = NULL;
+
+// The compiled text of all memories, packed end to end, each taking only the runs it
+// needs. A memory that finds the pool full still sends, compiling its text on send.
+#define RUN_POOL_SIZE 2048
+static keyer_run_t run_pool[RUN_POOL_SIZE];
+static size_t run_pool_used = 0;
+
+// Take a memory's runs out of the pool and close up the gap. Caller must hold messages_mutex.
+static void release_runs(int index) {
+    keyer_run_t *start = templates[index].runs;
+    size_t count = templates[index].run_count;
+
+    if (count == 0) {
+        return;
+    }
+    memmove(start, start + count, (run_pool + run_pool_used - (start + count)) * sizeof(keyer_run_t));
+    for (int i = 0; i < MESSAGE_COUNT; i++) {
+        if (templates[i].run_count > 0 && templates[i].runs > start) {
+            templates[i].runs -= count;
         }
-    } else {
-        ESP_LOGE(TAG, "Failed to load current message from NVS: %s", esp_err_to_name(err));
     }
+    run_pool_used -= count;
+    templates[index].run_count = 0;
+}
 
-    return err;
+// Caller must hold messages_mutex
+static esp_err_t compile_message(int index) {
+    template_t *template = &templates[index];
+
+    release_runs(index);
+    esp_err_t err =
+        template_compile(template, messages.text[index], run_pool + run_pool_used, RUN_POOL_SIZE - run_pool_used);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to compile M%d: %s", index + 1, esp_err_to_name(err));
+        template->token_count = 0; // Sends nothing rather than part of the message
+        template->run_count = 0;
+        return err;
+    }
+
+    run_pool_used += template->run_count;
+    ESP_LOGI(TAG, "M%d compiled to %d tokens, %d runs (%d of %d pool runs used)", index + 1, template->token_count,
+             template->run_count, run_pool_used, RUN_POOL_SIZE);
+    return ESP_OK;
 }
 
-esp_err_t get_message(char *message, size_t size) {
-    esp_err_t err = get_string(MESSAGE_KEY, message, size);
+static void load_messages(void) {
+    size_t length = sizeof(messages);
+    esp_err_t err = get_blob(MESSAGES_KEY, &messages, &length);
+    if (err == ESP_OK && length == sizeof(messages) && messages.version == MESSAGES_VERSION) {
+        ESP_LOGI(TAG, "Loaded %d messages from NVS", MESSAGE_COUNT);
+        return;
+    }
+
+    if (err == ESP_OK) {
+        ESP_LOGW(TAG, "Unsupported messages blob (version %u, %d bytes), resetting", messages.version, length);
+    }
+
+    // First boot with memories: carry over the single message from earlier firmware
+    memset(&messages, 0, sizeof(messages));
+    messages.version = MESSAGES_VERSION;
+    if (get_string(LEGACY_MESSAGE_KEY, messages.text[0], sizeof(messages.text[0])) == ESP_OK) {
+        ESP_LOGI(TAG, "Migrated message to M1: %s", messages.text[0]);
+    }
+
+    err = set_blob(MESSAGES_KEY, &messages, sizeof(messages));
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to save messages to NVS: %s", esp_err_to_name(err));
+    }
+}
+
+void message_init(void) {
+    messages_mutex = xSemaphoreCreateMutex();
+    if (messages_mutex == NULL) {
+        ESP_LOGE(TAG, "Failed to create messages mutex");
+        return;
+    }
+
+    xSemaphoreTake(messages_mutex, portMAX_DELAY);
+    load_messages();
+    for (int i = 0; i < MESSAGE_COUNT; i++) {
+        compile_message(i);
+    }
+    xSemaphoreGive(messages_mutex);
+}
+
+// Expand a compiled memory, recompiling it only if the speed has changed. Never touches flash.
+// *serial is the contest serial the timeline sends, 0 if it has no {NR}.
+esp_err_t message_get_timeline(int index, timeline_t *timeline, uint32_t *serial) {
+    if (messages_mutex == NULL) {
+        ESP_LOGE(TAG, "Message not initialized");
+        return ESP_ERR_INVALID_STATE;
+    }
+    if (index < 0 || index >= MESSAGE_COUNT) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    esp_err_t err = ESP_OK;
+    xSemaphoreTake(messages_mutex, portMAX_DELAY);
+
+    if (!template_is_current(&templates[index])) {
+        err = compile_message(index);
+    }
+
     if (err == ESP_OK) {
-        ESP_LOGI(TAG, "Message loaded from NVS: %s", message);
-    } else if (err == ESP_ERR_NVS_NOT_FOUND) {
-        ESP_LOGI(TAG, "No message found in NVS, initializing to empty");
-        message[0] = '\0';
+        err = template_expand(&templates[index], timeline, serial);
+    }
+
+    xSemaphoreGive(messages_mutex);
+    return err;
+}
+
+esp_err_t set_message(int index, const char *message) {
+    if (messages_mutex == NULL) {
+        ESP_LOGE(TAG, "Message not initialized");
+        return ESP_ERR_INVALID_STATE;
+    }
+    if (index < 0 || index >= MESSAGE_COUNT) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    esp_err_t err = ESP_OK;
+    xSemaphoreTake(messages_mutex, portMAX_DELAY);
+
+    if (strncmp(messages.text[index], message, MESSAGE_MAX_SIZE - 1) != 0) {
+        char previous[MESSAGE_MAX_SIZE];
+        strcpy(previous, messages.text[index]);
+        strncpy(messages.text[index], message, MESSAGE_MAX_SIZE - 1);
+        messages.text[index][MESSAGE_MAX_SIZE - 1] = '\0';
+
+        // A message with a bad macro is rejected rather than saved
+        err = compile_message(index);
+        if (err != ESP_OK) {
+            strcpy(messages.text[index], previous);
+            compile_message(index);
+            xSemaphoreGive(messages_mutex);
+            return err;
+        }
+
+        err = set_blob(MESSAGES_KEY, &messages, sizeof(messages));
+        if (err == ESP_OK) {
+            ESP_LOGI(TAG, "M%d saved to NVS: %s", index + 1, messages.text[index]);
+        } else {
+            ESP_LOGE(TAG, "Failed to save messages to NVS: %s", esp_err_to_name(err));
+        }
     } else {
-        ESP_LOGE(TAG, "Failed to load message from NVS: %s", esp_err_to_name(err));
+        ESP_LOGI(TAG, "M%d unchanged, not saving to NVS.", index + 1);
     }
+
+    xSemaphoreGive(messages_mutex);
     return err;
 }
 
+esp_err_t get_message(int index, char *message, size_t size) {
+    if (messages_mutex == NULL) {
+        ESP_LOGE(TAG, "Message not initialized");
+        return ESP_ERR_INVALID_STATE;
+    }
+    if (index < 0 || index >= MESSAGE_COUNT) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    xSemaphoreTake(messages_mutex, portMAX_DELAY);
+    strncpy(message, messages.text[index], size - 1);
+    message[size - 1] = '\0';
+    xSemaphoreGive(messages_mutex);
+    return ESP_OK;
+}
+
+// "slot" is the 1-based memory number (M1..M8); M1 when absent
+static int slot_to_index(const cJSON *slot_json) {
+    if (slot_json == NULL) {
+        return 0;
+    }
+    if (!cJSON_IsNumber(slot_json) || slot_json->valueint < 1 || slot_json->valueint > MESSAGE_COUNT) {
+        return -1;
+    }
+    return slot_json->valueint - 1;
+}
+
+// Returns every memory, plus M1 (or ?slot=N) as "message"
 esp_err_t get_message_handler(httpd_req_t *req) {
+    int index = 0;
+    char query[16];
+    char slot_param[4];
+    if (httpd_req_get_url_query_str(req, query, sizeof(query)) == ESP_OK &&
+        httpd_query_key_value(query, "slot", slot_param, sizeof(slot_param)) == ESP_OK) {
+        index = atoi(slot_param) - 1;
+    }
+
     char current_message[MESSAGE_MAX_SIZE] = "";
-    esp_err_t err = get_message(current_message, sizeof(current_message));
+    esp_err_t err = get_message(index, current_message, sizeof(current_message));
     if (err != ESP_OK) {
         ESP_LOGE(TAG, "Failed to get message: %s", esp_err_to_name(err));
-        httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Failed to get message");
+        httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Invalid slot");
         return ESP_FAIL;
     }
 
@@ -65,8 +230,15 @@ esp_err_t get_message_handler(httpd_req_t *req) {
         return ESP_FAIL;
     }
 
+    cJSON_AddNumberToObject(response_json, "slot", index + 1);
     cJSON_AddStringToObject(response_json, "message", current_message);
 
+    cJSON *messages_json = cJSON_AddArrayToObject(response_json, "messages");
+    for (int i = 0; i < MESSAGE_COUNT; i++) {
+        get_message(i, current_message, sizeof(current_message));
+        cJSON_AddItemToArray(messages_json, cJSON_CreateString(current_message));
+    }
+
     const char *response = cJSON_PrintUnformatted(response_json);
     if (!response) {
         ESP_LOGE(TAG, "Failed to print JSON response");
@@ -111,11 +283,25 @@ esp_err_t set_message_handler(httpd_req_t *req) {
         return ESP_FAIL;
     }
 
+    int index = slot_to_index(cJSON_GetObjectItem(json, "slot"));
+    if (index < 0) {
+        ESP_LOGE(TAG, "Invalid 'slot' field");
+        httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Invalid 'slot' field");
+        cJSON_Delete(json);
+        return ESP_FAIL;
+    }
+
     const char *message_param = message_json->valuestring;
-    ESP_LOGI(TAG, "Message: %s", message_param);
+    ESP_LOGI(TAG, "M%d: %s", index + 1, message_param);
 
-    esp_err_t err = set_message(message_param);
-    if (err != ESP_OK) {
+    esp_err_t err = set_message(index, message_param);
+    if (err == ESP_ERR_INVALID_ARG || err == ESP_ERR_INVALID_SIZE) {
+        ESP_LOGE(TAG, "Invalid message: %s", esp_err_to_name(err));
+        httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST,
+                            err == ESP_ERR_INVALID_ARG ? "Invalid macro in message" : "Message too long");
+        cJSON_Delete(json);
+        return ESP_FAIL;
+    } else if (err != ESP_OK) {
         ESP_LOGE(TAG, "Failed to save message: %s", esp_err_to_name(err));
         httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Failed to save message");
         cJSON_Delete(json);
@@ -1,12 +1,17 @@
 #ifndef MESSAGE_H
 #define MESSAGE_H
 
+#include "template.h"
+#include "timeline.h"
 #include <esp_err.h>
 
 #define MESSAGE_MAX_SIZE 64
+#define MESSAGE_COUNT 8 // Memories M1..M8, addressed by 0-based index in C
 
-esp_err_t set_message(const char *message);
-esp_err_t get_message(char *message, size_t size);
+void message_init(void);
+esp_err_t set_message(int index, const char *message);
+esp_err_t get_message(int index, char *message, size_t size);
+esp_err_t message_get_timeline(int index, timeline_t *timeline, uint32_t *serial);
 
 void register_message_endpoints(void);
 
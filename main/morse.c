@@ -1,86 +1,238 @@
 #include "morse.h"
+#include "cJSON.h"
+#include "contest.h"
 #include "esp_http_server.h"
 #include "esp_log.h"
 #include "freertos/FreeRTOS.h"
+#include "esp_timer.h"
 #include "freertos/queue.h"
 #include "freertos/task.h"
 #include "gpio.h"
 #include "http.h"
+#include "keyer.h"
 #include "message.h"
-#include "morse_code_characters.h"
-#include "settings.h"
+#include "ptt.h"
+#include "sidetone.h"
+#include "timeline.h"
+#include "typeahead.h"
+#include <stdio.h>
 #include <string.h>
 
 typedef struct {
     bool enable_key;
+    int8_t memory; // Index of the stored memory to play, or -1 to play `message`
     char message[MESSAGE_MAX_SIZE];
 } morse_task_t;
 
+typedef uint8_t morse_handle_t; // Index of a slot in the message pool
+
+// Messages live in a fixed pool; the queues only carry the index of a pool slot.
+// Both queues can hold every slot, so passing a handle never blocks or fails.
+#define MORSE_POOL_SIZE 10
+#define MORSE_RETRY_AFTER_S "2" // Suggested wait when the pool is exhausted
+#define PADDLE_POLL_MS 20 // How often to look whether the paddles have let go
+#define WS_FRAME_MAX_SIZE 128
+
+static morse_task_t pool[MORSE_POOL_SIZE];
+static QueueHandle_t free_queue = NULL; // Handles of unused pool slots
 static QueueHandle_t morse_queue = NULL;
-static TaskHandle_t morse_task_handle = NULL;
+static QueueHandle_t priority_queue = NULL; // Served before anything in morse_queue
+static TaskHandle_t morse_task_handle = NULL; // Notified whenever there is something to send
+
+static bool busy = false;
+static volatile uint32_t abort_generation = 0; // Bumped by every abort
+static uint32_t aborted_count = 0;
+
+static timeline_t playback;
+static int64_t playback_started_us = 0; // When keyer_play() last took the timeline
 
-bool busy = false;
+// Type-ahead state carried from one character to the next
+static bool live_letter_gap_owed = false;
+static bool live_in_prosign = false; // Typing inside <...>
+static bool live_joined = false;
+static int64_t live_idle_since_us = 0;
+static uint32_t live_latency_us = 0;
+static uint32_t live_max_latency_us = 0;
+
+// Play the timeline once the paddles have been idle for a word gap, so a message or typed
+// character waits for the operator instead of being dropped. Gives up with
+// ESP_ERR_NOT_FINISHED if keying was aborted since `generation` was taken, including
+// during the PTT lead-in: keyer_abort() only stops a schedule already playing.
+static esp_err_t play_when_paddles_idle(bool enable_key, uint32_t generation) {
+    while (1) {
+        if (generation != abort_generation) {
+            return ESP_ERR_NOT_FINISHED;
+        }
+        if (keyer_live_idle_us() < playback.timing.word_gap_us) {
+            vTaskDelay(pdMS_TO_TICKS(PADDLE_POLL_MS));
+            continue;
+        }
 
-void space(int duration) {
-    vTaskDelay(duration / portTICK_PERIOD_MS);
+        playback_started_us = esp_timer_get_time();
+        esp_err_t err = keyer_play(playback.runs, playback.count, enable_key);
+        if (err != ESP_ERR_INVALID_STATE || keyer_live_idle_us() != 0) {
+            return err;
+        }
+        // The paddles took the key again in between; wait for them once more
+    }
 }
 
-static void morse_code_task(void *arg) {
-    morse_task_t task_data;
+// When the first element of the timeline played last went out; a letter gap owed from the
+// character before may come ahead of it
+static int64_t playback_key_down_us(void) {
+    int64_t key_down_us = playback_started_us;
+    for (size_t i = 0; i < playback.count && !playback.runs[i].level; i++) {
+        key_down_us += playback.runs[i].duration_us;
+    }
+    return key_down_us;
+}
+
+static void play_message(const morse_task_t *task_data) {
+    uint32_t generation = abort_generation;
+    uint32_t serial = 0;
+    esp_err_t err;
+    if (task_data->memory >= 0) {
+        ESP_LOGI("MORSE_TASK", "Processing M%d", task_data->memory + 1);
+        err = message_get_timeline(task_data->memory, &playback, &serial);
+    } else {
+        ESP_LOGI("MORSE_TASK", "Processing message: %s", task_data->message);
+        err = timeline_compile(&playback, task_data->message);
+    }
+
+    // Compiled before PTT goes on, so the lead-in is the only wait before the first element
+    if (err == ESP_OK && generation == abort_generation && task_data->enable_key) {
+        ptt_begin(PTT_SOURCE_MORSE);
+    }
+
+    if (err != ESP_OK) {
+        ESP_LOGE("MORSE_TASK", "Failed to compile message: %s", esp_err_to_name(err));
+    } else if (generation != abort_generation) {
+        ESP_LOGI("MORSE_TASK", "Message aborted before keying");
+    } else if ((err = play_when_paddles_idle(task_data->enable_key, generation)) == ESP_ERR_NOT_FINISHED) {
+        ESP_LOGI("MORSE_TASK", "Message aborted");
+    } else if (err != ESP_OK) {
+        ESP_LOGE("MORSE_TASK", "Failed to play message");
+    } else if (serial != 0) {
+        contest_serial_sent(serial); // Only a complete exchange uses up the number
+    }
+
+    // A message in between breaks up whatever was being typed
+    live_letter_gap_owed = false;
+    live_in_prosign = false;
+    live_joined = false;
+}
+
+// Key the next typed-ahead character, if there is one
+static bool play_typeahead(void) {
+    uint32_t generation = abort_generation;
+    char c;
+    uint32_t arrival_us;
+
+    if (!typeahead_pop(&c, &arrival_us)) {
+        return false;
+    }
+
+    timeline_init(&playback);
+    playback.in_prosign = live_in_prosign;
+    playback.joined = live_joined;
+
+    // After a pause the letter gap has already gone by, so key the character straight away
+    if (esp_timer_get_time() - live_idle_since_us < playback.timing.letter_gap_us) {
+        playback.letter_gap_owed = live_letter_gap_owed;
+    }
 
+    if (timeline_append_char(&playback, c) != ESP_OK) {
+        return true;
+    }
+    live_letter_gap_owed = playback.letter_gap_owed;
+    live_in_prosign = playback.in_prosign;
+    live_joined = playback.joined;
+
+    ptt_begin(PTT_SOURCE_MORSE);
+    esp_err_t err = play_when_paddles_idle(true, generation);
+    if (err == ESP_OK) {
+        // Includes the PTT lead-in and any wait for the paddles
+        live_latency_us = (uint32_t)playback_key_down_us() - arrival_us;
+        if (live_latency_us > live_max_latency_us) {
+            live_max_latency_us = live_latency_us;
+        }
+    } else if (err != ESP_ERR_NOT_FINISHED) {
+        ESP_LOGE("MORSE_TASK", "Failed to play character");
+    }
+    live_idle_since_us = esp_timer_get_time();
+    return true;
+}
+
+static void release(morse_handle_t handle) {
+    xQueueSend(free_queue, &handle, 0);
+}
+
+// Play one item: priority messages first, then typed-ahead characters, then queued
+// messages. Returns false when there is nothing left to do.
+static bool play_next(void) {
+    morse_handle_t handle;
+
+    if (xQueueReceive(priority_queue, &handle, 0)) {
+        play_message(&pool[handle]);
+        release(handle);
+        return true;
+    }
+
+    if (play_typeahead()) {
+        return true;
+    }
+
+    if (xQueueReceive(morse_queue, &handle, 0)) {
+        play_message(&pool[handle]);
+        release(handle);
+        return true;
+    }
+
+    return false;
+}
+
+// Wake the task to look at the queues and the type-ahead buffer
+static void notify_task(void) {
+    if (morse_task_handle != NULL) {
+        xTaskNotifyGive(morse_task_handle);
+    }
+}
+
+static void morse_code_task(void *arg) {
     while (1) {
-        ESP_LOGI("MORSE_TASK", "Waiting for message...");
-        if (xQueueReceive(morse_queue, &task_data, portMAX_DELAY)) {
-            busy = true;
-
-            ESP_LOGI("MORSE_TASK", "Processing message: %s", task_data.message);
-
-            int unit = calculate_dit_duration(wpm); // duration of one DIT in milliseconds
-
-            for (int i = 0; i < strlen(task_data.message); i++) {
-                char c = task_data.message[i];
-                if (c == ' ') {
-                    space(WORD_SPACE * unit); // Space between words
-                } else {
-                    int *morse = char_to_morse(c);
-
-                    for (int j = 0; morse[j] != END; j++) {
-                        if (task_data.enable_key) {
-                            key_down();
-                        }
-                        led_on();
-                        vTaskDelay(morse[j] * unit / portTICK_PERIOD_MS);
-                        if (task_data.enable_key) {
-                            key_up();
-                        }
-                        led_off();
-
-                        if (morse[j + 1] != END) { // If not the last element
-                            space(SPACE * unit);   // Space between DITs and DAHs
-                        }
-                    }
-
-                    if (task_data.message[i + 1] != '\0' && task_data.message[i + 1] != ' ') {
-                        space(LETTER_SPACE * unit); // Space between letters
-                    }
-                }
-            }
+        // The notification only says that something arrived; play_next() decides what goes
+        // first. Anything arriving while the loop runs notifies again, and anything cleared
+        // away before it is played just leaves play_next() with nothing to do.
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
 
-            busy = false;
+        busy = true;
+        while (play_next()) {
         }
+        ptt_end(PTT_SOURCE_MORSE); // Hang time bridges the gaps between typed characters and messages
+        busy = false;
     }
 }
 
 void morse_code_init() {
     key_init();
     led_init();
+    sidetone_init();
 
-    morse_queue = xQueueCreate(10, sizeof(morse_task_t));
-    if (morse_queue == NULL) {
-        ESP_LOGE("MORSE_INIT", "Failed to create queue");
+    if (keyer_init() != ESP_OK) {
+        ESP_LOGE("MORSE_INIT", "Failed to initialize keyer");
         return;
     }
 
+    free_queue = xQueueCreate(MORSE_POOL_SIZE, sizeof(morse_handle_t));
+    morse_queue = xQueueCreate(MORSE_POOL_SIZE, sizeof(morse_handle_t));
+    priority_queue = xQueueCreate(MORSE_POOL_SIZE, sizeof(morse_handle_t));
+    if (free_queue == NULL || morse_queue == NULL || priority_queue == NULL) {
+        ESP_LOGE("MORSE_INIT", "Failed to create queue");
+        return;
+    }
+    for (morse_handle_t handle = 0; handle < MORSE_POOL_SIZE; handle++) {
+        release(handle);
+    }
     if (xTaskCreate(morse_code_task, "morse_code_task", 4096, NULL, 5, &morse_task_handle) != pdPASS) {
         ESP_LOGE("MORSE_INIT", "Failed to create task");
         return;
@@ -89,49 +241,212 @@ void morse_code_init() {
     ESP_LOGI("MORSE_INIT", "Morse code initialized");
 }
 
-void queue_morse_code(char message[], bool enable_key) {
-    if (morse_queue == NULL) {
+// Claim a free pool slot without waiting
+static morse_task_t *acquire(morse_handle_t *handle) {
+    if (free_queue == NULL) {
         ESP_LOGE("SEND_MORSE", "Queue not initialized");
-        return;
+        return NULL;
     }
 
-    morse_task_t task_data;
-    task_data.enable_key = enable_key;
-    strncpy(task_data.message, message, MESSAGE_MAX_SIZE);
+    if (xQueueReceive(free_queue, handle, 0) != pdPASS) {
+        ESP_LOGW("SEND_MORSE", "Queue full");
+        return NULL;
+    }
+    return &pool[*handle];
+}
 
-    ESP_LOGI("SEND_MORSE", "Sending message: %s", task_data.message);
+static void enqueue(morse_handle_t handle, bool priority) {
+    xQueueSend(priority ? priority_queue : morse_queue, &handle, 0);
+    notify_task();
+    ESP_LOGI("SEND_MORSE", "Message sent to queue");
+}
 
-    if (xQueueSend(morse_queue, &task_data, portMAX_DELAY) != pdPASS) {
-        ESP_LOGE("SEND_MORSE", "Failed to send message to queue");
-    } else {
-        ESP_LOGI("SEND_MORSE", "Message sent to queue");
+// Returns ESP_ERR_NO_MEM when every pool slot is in use; never blocks
+esp_err_t queue_morse_code(char message[], bool enable_key, bool priority) {
+    morse_handle_t handle;
+    morse_task_t *task_data = acquire(&handle);
+    if (task_data == NULL) {
+        return ESP_ERR_NO_MEM;
     }
+
+    task_data->enable_key = enable_key;
+    task_data->memory = -1;
+    strncpy(task_data->message, message, MESSAGE_MAX_SIZE);
+    task_data->message[MESSAGE_MAX_SIZE - 1] = '\0';
+
+    ESP_LOGI("SEND_MORSE", "Sending message: %s", task_data->message);
+
+    enqueue(handle, priority);
+    return ESP_OK;
 }
 
-void send_morse_code() {
+// Queue a stored memory, which is played from its precompiled timeline
+esp_err_t send_morse_code(int index, bool priority) {
+    if (index < 0 || index >= MESSAGE_COUNT) {
+        return ESP_ERR_INVALID_ARG;
+    }
 
-    char message[MESSAGE_MAX_SIZE];
+    morse_handle_t handle;
+    morse_task_t *task_data = acquire(&handle);
+    if (task_data == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
 
-    // Retrieve the current message from NVS
-    esp_err_t err = get_message(message, sizeof(message));
-    if (err != ESP_OK) {
-        ESP_LOGE("SEND_MORSE", "Failed to get message: %s", esp_err_to_name(err));
+    task_data->enable_key = true;
+    task_data->memory = index;
+    task_data->message[0] = '\0';
+
+    ESP_LOGI("SEND_MORSE", "Sending M%d", index + 1);
+
+    enqueue(handle, priority);
+    return ESP_OK;
+}
+
+static void drain(QueueHandle_t queue) {
+    morse_handle_t handle;
+    while (xQueueReceive(queue, &handle, 0)) {
+        release(handle);
+    }
+}
+
+// Drop everything waiting to be sent without touching the message being keyed
+void morse_clear_queue(void) {
+    if (morse_queue == NULL) {
         return;
     }
 
-    queue_morse_code(message, true);
+    drain(priority_queue);
+    drain(morse_queue);
+    typeahead_clear();
+    ESP_LOGI("SEND_MORSE", "Queue cleared");
+}
+
+// Stop keying within the current element and flush everything queued behind it
+void morse_abort(void) {
+    abort_generation++;
+    aborted_count++;
+    morse_clear_queue();
+    keyer_abort();
+    ESP_LOGI("SEND_MORSE", "Keying aborted");
 }
 
+// Optional body: {"slot": 1-8, "priority": true}. Sends M1 by default; priority
+// messages go ahead of everything already queued.
 esp_err_t morse_handler(httpd_req_t *req) {
     ESP_LOGI("MORSE_CODE", "Handling /api/morse request...");
-    send_morse_code();
+
+    int index = 0;
+    bool priority = false;
+    char content[64];
+    int content_len = httpd_req_recv(req, content, sizeof(content) - 1);
+    if (content_len > 0) {
+        content[content_len] = '\0';
+        cJSON *json = cJSON_Parse(content);
+        if (json) {
+            priority = cJSON_IsTrue(cJSON_GetObjectItem(json, "priority"));
+            cJSON *slot_json = cJSON_GetObjectItem(json, "slot");
+            if (cJSON_IsNumber(slot_json)) {
+                index = slot_json->valueint - 1;
+            }
+            cJSON_Delete(json);
+        }
+    }
+
+    esp_err_t err = send_morse_code(index, priority);
+    if (err == ESP_ERR_INVALID_ARG) {
+        httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Invalid 'slot' field");
+        return ESP_FAIL;
+    }
+    if (err == ESP_ERR_NO_MEM) {
+        httpd_resp_set_status(req, "503 Service Unavailable");
+        httpd_resp_set_hdr(req, "Retry-After", MORSE_RETRY_AFTER_S);
+        httpd_resp_set_type(req, "application/json");
+        httpd_resp_send(req, "{\"error\": \"Queue full\", \"retry_after\": " MORSE_RETRY_AFTER_S "}", HTTPD_RESP_USE_STRLEN);
+        return ESP_OK;
+    }
 
     httpd_resp_set_type(req, "application/json");
     httpd_resp_send(req, "{\"result\": \"Morse code sent\"}", HTTPD_RESP_USE_STRLEN);
     return ESP_OK;
 }
 
+static esp_err_t morse_abort_handler(httpd_req_t *req) {
+    ESP_LOGI("MORSE_CODE", "Handling /api/morse/abort request...");
+    morse_abort();
+
+    httpd_resp_set_type(req, "application/json");
+    httpd_resp_send(req, "{\"result\": \"Morse code aborted\"}", HTTPD_RESP_USE_STRLEN);
+    return ESP_OK;
+}
+
+static esp_err_t morse_clear_handler(httpd_req_t *req) {
+    ESP_LOGI("MORSE_CODE", "Handling /api/morse/clear request...");
+    morse_clear_queue();
+
+    httpd_resp_set_type(req, "application/json");
+    httpd_resp_send(req, "{\"result\": \"Morse code queue cleared\"}", HTTPD_RESP_USE_STRLEN);
+    return ESP_OK;
+}
+
+// Characters typed in the browser, keyed as they arrive. Backspace (0x08) or DEL
+// cancels the last character that has not been sent yet.
+static esp_err_t keyer_ws_handler(httpd_req_t *req) {
+    if (req->method == HTTP_GET) {
+        ESP_LOGI("MORSE_CODE", "Type-ahead WebSocket connected");
+        return ESP_OK;
+    }
+
+    uint8_t payload[WS_FRAME_MAX_SIZE];
+    httpd_ws_frame_t frame = {
+        .type = HTTPD_WS_TYPE_TEXT,
+        .payload = payload,
+    };
+
+    esp_err_t err = httpd_ws_recv_frame(req, &frame, sizeof(payload));
+    if (err != ESP_OK) {
+        ESP_LOGE("MORSE_CODE", "Failed to receive WebSocket frame: %s", esp_err_to_name(err));
+        return err;
+    }
+    if (frame.type != HTTPD_WS_TYPE_TEXT) {
+        return ESP_OK;
+    }
+
+    uint32_t now_us = (uint32_t)esp_timer_get_time();
+    for (size_t i = 0; i < frame.len; i++) {
+        if (payload[i] == '\b' || payload[i] == 0x7F) {
+            typeahead_backspace();
+        } else if (!typeahead_push((char)payload[i], now_us)) {
+            ESP_LOGW("MORSE_CODE", "Type-ahead buffer full");
+            break;
+        }
+    }
+    notify_task();
+
+    char response[32];
+    snprintf(response, sizeof(response), "{\"pending\": %u}", typeahead_pending());
+    httpd_ws_frame_t reply = {
+        .type = HTTPD_WS_TYPE_TEXT,
+        .payload = (uint8_t *)response,
+        .len = strlen(response),
+    };
+    return httpd_ws_send_frame(req, &reply);
+}
+
+void morse_get_status(morse_status_t *status) {
+    status->busy = busy;
+    status->queued = morse_queue ? uxQueueMessagesWaiting(morse_queue) : 0;
+    status->priority_queued = priority_queue ? uxQueueMessagesWaiting(priority_queue) : 0;
+    status->aborted = aborted_count;
+    status->free_slots = free_queue ? uxQueueMessagesWaiting(free_queue) : 0;
+    status->typeahead_pending = typeahead_pending();
+    status->typeahead_latency_us = live_latency_us;
+    status->typeahead_max_latency_us = live_max_latency_us;
+}
+
 void register_morse_endpoints(void) {
     register_html_page("/api/morse", HTTP_POST, morse_handler);
+    register_html_page("/api/morse/abort", HTTP_POST, morse_abort_handler);
+    register_html_page("/api/morse/clear", HTTP_POST, morse_clear_handler);
+    register_websocket("/ws/keyer", keyer_ws_handler);
     ESP_LOGI("MORSE_CODE", "Morse code API endpoints registered");
 }
@@ -3,10 +3,26 @@
 
 #include "esp_err.h"
 #include "stdbool.h"
+#include <stddef.h>
+#include <stdint.h>
+
+typedef struct {
+    bool busy;
+    size_t queued;
+    size_t priority_queued;
+    uint32_t aborted;
+    size_t free_slots;
+    size_t typeahead_pending;
+    uint32_t typeahead_latency_us;     // Arrival to key-down of the last typed character
+    uint32_t typeahead_max_latency_us;
+} morse_status_t;
 
 void morse_code_init(void);
 void register_morse_endpoints(void);
-void queue_morse_code(char message[], bool enable_key);
-void send_morse_code(void);
+esp_err_t queue_morse_code(char message[], bool enable_key, bool priority);
+esp_err_t send_morse_code(int index, bool priority);
+void morse_clear_queue(void);
+void morse_abort(void);
+void morse_get_status(morse_status_t *status);
 
 #endif // MORSE_CODE_H
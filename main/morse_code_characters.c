@@ -1,91 +1,93 @@
 #include "morse_code_characters.h"
-#include <stdio.h>
-#include <string.h>
+#include <stddef.h>
 
-#define MAX_MORSE_LENGTH 10
+// Build a packed code at compile time from its DIT/DAH elements
+#define BIT(e) ((e) == DAH)
+#define CODE1(a) (0x02 | BIT(a))
+#define CODE2(a, b) (0x04 | BIT(a) << 1 | BIT(b))
+#define CODE3(a, b, c) (0x08 | BIT(a) << 2 | BIT(b) << 1 | BIT(c))
+#define CODE4(a, b, c, d) (0x10 | BIT(a) << 3 | BIT(b) << 2 | BIT(c) << 1 | BIT(d))
+#define CODE5(a, b, c, d, e) (0x20 | BIT(a) << 4 | BIT(b) << 3 | BIT(c) << 2 | BIT(d) << 1 | BIT(e))
+#define CODE6(a, b, c, d, e, f) (0x40 | BIT(a) << 5 | BIT(b) << 4 | BIT(c) << 3 | BIT(d) << 2 | BIT(e) << 1 | BIT(f))
+#define CODE7(a, b, c, d, e, f, g) (0x80 | BIT(a) << 6 | BIT(b) << 5 | BIT(c) << 4 | BIT(d) << 3 | BIT(e) << 2 | BIT(f) << 1 | BIT(g))
 
-typedef struct {
-    char character;
-    int morse[MAX_MORSE_LENGTH];
-} MorseCode;
+// Indexed directly by ASCII character; lowercase letters are folded before lookup
+static const morse_code_t morse_table[128] = {
+    ['A'] = CODE2(DIT, DAH),
+    ['B'] = CODE4(DAH, DIT, DIT, DIT),
+    ['C'] = CODE4(DAH, DIT, DAH, DIT),
+    ['D'] = CODE3(DAH, DIT, DIT),
+    ['E'] = CODE1(DIT),
+    ['F'] = CODE4(DIT, DIT, DAH, DIT),
+    ['G'] = CODE3(DAH, DAH, DIT),
+    ['H'] = CODE4(DIT, DIT, DIT, DIT),
+    ['I'] = CODE2(DIT, DIT),
+    ['J'] = CODE4(DIT, DAH, DAH, DAH),
+    ['K'] = CODE3(DAH, DIT, DAH),
+    ['L'] = CODE4(DIT, DAH, DIT, DIT),
+    ['M'] = CODE2(DAH, DAH),
+    ['N'] = CODE2(DAH, DIT),
+    ['O'] = CODE3(DAH, DAH, DAH),
+    ['P'] = CODE4(DIT, DAH, DAH, DIT),
+    ['Q'] = CODE4(DAH, DAH, DIT, DAH),
+    ['R'] = CODE3(DIT, DAH, DIT),
+    ['S'] = CODE3(DIT, DIT, DIT),
+    ['T'] = CODE1(DAH),
+    ['U'] = CODE3(DIT, DIT, DAH),
+    ['V'] = CODE4(DIT, DIT, DIT, DAH),
+    ['W'] = CODE3(DIT, DAH, DAH),
+    ['X'] = CODE4(DAH, DIT, DIT, DAH),
+    ['Y'] = CODE4(DAH, DIT, DAH, DAH),
+    ['Z'] = CODE4(DAH, DAH, DIT, DIT),
+    ['1'] = CODE5(DIT, DAH, DAH, DAH, DAH),
+    ['2'] = CODE5(DIT, DIT, DAH, DAH, DAH),
+    ['3'] = CODE5(DIT, DIT, DIT, DAH, DAH),
+    ['4'] = CODE5(DIT, DIT, DIT, DIT, DAH),
+    ['5'] = CODE5(DIT, DIT, DIT, DIT, DIT),
+    ['6'] = CODE5(DAH, DIT, DIT, DIT, DIT),
+    ['7'] = CODE5(DAH, DAH, DIT, DIT, DIT),
+    ['8'] = CODE5(DAH, DAH, DAH, DIT, DIT),
+    ['9'] = CODE5(DAH, DAH, DAH, DAH, DIT),
+    ['0'] = CODE5(DAH, DAH, DAH, DAH, DAH),
+    ['.'] = CODE6(DIT, DAH, DIT, DAH, DIT, DAH),
+    [','] = CODE6(DAH, DAH, DIT, DIT, DAH, DAH),
+    ['?'] = CODE6(DIT, DIT, DAH, DAH, DIT, DIT),
+    ['\''] = CODE6(DIT, DAH, DAH, DAH, DAH, DIT),
+    ['!'] = CODE6(DAH, DIT, DAH, DIT, DAH, DAH),
+    ['/'] = CODE5(DAH, DIT, DIT, DAH, DIT),
+    ['('] = CODE5(DAH, DIT, DAH, DAH, DIT),
+    [')'] = CODE6(DAH, DIT, DAH, DAH, DIT, DAH),
+    ['&'] = CODE5(DIT, DAH, DIT, DIT, DIT),
+    [':'] = CODE6(DAH, DAH, DAH, DIT, DIT, DIT),
+    [';'] = CODE6(DAH, DIT, DAH, DIT, DAH, DIT),
+    ['='] = CODE5(DAH, DIT, DIT, DIT, DAH),
+    ['+'] = CODE5(DIT, DAH, DIT, DAH, DIT),
+    ['-'] = CODE6(DAH, DIT, DIT, DIT, DIT, DAH),
+    ['_'] = CODE6(DIT, DIT, DAH, DAH, DIT, DAH),
+    ['"'] = CODE6(DIT, DAH, DIT, DIT, DAH, DIT),
+    ['$'] = CODE7(DIT, DIT, DIT, DAH, DIT, DIT, DAH),
+    ['@'] = CODE6(DIT, DAH, DAH, DIT, DAH, DIT),
+};
 
-static const MorseCode morse_table[] = {
-    {'A', {DIT, DAH, END}},
-    {'B', {DAH, DIT, DIT, DIT, END}},
-    {'C', {DAH, DIT, DAH, DIT, END}},
-    {'D', {DAH, DIT, DIT, END}},
-    {'E', {DIT, END}},
-    {'F', {DIT, DIT, DAH, DIT, END}},
-    {'G', {DAH, DAH, DIT, END}},
-    {'H', {DIT, DIT, DIT, DIT, END}},
-    {'I', {DIT, DIT, END}},
-    {'J', {DIT, DAH, DAH, DAH, END}},
-    {'K', {DAH, DIT, DAH, END}},
-    {'L', {DIT, DAH, DIT, DIT, END}},
-    {'M', {DAH, DAH, END}},
-    {'N', {DAH, DIT, END}},
-    {'O', {DAH, DAH, DAH, END}},
-    {'P', {DIT, DAH, DAH, DIT, END}},
-    {'Q', {DAH, DAH, DIT, DAH, END}},
-    {'R', {DIT, DAH, DIT, END}},
-    {'S', {DIT, DIT, DIT, END}},
-    {'T', {DAH, END}},
-    {'U', {DIT, DIT, DAH, END}},
-    {'V', {DIT, DIT, DIT, DAH, END}},
-    {'W', {DIT, DAH, DAH, END}},
-    {'X', {DAH, DIT, DIT, DAH, END}},
-    {'Y', {DAH, DIT, DAH, DAH, END}},
-    {'Z', {DAH, DAH, DIT, DIT, END}},
-    {'1', {DIT, DAH, DAH, DAH, DAH, END}},
-    {'2', {DIT, DIT, DAH, DAH, DAH, END}},
-    {'3', {DIT, DIT, DIT, DAH, DAH, END}},
-    {'4', {DIT, DIT, DIT, DIT, DAH, END}},
-    {'5', {DIT, DIT, DIT, DIT, DIT, END}},
-    {'6', {DAH, DIT, DIT, DIT, DIT, END}},
-    {'7', {DAH, DAH, DIT, DIT, DIT, END}},
-    {'8', {DAH, DAH, DAH, DIT, DIT, END}},
-    {'9', {DAH, DAH, DAH, DAH, DIT, END}},
-    {'0', {DAH, DAH, DAH, DAH, DAH, END}},
-    {'.', {DIT, DAH, DIT, DAH, DIT, DAH, END}},
-    {',', {DAH, DAH, DIT, DIT, DAH, DAH, END}},
-    {'?', {DIT, DIT, DAH, DAH, DIT, DIT, END}},
-    {'\'', {DIT, DAH, DAH, DAH, DAH, DIT, END}},
-    {'!', {DAH, DIT, DAH, DIT, DAH, DAH, END}},
-    {'/', {DAH, DIT, DIT, DAH, DIT, END}},
-    {'(', {DAH, DIT, DAH, DAH, DIT, END}},
-    {')', {DAH, DIT, DAH, DAH, DIT, DAH, END}},
-    {'&', {DIT, DAH, DIT, DIT, DIT, END}},
-    {':', {DAH, DAH, DAH, DIT, DIT, DIT, END}},
-    {';', {DAH, DIT, DAH, DIT, DAH, DIT, END}},
-    {'=', {DAH, DIT, DIT, DIT, DAH, END}},
-    {'+', {DIT, DAH, DIT, DAH, DIT, END}},
-    {'-', {DAH, DIT, DIT, DIT, DIT, DAH, END}},
-    {'_', {DIT, DIT, DAH, DAH, DIT, DAH, END}},
-    {'"', {DIT, DAH, DIT, DIT, DAH, DIT, END}},
-    {'$', {DIT, DIT, DIT, DAH, DIT, DIT, DAH, END}},
-    {'@', {DIT, DAH, DAH, DIT, DAH, DIT, END}}};
-
-/**
- * Calculate the duration of a DIT in milliseconds based on the given speed in WPM.
- * @param wpm Speed in words per minute.
- * @return Duration of a DIT in milliseconds.
- */
-int calculate_dit_duration(int wpm) {
-    // The standard word "PARIS" is used to calculate WPM, which has 50 units (DITs).
-    // 1200 ms is the time for one WPM.
-    return 1200 / wpm;
+morse_code_t char_to_morse(char c) {
+    if (c >= 'a' && c <= 'z') {
+        c = c - 'a' + 'A';
+    }
+    if ((unsigned char)c >= sizeof(morse_table)) {
+        return MORSE_NONE;
+    }
+    return morse_table[(unsigned char)c];
 }
 
-int *char_to_morse(char c) {
-    static int morse_code[MAX_MORSE_LENGTH];
-    memset(morse_code, 0, sizeof(morse_code));
-
-    for (int i = 0; i < sizeof(morse_table) / sizeof(MorseCode); i++) {
-        if (morse_table[i].character == c || morse_table[i].character == c - 32) {
-            memcpy(morse_code, morse_table[i].morse, sizeof(morse_table[i].morse));
-            break;
+// Reverse lookup for decoding; only runs once per received character, so a scan is enough
+char morse_to_char(morse_code_t code) {
+    if (code == MORSE_NONE) {
+        return '\0';
+    }
+    for (size_t c = 0; c < sizeof(morse_table); c++) {
+        if (morse_table[c] == code) {
+            return (char)c;
         }
     }
-
-    return morse_code;
+    return '\0';
 }
@@ -1,6 +1,8 @@
 #ifndef MORSE_CODE_CHARACTERS_H
 #define MORSE_CODE_CHARACTERS_H
 
+#include <stdint.h>
+
 #define END 0
 #define DIT 1
 #define DAH 3
@@ -8,7 +10,24 @@
 #define LETTER_SPACE 3
 #define WORD_SPACE 7
 
-int calculate_dit_duration(int wpm);
-int *char_to_morse(char c);
+// A character packed into one byte: a leading 1 marker bit followed by one bit per
+// element, first element in the highest bit (0 = DIT, 1 = DAH). 0 means no code.
+typedef uint8_t morse_code_t;
+
+#define MORSE_NONE 0
+#define MORSE_MAX_ELEMENTS 7
+
+morse_code_t char_to_morse(char c);
+char morse_to_char(morse_code_t code);
+
+// Number of elements in a packed code
+static inline int morse_length(morse_code_t code) {
+    return code == MORSE_NONE ? 0 : 31 - __builtin_clz((unsigned int)code);
+}
+
+// Element `index` of a packed code, as DIT or DAH
+static inline int morse_element(morse_code_t code, int index) {
+    return (code >> (morse_length(code) - 1 - index)) & 1 ? DAH : DIT;
+}
 
 #endif // MORSE_CODE_CHARACTERS_H
@@ -0,0 +1,375 @@
+#include "paddle.h"
+#include "cJSON.h"
+#include "driver/gpio.h"
+#include "esp_http_server.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+#include "http.h"
+#include "keyer.h"
+#include "morse.h"
+#include "morse_code_characters.h"
+#include "pins.h"
+#include "ptt.h"
+#include "settings.h"
+#include "timing.h"
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+static const char *TAG = "PADDLE";
+
+#define PADDLE_DEBOUNCE_US 3000 // A press this soon after the last edge is contact bounce
+#define EVENT_QUEUE_LENGTH 32
+#define EVENT_BREAK_IN 0xFF // Sent alongside DIT and DAH when the paddles cut a message short
+#define EVENT_PTT_WAIT 0xFE // A press from idle waits for PTT; paddle_task keys it after the lead-in
+#define TIMING_REFRESH_MS 1000
+
+// Iambic state, shared by the paddle edge ISR and the keyer alarm ISR
+static portMUX_TYPE paddle_lock = portMUX_INITIALIZER_UNLOCKED;
+static bool dit_down = false;
+static bool dah_down = false;
+static bool dit_memory = false;
+static bool dah_memory = false;
+static int last_element = 0; // DIT or DAH
+static bool in_mark = false;
+static bool sending = false;
+static bool waiting_for_ptt = false; // Presses are remembered, not keyed, until PTT is on
+static int64_t last_edge_us[2] = {0, 0}; // Dit, dah
+static int64_t press_us = 0;
+
+// Element lengths used by the ISRs, refreshed by paddle_task while the paddles are idle
+static uint32_t dit_us;
+static uint32_t dah_us;
+static uint32_t gap_us;
+static uint32_t letter_gap_us;
+
+static paddle_status_t stats;
+static QueueHandle_t event_queue = NULL; // Elements keyed, for the decoder
+
+static SemaphoreHandle_t text_mutex = NULL;
+static char text[PADDLE_TEXT_MAX_SIZE] = "";
+
+// Caller must hold paddle_lock. Squeezed paddles alternate; otherwise whichever is
+// held or remembered goes next.
+static inline int IRAM_ATTR choose_element(void) {
+    bool dit = dit_down || dit_memory;
+    bool dah = dah_down || dah_memory;
+
+    if (dit && dah) {
+        return last_element == DIT ? DAH : DIT;
+    }
+    if (dit) {
+        return DIT;
+    }
+    if (dah) {
+        return DAH;
+    }
+    return 0;
+}
+
+// Keyer source: called at the end of every run. A mark is always followed by one element
+// gap; after the gap the paddles decide what comes next.
+static bool IRAM_ATTR paddle_next_run(keyer_run_t *run) {
+    int element = 0;
+
+    portENTER_CRITICAL_ISR(&paddle_lock);
+    if (in_mark) {
+        in_mark = false;
+        run->level = 0;
+        run->duration_us = gap_us;
+        portEXIT_CRITICAL_ISR(&paddle_lock);
+        return true;
+    }
+
+    element = choose_element();
+    if (element == 0) {
+        sending = false;
+    } else {
+        if (!sending) {
+            sending = true;
+            stats.latency_us = (uint32_t)(esp_timer_get_time() - press_us);
+            if (stats.latency_us > stats.max_latency_us) {
+                stats.max_latency_us = stats.latency_us;
+            }
+        }
+
+        if (element == DIT) {
+            dit_memory = false;
+            // Mode B: a squeeze still held when the element starts earns one more opposite element
+            dah_memory = dah_memory || (iambic_mode == IAMBIC_B && dah_down);
+        } else {
+            dah_memory = false;
+            dit_memory = dit_memory || (iambic_mode == IAMBIC_B && dit_down);
+        }
+
+        last_element = element;
+        in_mark = true;
+        stats.elements++;
+        run->level = 1;
+        run->duration_us = element == DAH ? dah_us : dit_us;
+    }
+    portEXIT_CRITICAL_ISR(&paddle_lock);
+
+    if (element == 0) {
+        return false;
+    }
+
+    // The keyer holds its lock around this call, so leave waking the decoder to the next tick
+    uint8_t event = element;
+    xQueueSendFromISR(event_queue, &event, NULL);
+    return true;
+}
+
+// Edge ISR for both paddles; arg is the paddle index (0 = dit, 1 = dah)
+static void IRAM_ATTR paddle_isr_handler(void *arg) {
+    int paddle = (int)(intptr_t)arg;
+    int64_t now_us = esp_timer_get_time();
+    bool down = gpio_get_level(paddle == 0 ? DIT_PADDLE_GPIO_PIN : DAH_PADDLE_GPIO_PIN) == 0;
+    bool start = false;
+    bool hold = false;
+
+    portENTER_CRITICAL_ISR(&paddle_lock);
+    bool *is_down = paddle == 0 ? &dit_down : &dah_down;
+    bool *memory = paddle == 0 ? &dit_memory : &dah_memory;
+
+    if (down && !*is_down && now_us - last_edge_us[paddle] >= PADDLE_DEBOUNCE_US) {
+        if (sending) {
+            *memory = *memory || paddle_memory; // Pressed during an element: remember it
+        } else if (waiting_for_ptt) {
+            *memory = true; // Keyed in turn once PTT is on
+        } else {
+            // With PTT off the first element would hot-switch the amplifier, so it waits out
+            // the lead-in; remembered, so a tap shorter than that is still sent
+            press_us = now_us;
+            hold = ptt_enabled && !ptt_is_ready();
+            waiting_for_ptt = hold;
+            *memory = *memory || hold;
+            start = !hold;
+        }
+    }
+    *is_down = down;
+    last_edge_us[paddle] = now_us;
+    portEXIT_CRITICAL_ISR(&paddle_lock);
+
+    uint8_t event = 0;
+    if (hold) {
+        event = EVENT_PTT_WAIT;
+    } else if (start && keyer_start_live_from_isr()) {
+        event = EVENT_BREAK_IN;
+    }
+    if (event != 0) {
+        BaseType_t high_task_woken = pdFALSE;
+        xQueueSendFromISR(event_queue, &event, &high_task_woken);
+        if (high_task_woken == pdTRUE) {
+            portYIELD_FROM_ISR();
+        }
+    }
+}
+
+static void refresh_timing(void) {
+    morse_timing_t timing;
+    timing_current(&timing);
+
+    portENTER_CRITICAL(&paddle_lock);
+    if (!sending) {
+        dit_us = timing.dit_us;
+        dah_us = timing.dah_us;
+        gap_us = timing.element_gap_us;
+        letter_gap_us = timing.letter_gap_us;
+    }
+    portEXIT_CRITICAL(&paddle_lock);
+}
+
+static void append_text(char c) {
+    xSemaphoreTake(text_mutex, portMAX_DELAY);
+    size_t length = strlen(text);
+    if (length >= sizeof(text) - 1) {
+        memmove(text, text + 1, length); // Keep the latest characters
+        length--;
+    }
+    text[length] = c;
+    text[length + 1] = '\0';
+    xSemaphoreGive(text_mutex);
+}
+
+static void break_in(void) {
+    ESP_LOGI(TAG, "Paddle break-in");
+    stats.break_ins++;
+    morse_abort();
+}
+
+// Key a press held back by the ISR once PTT is on and its lead-in has passed
+static void start_after_ptt(void) {
+    ptt_begin(PTT_SOURCE_PADDLE);
+    bool broke_in = keyer_start_live();
+
+    portENTER_CRITICAL(&paddle_lock);
+    waiting_for_ptt = false;
+    portEXIT_CRITICAL(&paddle_lock);
+    if (broke_in) {
+        break_in();
+    }
+}
+
+static TickType_t us_to_ticks(uint32_t us) {
+    return pdMS_TO_TICKS(us / 1000) + 1;
+}
+
+// Decodes the elements the keyer actually sent: a letter ends after a letter gap of
+// silence, a word after a word gap.
+static void paddle_task(void *arg) {
+    uint32_t code = 1; // Marker bit, then one bit per element as in morse_code_t
+    bool word_pending = false;
+
+    while (1) {
+        refresh_timing();
+
+        TickType_t wait = pdMS_TO_TICKS(TIMING_REFRESH_MS);
+        if (code > 1) {
+            wait = us_to_ticks(dah_us + gap_us + 2 * dit_us); // From the start of the last element
+        } else if (word_pending) {
+            wait = us_to_ticks(letter_gap_us);
+        }
+
+        uint8_t event;
+        if (xQueueReceive(event_queue, &event, wait) == pdTRUE) {
+            if (event == EVENT_BREAK_IN) {
+                break_in();
+            } else if (event == EVENT_PTT_WAIT) {
+                start_after_ptt();
+            } else {
+                // PTT is on: the first element waited for it if it was not. This keeps it
+                // from dropping between elements.
+                ptt_request(PTT_SOURCE_PADDLE);
+                if (code <= 0xFF) {
+                    code = code << 1 | (event == DAH);
+                }
+            }
+            continue;
+        }
+
+        if (code > 1) {
+            char c = code <= 0xFF ? morse_to_char((morse_code_t)code) : '\0';
+            append_text(c != '\0' ? c : '*');
+            ESP_LOGD(TAG, "Decoded '%c'", c != '\0' ? c : '*');
+            code = 1;
+            word_pending = true;
+            ptt_end(PTT_SOURCE_PADDLE);
+        } else if (word_pending) {
+            append_text(' ');
+            word_pending = false;
+        }
+    }
+}
+
+esp_err_t paddle_init(void) {
+    event_queue = xQueueCreate(EVENT_QUEUE_LENGTH, sizeof(uint8_t));
+    text_mutex = xSemaphoreCreateMutex();
+    if (event_queue == NULL || text_mutex == NULL) {
+        ESP_LOGE(TAG, "Failed to create paddle queue");
+        return ESP_FAIL;
+    }
+
+    refresh_timing();
+    keyer_set_live_source(paddle_next_run);
+
+    gpio_config_t io_conf = {
+        .pin_bit_mask = (1ULL << DIT_PADDLE_GPIO_PIN) | (1ULL << DAH_PADDLE_GPIO_PIN),
+        .mode = GPIO_MODE_INPUT,
+        .pull_up_en = GPIO_PULLUP_ENABLE,
+        .pull_down_en = GPIO_PULLDOWN_DISABLE,
+        .intr_type = GPIO_INTR_ANYEDGE,
+    };
+    gpio_config(&io_conf);
+
+    if (xTaskCreate(paddle_task, "paddle_task", 3072, NULL, 6, NULL) != pdPASS) {
+        ESP_LOGE(TAG, "Failed to create paddle task");
+        return ESP_FAIL;
+    }
+
+    // The button may already have installed the ISR service
+    esp_err_t err = gpio_install_isr_service(0);
+    if (err != ESP_OK && err != ESP_ERR_INVALID_STATE) {
+        ESP_LOGE(TAG, "Failed to install GPIO ISR service: %s", esp_err_to_name(err));
+        return err;
+    }
+    gpio_isr_handler_add(DIT_PADDLE_GPIO_PIN, paddle_isr_handler, (void *)0);
+    gpio_isr_handler_add(DAH_PADDLE_GPIO_PIN, paddle_isr_handler, (void *)1);
+
+    ESP_LOGI(TAG, "Paddles initialized on GPIO %d (dit) and %d (dah), iambic %c", DIT_PADDLE_GPIO_PIN,
+             DAH_PADDLE_GPIO_PIN, iambic_mode == IAMBIC_A ? 'A' : 'B');
+    return ESP_OK;
+}
+
+void paddle_get_status(paddle_status_t *status) {
+    portENTER_CRITICAL(&paddle_lock);
+    *status = stats;
+    status->sending = sending;
+    portEXIT_CRITICAL(&paddle_lock);
+}
+
+void paddle_get_text(char *value, size_t size) {
+    xSemaphoreTake(text_mutex, portMAX_DELAY);
+    strncpy(value, text, size - 1);
+    value[size - 1] = '\0';
+    xSemaphoreGive(text_mutex);
+}
+
+void paddle_clear_text(void) {
+    xSemaphoreTake(text_mutex, portMAX_DELAY);
+    text[0] = '\0';
+    xSemaphoreGive(text_mutex);
+}
+
+static esp_err_t get_paddle_handler(httpd_req_t *req) {
+    paddle_status_t status;
+    paddle_get_status(&status);
+    char decoded[PADDLE_TEXT_MAX_SIZE];
+    paddle_get_text(decoded, sizeof(decoded));
+
+    cJSON *json = cJSON_CreateObject();
+    if (!json) {
+        ESP_LOGE(TAG, "Failed to create JSON object");
+        httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Failed to create JSON response");
+        return ESP_FAIL;
+    }
+
+    cJSON_AddStringToObject(json, "text", decoded);
+    cJSON_AddBoolToObject(json, "sending", status.sending);
+    cJSON_AddNumberToObject(json, "latency_us", status.latency_us);
+    cJSON_AddNumberToObject(json, "max_latency_us", status.max_latency_us);
+    cJSON_AddNumberToObject(json, "elements", status.elements);
+    cJSON_AddNumberToObject(json, "break_ins", status.break_ins);
+
+    const char *response = cJSON_PrintUnformatted(json);
+    if (!response) {
+        ESP_LOGE(TAG, "Failed to print JSON response");
+        cJSON_Delete(json);
+        httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Failed to create JSON response");
+        return ESP_FAIL;
+    }
+
+    httpd_resp_set_type(req, "application/json");
+    httpd_resp_send(req, response, strlen(response));
+
+    cJSON_Delete(json);
+    free((void *)response);
+    return ESP_OK;
+}
+
+static esp_err_t clear_paddle_handler(httpd_req_t *req) {
+    paddle_clear_text();
+    httpd_resp_set_type(req, "application/json");
+    httpd_resp_send(req, "{\"result\": \"Paddle text cleared\"}", HTTPD_RESP_USE_STRLEN);
+    return ESP_OK;
+}
+
+void register_paddle_endpoints(void) {
+    register_html_page("/api/paddle", HTTP_GET, get_paddle_handler);
+    register_html_page("/api/paddle/clear", HTTP_POST, clear_paddle_handler);
+    ESP_LOGI(TAG, "Paddle API endpoints registered");
+}
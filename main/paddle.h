@@ -0,0 +1,29 @@
+#ifndef PADDLE_H
+#define PADDLE_H
+
+#include "esp_err.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define IAMBIC_A 0 // Stop after the element in progress when the paddles are released
+#define IAMBIC_B 1 // Squeeze release sends one more, opposite element
+
+#define PADDLE_TEXT_MAX_SIZE 64
+
+typedef struct {
+    bool sending;
+    uint32_t latency_us; // Paddle edge to key-down of the last character started from idle, PTT lead-in included
+    uint32_t max_latency_us;
+    uint32_t elements;
+    uint32_t break_ins;
+} paddle_status_t;
+
+esp_err_t paddle_init(void);
+void paddle_get_status(paddle_status_t *status);
+void paddle_get_text(char *text, size_t size);
+void paddle_clear_text(void);
+
+void register_paddle_endpoints(void);
+
+#endif // PADDLE_H
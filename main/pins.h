@@ -6,5 +6,8 @@
 #define BUTTON_GPIO_PIN 2
 #define KEY_GPIO_PIN 3
 #define LED_GPIO_PIN 4
+#define SIDETONE_GPIO_PIN 5 // LEDC PWM to a piezo or small amplifier
+#define DIT_PADDLE_GPIO_PIN 0 // Paddles are active low, with internal pull-ups
+#define DAH_PADDLE_GPIO_PIN 1
 #define RXD_PIN 10
 #define TXD_PIN 9
@@ -0,0 +1,157 @@
+#include "ptt.h"
+#include "cat.h"
+#include "esp_attr.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+#include "freertos/timers.h"
+#include "radio_cache.h"
+#include "settings.h"
+
+static const char *TAG = "PTT";
+
+#define PTT_CAT_TIMEOUT_MS 1000 // Give up waiting for the radio and key anyway
+
+// CAT PTT commands are only sent from ptt_task, so keying never waits on the radio
+// for longer than the lead-in. The morse and paddle tasks and rigctld each set their bit
+// in `wanted`; the hang timer says when PTT may drop once none is left.
+static TaskHandle_t ptt_task_handle = NULL;
+static SemaphoreHandle_t on_semaphore = NULL;
+static TimerHandle_t hang_timer = NULL;
+static portMUX_TYPE ptt_lock = portMUX_INITIALIZER_UNLOCKED;
+static volatile uint32_t wanted = 0; // PTT_SOURCE_* bits
+static volatile bool hang_expired = true;
+static volatile int64_t on_since_us = 0;
+static volatile esp_err_t on_result = ESP_OK; // Of the last PTT-on command
+static ptt_status_t stats;
+
+static void hang_timer_callback(TimerHandle_t timer) {
+    hang_expired = true;
+    xTaskNotifyGive(ptt_task_handle);
+}
+
+static void ptt_task(void *arg) {
+    cat_register_client("ptt", CAT_PRIORITY_PTT);
+
+    while (1) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+
+        if (wanted && !stats.on) {
+            on_since_us = esp_timer_get_time(); // The lead-in runs while the command is in flight
+            on_result = radio_cache_set_ptt(true);
+            if (on_result == ESP_OK) {
+                stats.transmissions++;
+            } else {
+                ESP_LOGE(TAG, "Failed to turn PTT on");
+                stats.failures++;
+            }
+            stats.on = true; // Assume on, so PTT off is still sent if the reply was lost
+        } else if (!wanted && stats.on && hang_expired) {
+            if (radio_cache_set_ptt(false) != ESP_OK) {
+                ESP_LOGE(TAG, "Failed to turn PTT off");
+                stats.failures++;
+            }
+            stats.on = false;
+        }
+
+        if (wanted) {
+            xSemaphoreGive(on_semaphore);
+        }
+    }
+}
+
+esp_err_t ptt_init(void) {
+    on_semaphore = xSemaphoreCreateBinary();
+    hang_timer = xTimerCreate("ptt_hang", pdMS_TO_TICKS(PTT_HANG_DEFAULT_MS), pdFALSE, NULL, hang_timer_callback);
+    if (on_semaphore == NULL || hang_timer == NULL) {
+        ESP_LOGE(TAG, "Failed to create PTT semaphore or timer");
+        return ESP_FAIL;
+    }
+
+    if (xTaskCreate(ptt_task, "ptt_task", 3072, NULL, 7, &ptt_task_handle) != pdPASS) {
+        ESP_LOGE(TAG, "Failed to create PTT task");
+        return ESP_FAIL;
+    }
+
+    ESP_LOGI(TAG, "PTT sequencer initialized (%s)", ptt_enabled ? "enabled" : "disabled");
+    return ESP_OK;
+}
+
+static bool is_served(ptt_source_t source) {
+    return ptt_task_handle != NULL && (ptt_enabled || source == PTT_SOURCE_CAT);
+}
+
+// Ask for PTT without waiting for it, e.g. for paddles that key straight away
+void ptt_request(ptt_source_t source) {
+    if (!is_served(source)) {
+        return;
+    }
+
+    xTimerStop(hang_timer, 0);
+    portENTER_CRITICAL(&ptt_lock);
+    hang_expired = false;
+    wanted |= source;
+    portEXIT_CRITICAL(&ptt_lock);
+    xTaskNotifyGive(ptt_task_handle);
+}
+
+// Before a transmission: returns once PTT is on and the lead-in has passed. Within the
+// hang time of the last transmission PTT is still on, so this returns at once. Keying
+// goes ahead whatever the result; it is for a program that asked over CAT.
+esp_err_t ptt_begin(ptt_source_t source) {
+    if (!is_served(source)) {
+        return ptt_task_handle == NULL ? ESP_ERR_INVALID_STATE : ESP_OK;
+    }
+
+    xSemaphoreTake(on_semaphore, 0);
+    ptt_request(source);
+    if (xSemaphoreTake(on_semaphore, pdMS_TO_TICKS(PTT_CAT_TIMEOUT_MS)) != pdTRUE) {
+        ESP_LOGW(TAG, "No answer from PTT task, keying anyway");
+        return ESP_ERR_TIMEOUT;
+    }
+
+    int64_t lead_left_us = on_since_us + (int64_t)ptt_lead_ms * 1000 - esp_timer_get_time();
+    if (lead_left_us > 0) {
+        vTaskDelay(pdMS_TO_TICKS((lead_left_us + 999) / 1000) + 1);
+    }
+    return on_result;
+}
+
+// After the last key-up of a transmission: once no other source wants it, PTT drops
+// after the tail or hang time, whichever is longer, unless another transmission begins first
+void ptt_end(ptt_source_t source) {
+    if (ptt_task_handle == NULL) {
+        return;
+    }
+
+    portENTER_CRITICAL(&ptt_lock);
+    wanted &= ~(uint32_t)source;
+    bool still_wanted = wanted != 0;
+    portEXIT_CRITICAL(&ptt_lock);
+    if (still_wanted) {
+        return; // The hang time starts when the last source lets go
+    }
+
+    // A program times its own transmission, so PTT drops when it says
+    int drop_ms = source == PTT_SOURCE_CAT ? 0 : ptt_hang_ms > ptt_tail_ms ? ptt_hang_ms : ptt_tail_ms;
+    if (drop_ms > 0 && ptt_enabled) {
+        hang_expired = false;
+        xTimerChangePeriod(hang_timer, pdMS_TO_TICKS(drop_ms) + 1, 0); // Also starts the timer
+    } else {
+        hang_expired = true;
+        xTaskNotifyGive(ptt_task_handle);
+    }
+}
+
+// True while PTT is on, not about to drop and past its lead-in, so keying may start at
+// once. Safe from an ISR.
+bool IRAM_ATTR ptt_is_ready(void) {
+    return stats.on && !hang_expired && esp_timer_get_time() - on_since_us >= (int64_t)ptt_lead_ms * 1000;
+}
+
+void ptt_get_status(ptt_status_t *status) {
+    *status = stats;
+    status->held = wanted != 0 || (stats.on && !hang_expired);
+}
@@ -0,0 +1,35 @@
+#ifndef PTT_H
+#define PTT_H
+
+#include "esp_err.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+#define PTT_LEAD_DEFAULT_MS 50  // PTT to first key-down, for amplifier relays to settle
+#define PTT_TAIL_DEFAULT_MS 20  // Last key-up to PTT release at the earliest
+#define PTT_HANG_DEFAULT_MS 500 // PTT stays on this long waiting for more to send
+
+// Who wants PTT. It is held while any of them does, so the paddles finishing a letter
+// cannot drop it under a message and the other way round. A program asking over CAT is
+// served even with ptt_enabled off, which only says whether keying asks for PTT.
+typedef enum {
+    PTT_SOURCE_MORSE = 0x01,  // Stored messages and typed characters
+    PTT_SOURCE_PADDLE = 0x02, // Live keying
+    PTT_SOURCE_CAT = 0x04,    // A program over rigctld
+} ptt_source_t;
+
+typedef struct {
+    bool on;                // As last sent to the radio
+    bool held;              // Wanted by a source or within the hang time, so staying on
+    uint32_t transmissions; // PTT-on commands sent
+    uint32_t failures;
+} ptt_status_t;
+
+esp_err_t ptt_init(void);
+esp_err_t ptt_begin(ptt_source_t source);
+void ptt_request(ptt_source_t source);
+void ptt_end(ptt_source_t source);
+bool ptt_is_ready(void);
+void ptt_get_status(ptt_status_t *status);
+
+#endif // PTT_H
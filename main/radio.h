@@ -3,6 +3,7 @@
 
 #include <stdint.h>
 #include <stdbool.h>
+#include "cat.h"
 #include "esp_err.h"
 
 esp_err_t init_radio();
@@ -10,10 +11,40 @@ esp_err_t get_frequency(uint32_t *frequency);
 esp_err_t set_frequency(uint32_t frequency);
 esp_err_t get_mode(uint8_t *mode);
 esp_err_t set_mode(uint8_t mode);
+esp_err_t get_frequency_and_mode(uint32_t *frequency, uint8_t *mode); // One CAT read where the radio allows
 esp_err_t set_ptt(bool enable);
 esp_err_t get_power(uint8_t *power);
 esp_err_t set_power(uint8_t power);
 
+// Fields for set_mode_power_frequency(), which writes the selected ones in as few CAT
+// transactions as the radio allows
+#define RADIO_SET_MODE      0x01
+#define RADIO_SET_POWER     0x02
+#define RADIO_SET_FREQUENCY 0x04
+esp_err_t set_mode_power_frequency(uint8_t mode, uint8_t power, uint32_t frequency, uint8_t fields);
+
+// One memory channel, for backup and restore
+typedef struct {
+    uint16_t channel;
+    uint32_t frequency; // Hz
+    int16_t clarifier;  // Clarifier offset in Hz
+    uint8_t mode;       // The radio's own mode code
+    uint8_t flags;      // RADIO_MEMORY_*
+    uint8_t tone;       // CTCSS/DCS setting, in the radio's own code
+    uint8_t shift;      // Repeater shift, in the radio's own code
+} radio_memory_t;
+
+#define RADIO_MEMORY_RX_CLARIFIER 0x01
+#define RADIO_MEMORY_TX_CLARIFIER 0x02
+
+// Memory channels are numbered 1..memory_channel_count(), which is 0 if the radio has
+// no CAT access to them. The driver only builds the requests and decodes the replies,
+// so the caller can keep many of them in flight with cat_submit().
+uint16_t memory_channel_count(void);
+esp_err_t memory_read_request(uint16_t channel, cat_request_t *request);
+esp_err_t memory_decode(uint16_t channel, esp_err_t result, const uint8_t *response, size_t length, radio_memory_t *memory); // ESP_ERR_NOT_FOUND: empty
+esp_err_t memory_write_request(const radio_memory_t *memory, cat_request_t *request);
+
 uint8_t string_to_mode(const char* mode_str);
 const char* mode_to_string(uint8_t mode);
 
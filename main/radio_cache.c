@@ -0,0 +1,272 @@
+#include "radio_cache.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "radio.h"
+
+static const char *TAG = "RADIO_CACHE";
+
+typedef struct {
+    uint32_t value;
+    bool valid;
+    int64_t updated_us;
+    uint32_t ttl_ms; // 0 = never expires
+    bool pushed;     // The radio reports changes, so RADIO_CACHE_PUSH_TTL_MS applies
+} cached_field_t;
+
+// The lock only covers the fields, never a CAT call: a caller inside a CAT session must
+// not wait on a caller whose transaction the session is holding back
+static portMUX_TYPE cache_lock = portMUX_INITIALIZER_UNLOCKED;
+static cached_field_t frequency_field = {.ttl_ms = RADIO_CACHE_FREQUENCY_TTL_MS};
+static cached_field_t mode_field = {.ttl_ms = RADIO_CACHE_MODE_TTL_MS};
+static cached_field_t power_field = {.ttl_ms = RADIO_CACHE_POWER_TTL_MS};
+static cached_field_t ptt_field = {.ttl_ms = RADIO_CACHE_PTT_TTL_MS};
+static radio_cache_stats_t stats;
+
+static bool is_fresh(const cached_field_t *field, int64_t now_us) {
+    uint32_t ttl_ms = field->pushed && field->ttl_ms != 0 ? RADIO_CACHE_PUSH_TTL_MS : field->ttl_ms;
+    return field->valid && (ttl_ms == 0 || now_us - field->updated_us < (int64_t)ttl_ms * 1000);
+}
+
+// Copy out a fresh value; returns false when the field is unknown or stale
+static bool peek(const cached_field_t *field, uint32_t *value) {
+    int64_t now_us = esp_timer_get_time();
+    bool fresh;
+
+    portENTER_CRITICAL(&cache_lock);
+    fresh = is_fresh(field, now_us);
+    if (fresh) {
+        *value = field->value;
+    }
+    portEXIT_CRITICAL(&cache_lock);
+    return fresh;
+}
+
+// peek() for a read, counted as a hit or a miss
+static bool lookup(const cached_field_t *field, uint32_t *value) {
+    bool hit = peek(field, value);
+    if (hit) {
+        stats.hits++;
+    } else {
+        stats.misses++;
+    }
+    return hit;
+}
+
+static void store(cached_field_t *field, uint32_t value) {
+    int64_t now_us = esp_timer_get_time();
+
+    portENTER_CRITICAL(&cache_lock);
+    field->value = value;
+    field->valid = true;
+    field->updated_us = now_us;
+    portEXIT_CRITICAL(&cache_lock);
+}
+
+static void push(cached_field_t *field, uint32_t value) {
+    int64_t now_us = esp_timer_get_time();
+
+    portENTER_CRITICAL(&cache_lock);
+    field->value = value;
+    field->valid = true;
+    field->pushed = true;
+    field->updated_us = now_us;
+    portEXIT_CRITICAL(&cache_lock);
+    stats.pushes++;
+}
+
+static void forget(cached_field_t *field) {
+    portENTER_CRITICAL(&cache_lock);
+    field->valid = false;
+    portEXIT_CRITICAL(&cache_lock);
+}
+
+// Refresh frequency and mode together; both come from the same CAT read
+static esp_err_t fetch_frequency_and_mode(uint32_t *frequency, uint8_t *mode) {
+    stats.reads++;
+    esp_err_t err = get_frequency_and_mode(frequency, mode);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to read frequency and mode");
+        return err;
+    }
+
+    store(&frequency_field, *frequency);
+    store(&mode_field, *mode);
+    return ESP_OK;
+}
+
+esp_err_t radio_cache_get_frequency(uint32_t *frequency) {
+    uint8_t mode;
+
+    if (lookup(&frequency_field, frequency)) {
+        return ESP_OK;
+    }
+    return fetch_frequency_and_mode(frequency, &mode);
+}
+
+esp_err_t radio_cache_get_mode(uint8_t *mode) {
+    uint32_t value;
+    uint32_t frequency;
+
+    if (lookup(&mode_field, &value)) {
+        *mode = value;
+        return ESP_OK;
+    }
+    return fetch_frequency_and_mode(&frequency, mode);
+}
+
+esp_err_t radio_cache_get_frequency_and_mode(uint32_t *frequency, uint8_t *mode) {
+    uint32_t value;
+
+    if (lookup(&frequency_field, frequency) && lookup(&mode_field, &value)) {
+        *mode = value;
+        return ESP_OK;
+    }
+    return fetch_frequency_and_mode(frequency, mode);
+}
+
+esp_err_t radio_cache_get_power(uint8_t *power) {
+    uint32_t value;
+
+    if (lookup(&power_field, &value)) {
+        *power = value;
+        return ESP_OK;
+    }
+
+    stats.reads++;
+    esp_err_t err = get_power(power);
+    if (err != ESP_OK) {
+        return err;
+    }
+    store(&power_field, *power);
+    return ESP_OK;
+}
+
+// PTT has no read command, so this is the last state sent
+esp_err_t radio_cache_get_ptt(bool *enable) {
+    uint32_t value;
+
+    if (!lookup(&ptt_field, &value)) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    *enable = value != 0;
+    return ESP_OK;
+}
+
+// Send a set unless the radio is known to have the value already
+static esp_err_t write_field(cached_field_t *field, uint32_t value, bool always, esp_err_t (*write)(uint32_t)) {
+    uint32_t cached;
+
+    if (!always && peek(field, &cached) && cached == value) {
+        stats.skipped_writes++;
+        return ESP_OK;
+    }
+
+    stats.writes++;
+    esp_err_t err = write(value);
+    if (err != ESP_OK) {
+        forget(field); // The radio may or may not have taken it
+        return err;
+    }
+    store(field, value);
+    return ESP_OK;
+}
+
+static esp_err_t write_frequency(uint32_t value) {
+    return set_frequency(value);
+}
+
+static esp_err_t write_mode(uint32_t value) {
+    return set_mode(value);
+}
+
+static esp_err_t write_power(uint32_t value) {
+    return set_power(value);
+}
+
+static esp_err_t write_ptt(uint32_t value) {
+    return set_ptt(value != 0);
+}
+
+esp_err_t radio_cache_set_frequency(uint32_t frequency) {
+    return write_field(&frequency_field, frequency, false, write_frequency);
+}
+
+esp_err_t radio_cache_set_mode(uint8_t mode) {
+    return write_field(&mode_field, mode, false, write_mode);
+}
+
+esp_err_t radio_cache_set_power(uint8_t power) {
+    return write_field(&power_field, power, false, write_power);
+}
+
+// Always sent: a PTT command must never be lost to a stale idea of the radio's state
+esp_err_t radio_cache_set_ptt(bool enable) {
+    return write_field(&ptt_field, enable, true, write_ptt);
+}
+
+// Set all three with one driver call, leaving out the fields the radio already has
+esp_err_t radio_cache_set_mode_power_frequency(uint8_t mode, uint8_t power, uint32_t frequency) {
+    cached_field_t *fields[] = {&mode_field, &power_field, &frequency_field};
+    const uint32_t values[] = {mode, power, frequency};
+    const uint8_t flags[] = {RADIO_SET_MODE, RADIO_SET_POWER, RADIO_SET_FREQUENCY};
+    uint8_t changed = 0;
+
+    for (size_t i = 0; i < sizeof(fields) / sizeof(fields[0]); i++) {
+        uint32_t cached;
+        if (peek(fields[i], &cached) && cached == values[i]) {
+            stats.skipped_writes++;
+        } else {
+            changed |= flags[i];
+        }
+    }
+    if (changed == 0) {
+        return ESP_OK;
+    }
+
+    stats.writes++;
+    esp_err_t err = set_mode_power_frequency(mode, power, frequency, changed);
+    for (size_t i = 0; i < sizeof(fields) / sizeof(fields[0]); i++) {
+        if (!(changed & flags[i])) {
+            continue;
+        }
+        if (err == ESP_OK) {
+            store(fields[i], values[i]);
+        } else {
+            forget(fields[i]);
+        }
+    }
+    return err;
+}
+
+void radio_cache_push_frequency(uint32_t frequency) {
+    push(&frequency_field, frequency);
+}
+
+void radio_cache_push_mode(uint8_t mode) {
+    push(&mode_field, mode);
+}
+
+void radio_cache_push_power(uint8_t power) {
+    push(&power_field, power);
+}
+
+void radio_cache_push_ptt(bool enable) {
+    push(&ptt_field, enable);
+}
+
+// Forget everything, including that the radio was pushing changes
+void radio_cache_invalidate(void) {
+    cached_field_t *fields[] = {&frequency_field, &mode_field, &power_field, &ptt_field};
+
+    portENTER_CRITICAL(&cache_lock);
+    for (size_t i = 0; i < sizeof(fields) / sizeof(fields[0]); i++) {
+        fields[i]->valid = false;
+        fields[i]->pushed = false;
+    }
+    portEXIT_CRITICAL(&cache_lock);
+}
+
+void radio_cache_get_stats(radio_cache_stats_t *out) {
+    *out = stats;
+}
@@ -0,0 +1,55 @@
+#ifndef RADIO_CACHE_H
+#define RADIO_CACHE_H
+
+#include "esp_err.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+// How long a value read from or written to the radio is trusted. The operator can turn
+// the VFO at any time, so frequency goes stale first. PTT cannot be read back and is
+// kept until the next set.
+#define RADIO_CACHE_FREQUENCY_TTL_MS 1000
+#define RADIO_CACHE_MODE_TTL_MS 5000
+#define RADIO_CACHE_POWER_TTL_MS 10000
+#define RADIO_CACHE_PTT_TTL_MS 0 // Never expires
+
+// A radio that reports its own changes (FT-991A Auto Information) keeps pushed fields
+// current, so they are trusted far longer; the limit only covers the radio losing the
+// setting, e.g. across a power cycle
+#define RADIO_CACHE_PUSH_TTL_MS 60000
+
+typedef struct {
+    uint32_t hits;
+    uint32_t misses;
+    uint32_t reads;          // CAT reads issued on a miss
+    uint32_t writes;         // CAT writes issued
+    uint32_t skipped_writes; // Sets that matched a fresh cached value
+    uint32_t pushes;         // Values reported by the radio unasked
+} radio_cache_stats_t;
+
+// Reads are answered from the cache while fresh. A miss on frequency or mode refreshes
+// both with one get_frequency_and_mode().
+esp_err_t radio_cache_get_frequency(uint32_t *frequency);
+esp_err_t radio_cache_get_mode(uint8_t *mode);
+esp_err_t radio_cache_get_frequency_and_mode(uint32_t *frequency, uint8_t *mode);
+esp_err_t radio_cache_get_power(uint8_t *power);
+esp_err_t radio_cache_get_ptt(bool *enable);
+
+// Writes go to the radio unless the fresh cached value already matches (PTT is always
+// sent). The cache takes the new value on success and forgets the field on failure.
+esp_err_t radio_cache_set_frequency(uint32_t frequency);
+esp_err_t radio_cache_set_mode(uint8_t mode);
+esp_err_t radio_cache_set_power(uint8_t power);
+esp_err_t radio_cache_set_ptt(bool enable);
+esp_err_t radio_cache_set_mode_power_frequency(uint8_t mode, uint8_t power, uint32_t frequency);
+
+// Values the radio reported without being asked, from the driver's CAT listener
+void radio_cache_push_frequency(uint32_t frequency);
+void radio_cache_push_mode(uint8_t mode);
+void radio_cache_push_power(uint8_t power);
+void radio_cache_push_ptt(bool enable);
+
+void radio_cache_invalidate(void);
+void radio_cache_get_stats(radio_cache_stats_t *stats);
+
+#endif // RADIO_CACHE_H
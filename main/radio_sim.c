@@ -0,0 +1,355 @@
+#include "radio_sim.h"
+#include "cat_codec.h"
+#include <string.h>
+
+// FT-857D opcodes, the last of the five command bytes
+#define FT857D_SET_FREQ 0x01
+#define FT857D_READ_FREQ 0x03
+#define FT857D_SET_MODE 0x07
+#define FT857D_PTT_ON 0x08
+#define FT857D_PTT_OFF 0x88
+#define FT857D_READ_RX_STATUS 0xE7
+#define FT857D_READ_TX_STATUS 0xF7
+#define FT857D_COMMAND_SIZE 5
+#define FT857D_ACK 0x00
+#define FT857D_NAK 0xF0 // Refused, e.g. PTT on while already transmitting
+
+#define FT991A_MIN_FREQUENCY 30000
+#define FT991A_MAX_FREQUENCY 470000000
+#define FT991A_MIN_POWER 5
+#define FT991A_MAX_POWER 100
+#define FT991A_MAX_MODE 0xE
+#define FT991A_PRESET_CHANNELS 40 // Programmed at power on, the rest are empty
+
+#define BITS_PER_BYTE 10 // Start, eight data bits, stop
+
+static const uint8_t ft857d_modes[] = {0x00, 0x01, 0x02, 0x03, 0x04, 0x08, 0x0A, 0x0C, 0x88, 0x8A, 0x8C};
+
+static int64_t byte_time_us(uint32_t baud_rate) {
+    return (BITS_PER_BYTE * 1000000LL + baud_rate - 1) / baud_rate;
+}
+
+static int64_t later(int64_t a, int64_t b) {
+    return a > b ? a : b;
+}
+
+// Same sequence on every platform for the same seed
+static bool drop_byte(radio_sim_t *sim) {
+    if (sim->config.drop_per_mille == 0) {
+        return false;
+    }
+    sim->random = sim->random * 1103515245 + 12345;
+    return (sim->random >> 16) % 1000 < sim->config.drop_per_mille;
+}
+
+// Send a reply once the radio has taken `latency_us` to act on a command finished at
+// `done_us`, after anything it is still sending
+static void send_reply(radio_sim_t *sim, const uint8_t *data, size_t size, int64_t done_us) {
+    int64_t byte_us = byte_time_us(sim->config.baud_rate);
+    int64_t due_us = later(done_us + sim->config.latency_us, sim->tx_done_us);
+
+    for (size_t i = 0; i < size; i++) {
+        due_us += byte_us;
+        sim->stats.tx_bytes++;
+        if (drop_byte(sim) || sim->count == RADIO_SIM_QUEUE_SIZE) {
+            sim->stats.dropped++;
+            continue;
+        }
+        size_t tail = (sim->head + sim->count) % RADIO_SIM_QUEUE_SIZE;
+        sim->queue[tail] = data[i];
+        sim->due_us[tail] = due_us;
+        sim->count++;
+    }
+    sim->tx_done_us = due_us;
+}
+
+static void send_byte(radio_sim_t *sim, uint8_t value, int64_t done_us) {
+    send_reply(sim, &value, 1, done_us);
+}
+
+static void send_field(radio_sim_t *sim, const char *prefix, uint32_t value, int digits, int base, int64_t done_us) {
+    char frame[RADIO_SIM_COMMAND_MAX_SIZE];
+    size_t size = codec_encode_text(frame, sizeof(frame), prefix, value, digits, base);
+    send_reply(sim, (const uint8_t *)frame, size, done_us);
+}
+
+static void run_ft857d_command(radio_sim_t *sim, int64_t done_us) {
+    const uint8_t *command = sim->command;
+    uint32_t value;
+
+    switch (command[4]) {
+    case FT857D_READ_FREQ: {
+        uint8_t reply[FT857D_COMMAND_SIZE];
+        codec_encode_bcd(sim->frequency / 10, reply, 4);
+        reply[4] = sim->mode;
+        send_reply(sim, reply, sizeof(reply), done_us);
+        break;
+    }
+
+    case FT857D_SET_FREQ:
+        if (codec_decode_bcd(command, 4, &value)) {
+            sim->frequency = value * 10;
+            send_byte(sim, FT857D_ACK, done_us);
+        } else {
+            send_byte(sim, FT857D_NAK, done_us);
+        }
+        break;
+
+    case FT857D_SET_MODE:
+        if (memchr(ft857d_modes, command[0], sizeof(ft857d_modes)) != NULL) {
+            sim->mode = command[0];
+            send_byte(sim, FT857D_ACK, done_us);
+        } else {
+            send_byte(sim, FT857D_NAK, done_us);
+        }
+        break;
+
+    case FT857D_PTT_ON:
+        send_byte(sim, sim->ptt ? FT857D_NAK : FT857D_ACK, done_us);
+        sim->ptt = true;
+        break;
+
+    case FT857D_PTT_OFF:
+        send_byte(sim, sim->ptt ? FT857D_ACK : FT857D_NAK, done_us);
+        sim->ptt = false;
+        break;
+
+    case FT857D_READ_RX_STATUS:
+        send_byte(sim, 0x00, done_us); // S0, squelch open
+        break;
+
+    case FT857D_READ_TX_STATUS:
+        send_byte(sim, sim->ptt ? 0x00 : 0x80, done_us); // Bit 7 set while receiving
+        break;
+
+    default:
+        sim->stats.rejected++; // The radio ignores what it does not know
+        return;
+    }
+    sim->stats.commands++;
+}
+
+// True if the command is `prefix`, then `digits` digits of `base`, then ';'
+static bool is_command(const char *command, size_t size, const char *prefix, int digits, int base, uint32_t *value) {
+    return codec_text_has_prefix(command, size, prefix) && size == strlen(prefix) + digits + 1 &&
+           (digits == 0 || codec_decode_text_field(command, size, strlen(prefix), digits, base, value));
+}
+
+// IF reply: memory channel, frequency, clarifier, RX and TX clarifier, mode, then
+// status fields
+static void send_information(radio_sim_t *sim, int64_t done_us) {
+    char frame[RADIO_SIM_COMMAND_MAX_SIZE];
+
+    size_t size = codec_encode_text(frame, sizeof(frame), "IF001", sim->frequency, 9, CODEC_DECIMAL) - 1;
+    memcpy(frame + size, "+000000", 7);
+    size += 7;
+    size += codec_encode_text(frame + size, sizeof(frame) - size, "", sim->mode, 1, CODEC_HEX) - 1;
+    memcpy(frame + size, "00000;", 6);
+    size += 6;
+    send_reply(sim, (const uint8_t *)frame, size, done_us);
+}
+
+// Memory channel fields in MR/MW order: frequency, clarifier, RX and TX clarifier, mode,
+// VFO/memory, tone, two fixed zeros, shift
+static void program_memory(radio_sim_t *sim, uint32_t channel, uint32_t frequency, uint8_t mode) {
+    char fields[RADIO_SIM_MEMORY_SIZE + 1];
+
+    size_t size = codec_encode_text(fields, sizeof(fields), "", frequency, 9, CODEC_DECIMAL) - 1;
+    memcpy(fields + size, "+000000", 7);
+    size += 7;
+    size += codec_encode_text(fields + size, sizeof(fields) - size, "", mode, 1, CODEC_HEX) - 1;
+    memcpy(fields + size, "10000", 5);
+    memcpy(sim->memory[channel - 1], fields, RADIO_SIM_MEMORY_SIZE);
+    sim->programmed[channel - 1] = true;
+}
+
+static void send_memory(radio_sim_t *sim, uint32_t channel, int64_t done_us) {
+    char frame[RADIO_SIM_COMMAND_MAX_SIZE];
+
+    size_t size = codec_encode_text(frame, sizeof(frame), "MR", channel, 3, CODEC_DECIMAL) - 1;
+    memcpy(frame + size, sim->memory[channel - 1], RADIO_SIM_MEMORY_SIZE);
+    size += RADIO_SIM_MEMORY_SIZE;
+    frame[size++] = ';';
+    send_reply(sim, (const uint8_t *)frame, size, done_us);
+}
+
+// MW: channel, then the memory fields. Checks the fields the radio would act on.
+static bool write_memory(radio_sim_t *sim, const char *command, size_t size) {
+    uint32_t channel, frequency, mode;
+
+    if (size != 2 + 3 + RADIO_SIM_MEMORY_SIZE + 1 || !codec_decode_text_field(command, size, 2, 3, CODEC_DECIMAL, &channel) ||
+        !codec_decode_text_field(command, size, 5, 9, CODEC_DECIMAL, &frequency) ||
+        !codec_decode_text_field(command, size, 21, 1, CODEC_HEX, &mode) || channel < 1 ||
+        channel > RADIO_SIM_MEMORY_CHANNELS || frequency < FT991A_MIN_FREQUENCY || frequency > FT991A_MAX_FREQUENCY ||
+        mode < 1 || mode > FT991A_MAX_MODE) {
+        return false;
+    }
+
+    memcpy(sim->memory[channel - 1], command + 5, RADIO_SIM_MEMORY_SIZE);
+    sim->programmed[channel - 1] = true;
+    return true;
+}
+
+static void run_ft991a_command(radio_sim_t *sim, int64_t done_us) {
+    const char *command = (const char *)sim->command;
+    size_t size = sim->command_size;
+    uint32_t value = 0;
+    bool valid = true;
+
+    if (is_command(command, size, "FA", 0, CODEC_DECIMAL, &value)) {
+        send_field(sim, "FA", sim->frequency, 9, CODEC_DECIMAL, done_us);
+    } else if (is_command(command, size, "FA", 9, CODEC_DECIMAL, &value)) {
+        valid = value >= FT991A_MIN_FREQUENCY && value <= FT991A_MAX_FREQUENCY;
+        sim->frequency = valid ? value : sim->frequency;
+    } else if (is_command(command, size, "MD0", 0, CODEC_HEX, &value)) {
+        send_field(sim, "MD0", sim->mode, 1, CODEC_HEX, done_us);
+    } else if (is_command(command, size, "MD0", 1, CODEC_HEX, &value)) {
+        valid = value >= 1 && value <= FT991A_MAX_MODE;
+        sim->mode = valid ? value : sim->mode;
+    } else if (is_command(command, size, "PC", 0, CODEC_DECIMAL, &value)) {
+        send_field(sim, "PC", sim->power, 3, CODEC_DECIMAL, done_us);
+    } else if (is_command(command, size, "PC", 3, CODEC_DECIMAL, &value)) {
+        valid = value >= FT991A_MIN_POWER && value <= FT991A_MAX_POWER;
+        sim->power = valid ? value : sim->power;
+    } else if (is_command(command, size, "TX", 0, CODEC_DECIMAL, &value)) {
+        send_field(sim, "TX", sim->ptt ? 1 : 0, 1, CODEC_DECIMAL, done_us);
+    } else if (is_command(command, size, "TX", 1, CODEC_DECIMAL, &value)) {
+        valid = value <= 1;
+        sim->ptt = valid ? value == 1 : sim->ptt;
+    } else if (is_command(command, size, "IF", 0, CODEC_DECIMAL, &value)) {
+        send_information(sim, done_us);
+    } else if (is_command(command, size, "MR", 3, CODEC_DECIMAL, &value)) {
+        valid = value >= 1 && value <= RADIO_SIM_MEMORY_CHANNELS && sim->programmed[value - 1];
+        if (valid) {
+            send_memory(sim, value, done_us);
+        }
+    } else if (codec_text_has_prefix(command, size, "MW")) {
+        valid = write_memory(sim, command, size);
+    } else if (is_command(command, size, "AI", 0, CODEC_DECIMAL, &value)) {
+        send_field(sim, "AI", sim->auto_info ? 1 : 0, 1, CODEC_DECIMAL, done_us);
+    } else if (is_command(command, size, "AI", 1, CODEC_DECIMAL, &value)) {
+        valid = value <= 1;
+        sim->auto_info = valid ? value == 1 : sim->auto_info;
+    } else {
+        valid = false;
+    }
+
+    if (valid) {
+        sim->stats.commands++;
+    } else {
+        sim->stats.rejected++;
+        send_reply(sim, (const uint8_t *)"?;", 2, done_us);
+    }
+}
+
+static void receive_byte(radio_sim_t *sim, uint8_t value, int64_t done_us) {
+    if (sim->config.protocol == RADIO_SIM_FT857D) {
+        sim->command[sim->command_size++] = value;
+        if (sim->command_size == FT857D_COMMAND_SIZE) {
+            run_ft857d_command(sim, done_us);
+            sim->command_size = 0;
+        }
+        return;
+    }
+
+    if (sim->command_size < RADIO_SIM_COMMAND_MAX_SIZE) {
+        sim->command[sim->command_size++] = value;
+    } else {
+        sim->command_overflow = true;
+    }
+    if (value == ';') {
+        if (sim->command_overflow) {
+            sim->stats.rejected++;
+            send_reply(sim, (const uint8_t *)"?;", 2, done_us);
+        } else {
+            run_ft991a_command(sim, done_us);
+        }
+        sim->command_size = 0;
+        sim->command_overflow = false;
+    }
+}
+
+void radio_sim_init(radio_sim_t *sim, const radio_sim_config_t *config) {
+    memset(sim, 0, sizeof(*sim));
+    sim->config = *config;
+    sim->random = config->seed;
+    sim->frequency = 7030000;
+    sim->mode = config->protocol == RADIO_SIM_FT857D ? 0x02 : 0x3; // CW
+    sim->power = 50;
+
+    if (config->protocol == RADIO_SIM_FT991A) {
+        for (uint32_t channel = 1; channel <= FT991A_PRESET_CHANNELS; channel++) {
+            program_memory(sim, channel, 7000000 + channel * 1000, 0x3);
+        }
+    }
+}
+
+void radio_sim_write(radio_sim_t *sim, const uint8_t *data, size_t size, uint32_t baud_rate, int64_t now_us) {
+    int64_t byte_us = byte_time_us(baud_rate);
+    int64_t done_us = later(now_us, sim->rx_done_us);
+
+    for (size_t i = 0; i < size; i++) {
+        done_us += byte_us;
+        if (baud_rate != sim->config.baud_rate) {
+            // Noise to the radio; whatever command was partly received is lost
+            sim->stats.garbled++;
+            sim->command_size = 0;
+            sim->command_overflow = false;
+        } else {
+            receive_byte(sim, data[i], done_us);
+        }
+    }
+    sim->rx_done_us = done_us;
+}
+
+size_t radio_sim_read(radio_sim_t *sim, uint8_t *buffer, size_t size, int64_t now_us) {
+    size_t n = 0;
+
+    while (n < size && sim->count > 0 && sim->due_us[sim->head] <= now_us) {
+        buffer[n++] = sim->queue[sim->head];
+        sim->head = (sim->head + 1) % RADIO_SIM_QUEUE_SIZE;
+        sim->count--;
+    }
+    return n;
+}
+
+int64_t radio_sim_burst_due_us(const radio_sim_t *sim) {
+    if (sim->count == 0) {
+        return -1;
+    }
+
+    // A gap of up to one lost byte still counts as the same burst
+    int64_t gap_us = 2 * byte_time_us(sim->config.baud_rate);
+    int64_t due_us = sim->due_us[sim->head];
+    for (size_t i = 1; i < sim->count; i++) {
+        int64_t next_us = sim->due_us[(sim->head + i) % RADIO_SIM_QUEUE_SIZE];
+        if (next_us - due_us > gap_us) {
+            break;
+        }
+        due_us = next_us;
+    }
+    return due_us;
+}
+
+int64_t radio_sim_write_done_us(const radio_sim_t *sim) {
+    return sim->rx_done_us;
+}
+
+void radio_sim_flush(radio_sim_t *sim, int64_t now_us) {
+    while (sim->count > 0 && sim->due_us[sim->head] <= now_us) {
+        sim->head = (sim->head + 1) % RADIO_SIM_QUEUE_SIZE;
+        sim->count--;
+    }
+}
+
+void radio_sim_tune(radio_sim_t *sim, uint32_t frequency, int64_t now_us) {
+    sim->frequency = frequency;
+    if (sim->config.protocol == RADIO_SIM_FT991A && sim->auto_info) {
+        send_field(sim, "FA", frequency, 9, CODEC_DECIMAL, now_us);
+        sim->stats.pushes++;
+    }
+}
+
+void radio_sim_get_stats(const radio_sim_t *sim, radio_sim_stats_t *stats) {
+    *stats = sim->stats;
+}
@@ -0,0 +1,96 @@
+#ifndef RADIO_SIM_H
+#define RADIO_SIM_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// A radio on the far end of a serial line, byte by byte: the FT-857D 5-byte binary
+// protocol or the FT-991A text protocol. Bytes take 10 bit times each way at the line
+// rate, the radio answers after a fixed latency, and reply bytes can be dropped at
+// random. Bytes sent at a rate other than the radio's are garbled and ignored.
+//
+// Plain C with the time passed in by the caller, so it runs the same on the keyer
+// (see cat_sim.c) and on a Linux host. Nothing here blocks or allocates.
+
+#define RADIO_SIM_COMMAND_MAX_SIZE 48
+#define RADIO_SIM_QUEUE_SIZE 256 // Reply bytes in flight
+#define RADIO_SIM_MEMORY_CHANNELS 117 // FT-991A: 1-99 and the PMS pairs
+#define RADIO_SIM_MEMORY_SIZE 22      // MR/MW fields after the channel number, without ';'
+
+typedef enum {
+    RADIO_SIM_FT857D,
+    RADIO_SIM_FT991A,
+} radio_sim_protocol_t;
+
+typedef struct {
+    radio_sim_protocol_t protocol;
+    uint32_t baud_rate;
+    uint32_t latency_us;     // From the last byte of a command to the first of its reply
+    uint32_t drop_per_mille; // Chance of losing each reply byte
+    uint32_t seed;           // Drops repeat exactly for the same seed
+} radio_sim_config_t;
+
+typedef struct {
+    uint32_t commands;  // Commands the radio understood
+    uint32_t rejected;  // Commands answered with "?;" (FT-991A) or ignored (FT-857D)
+    uint32_t garbled;   // Bytes received at the wrong baud rate
+    uint32_t tx_bytes;  // Bytes the radio sent
+    uint32_t dropped;   // Sent bytes lost on the line, or with the queue full
+    uint32_t pushes;    // Auto Information frames
+} radio_sim_stats_t;
+
+typedef struct {
+    radio_sim_config_t config;
+
+    // What the front panel shows. Modes are the protocol's own codes.
+    uint32_t frequency;
+    uint8_t mode;
+    uint8_t power;
+    bool ptt;
+    bool auto_info;
+
+    // FT-991A memory channels as MW sent them
+    char memory[RADIO_SIM_MEMORY_CHANNELS][RADIO_SIM_MEMORY_SIZE];
+    bool programmed[RADIO_SIM_MEMORY_CHANNELS];
+
+    uint8_t command[RADIO_SIM_COMMAND_MAX_SIZE];
+    size_t command_size;
+    bool command_overflow;
+    int64_t rx_done_us; // When the last byte written so far reaches the radio
+
+    // Reply bytes in order, each with the time it reaches the keyer
+    uint8_t queue[RADIO_SIM_QUEUE_SIZE];
+    int64_t due_us[RADIO_SIM_QUEUE_SIZE];
+    size_t head;
+    size_t count;
+    int64_t tx_done_us; // When the radio's transmitter is free
+
+    uint32_t random;
+    radio_sim_stats_t stats;
+} radio_sim_t;
+
+void radio_sim_init(radio_sim_t *sim, const radio_sim_config_t *config);
+
+// Bytes sent by the keyer at `baud_rate`, starting at `now_us`
+void radio_sim_write(radio_sim_t *sim, const uint8_t *data, size_t size, uint32_t baud_rate, int64_t now_us);
+
+// Take the reply bytes that have arrived by `now_us`; returns how many
+size_t radio_sim_read(radio_sim_t *sim, uint8_t *buffer, size_t size, int64_t now_us);
+
+// When the reply bytes now on their way back to back have all arrived, as a UART hands
+// a burst over in one piece; -1 if none are on their way
+int64_t radio_sim_burst_due_us(const radio_sim_t *sim);
+
+// When the keyer's bytes written so far have all reached the radio
+int64_t radio_sim_write_done_us(const radio_sim_t *sim);
+
+// Drop reply bytes that have arrived but not been read, as uart_flush_input() does
+void radio_sim_flush(radio_sim_t *sim, int64_t now_us);
+
+// The operator turns the VFO. An FT-991A with Auto Information on reports it.
+void radio_sim_tune(radio_sim_t *sim, uint32_t frequency, int64_t now_us);
+
+void radio_sim_get_stats(const radio_sim_t *sim, radio_sim_stats_t *stats);
+
+#endif // RADIO_SIM_H
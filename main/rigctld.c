@@ -0,0 +1,518 @@
+#include "rigctld.h"
+#include "cat.h"
+#include "esp_log.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "lwip/sockets.h"
+#include "ptt.h"
+#include "radio.h"
+#include "radio_cache.h"
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static const char *TAG = "RIGCTLD";
+
+// Each connection has its own task and CAT client, so a program waiting on the radio
+// holds up only itself, and the CAT task takes the programs' requests in turn. Reads are
+// answered from the radio cache, so programs polling the same value share one CAT read
+// per TTL.
+
+#define LINE_SIZE 64
+#define REPLY_SIZE 48
+#define NAME_SIZE 12
+
+// Hamlib error codes for "RPRT n"
+#define RIG_OK 0
+#define RIG_EINVAL -1
+#define RIG_ENIMPL -4
+#define RIG_EIO -6
+
+// Answer to \dump_state, protocol version 0: what netrigctl needs to open the radio.
+// One receive and one transmit range covering HF to 70 cm, 10 Hz tuning steps, the
+// usual filter widths and RF power as the only level. Mode mask 0x18af is AM, CW, USB,
+// LSB, FM, CWR, PKTUSB and PKTFM.
+static const char dump_state[] =
+    "0\n"  // Protocol version
+    "2\n"  // Model: NET rigctl
+    "2\n"  // ITU region
+    "30000.000000 470000000.000000 0x18af -1 -1 0x3 0x1\n"
+    "0 0 0 0 0 0 0\n"
+    "1800000.000000 450000000.000000 0x18af 5000 100000 0x3 0x1\n"
+    "0 0 0 0 0 0 0\n"
+    "0x18af 10\n"
+    "0 0\n"
+    "0xc 2400\n"   // SSB
+    "0x82 500\n"   // CW
+    "0x1 6000\n"   // AM
+    "0x1020 12000\n" // FM and packet
+    "0x800 3000\n" // Digital
+    "0 0\n"
+    "9999\n"  // Max RIT
+    "9999\n"  // Max XIT
+    "0\n"     // Max IF shift
+    "0\n"     // Announces
+    "\n"      // Preamps
+    "\n"      // Attenuators
+    "0x0\n"   // Get functions
+    "0x0\n"   // Set functions
+    "0x1000\n" // Get levels: RFPOWER
+    "0x1000\n" // Set levels: RFPOWER
+    "0x0\n"   // Get parameters
+    "0x0\n";  // Set parameters
+
+// Hamlib mode names for the keyer's. A read reports the first match of the radio's
+// mode; a write uses the first match of the Hamlib name.
+static const struct {
+    const char *hamlib;
+    const char *keyer;
+} modes[] = {
+    {"LSB", "LSB"},
+    {"USB", "USB"},
+    {"CW", "CW"},
+    {"CWR", "CWR"},
+    {"AM", "AM"},
+    {"FM", "FM"},
+    {"FM", "FMN"},
+    {"PKTUSB", "DIG"},
+    {"PKTUSB", "DIGN"},
+    {"PKTFM", "PKT"},
+    {"PKTFM", "PKTN"},
+};
+#define MODE_COUNT (sizeof(modes) / sizeof(modes[0]))
+
+typedef struct {
+    int sock; // -1 when the slot is free
+    TaskHandle_t task;
+    char name[NAME_SIZE]; // Its CAT client's
+    char line[LINE_SIZE];
+    size_t length;
+    bool overflow; // Dropping the rest of a line that did not fit
+} connection_t;
+
+// Covers the slots' sockets, which the listener hands out and the connection tasks give
+// back, and the statistics
+static portMUX_TYPE rigctld_lock = portMUX_INITIALIZER_UNLOCKED;
+static connection_t connections[RIGCTLD_MAX_CONNECTIONS];
+static rigctld_stats_t stats;
+
+static void count(uint32_t *counter) {
+    portENTER_CRITICAL(&rigctld_lock);
+    (*counter)++;
+    portEXIT_CRITICAL(&rigctld_lock);
+}
+
+static void send_all(int sock, const char *data, size_t length) {
+    while (length > 0) {
+        int sent = send(sock, data, length, 0);
+        if (sent <= 0) {
+            ESP_LOGW(TAG, "Failed to send reply (errno %d)", errno);
+            return; // The next recv() finds the connection closed
+        }
+        data += sent;
+        length -= sent;
+    }
+}
+
+static void send_text(int sock, const char *text) {
+    send_all(sock, text, strlen(text));
+}
+
+static int handle_get_freq(int sock, char *args) {
+    uint32_t frequency;
+    char reply[REPLY_SIZE];
+
+    if (radio_cache_get_frequency(&frequency) != ESP_OK) {
+        return RIG_EIO;
+    }
+    snprintf(reply, sizeof(reply), "%lu\n", frequency);
+    send_text(sock, reply);
+    return RIG_OK;
+}
+
+static int handle_set_freq(int sock, char *args) {
+    char *end;
+    double frequency = strtod(args, &end);
+
+    if (end == args || frequency < 0 || frequency > UINT32_MAX) {
+        return RIG_EINVAL;
+    }
+    return radio_cache_set_frequency((uint32_t)(frequency + 0.5)) == ESP_OK ? RIG_OK : RIG_EIO;
+}
+
+static int handle_get_mode(int sock, char *args) {
+    uint8_t mode;
+    char reply[REPLY_SIZE];
+
+    if (radio_cache_get_mode(&mode) != ESP_OK) {
+        return RIG_EIO;
+    }
+
+    const char *name = mode_to_string(mode);
+    const char *hamlib = NULL;
+    for (size_t i = 0; i < MODE_COUNT && hamlib == NULL; i++) {
+        if (strcmp(modes[i].keyer, name) == 0) {
+            hamlib = modes[i].hamlib;
+        }
+    }
+    if (hamlib == NULL) {
+        ESP_LOGW(TAG, "No Hamlib mode for %s", name);
+        return RIG_EIO;
+    }
+
+    snprintf(reply, sizeof(reply), "%s\n0\n", hamlib); // Passband 0: the radio's default
+    send_text(sock, reply);
+    return RIG_OK;
+}
+
+// "M <mode> <passband>"; the passband is left to the radio
+static int handle_set_mode(int sock, char *args) {
+    char *save;
+    char *name = strtok_r(args, " ", &save);
+
+    if (name == NULL) {
+        return RIG_EINVAL;
+    }
+    for (size_t i = 0; i < MODE_COUNT; i++) {
+        if (strcmp(modes[i].hamlib, name) == 0) {
+            uint8_t mode = string_to_mode(modes[i].keyer);
+            if (mode == 0xFF) {
+                continue; // Not a mode this radio has
+            }
+            return radio_cache_set_mode(mode) == ESP_OK ? RIG_OK : RIG_EIO;
+        }
+    }
+    return RIG_EINVAL;
+}
+
+// PTT as the sequencer holds it, for the keyer as well as for programs
+static int handle_get_ptt(int sock, char *args) {
+    ptt_status_t status;
+
+    ptt_get_status(&status);
+    send_text(sock, status.held ? "1\n" : "0\n");
+    return RIG_OK;
+}
+
+// "T <0|1|2|3>": any transmit variant asks the PTT sequencer, which keys the radio by CAT
+// after the lead-in. Receive only lets go: PTT stays on while the keyer is sending.
+static int handle_set_ptt(int sock, char *args) {
+    char *end;
+    long ptt = strtol(args, &end, 10);
+
+    if (end == args || ptt < 0 || ptt > 3) {
+        return RIG_EINVAL;
+    }
+    if (ptt == 0) {
+        ptt_end(PTT_SOURCE_CAT);
+        return RIG_OK;
+    }
+    return ptt_begin(PTT_SOURCE_CAT) == ESP_OK ? RIG_OK : RIG_EIO;
+}
+
+static int handle_get_level(int sock, char *args) {
+    uint8_t power;
+    char reply[REPLY_SIZE];
+    char *save;
+    char *name = strtok_r(args, " ", &save);
+
+    if (name == NULL || strcmp(name, "RFPOWER") != 0) {
+        return RIG_EINVAL;
+    }
+    if (radio_cache_get_power(&power) != ESP_OK) {
+        return RIG_EIO;
+    }
+    snprintf(reply, sizeof(reply), "%f\n", power / 100.0);
+    send_text(sock, reply);
+    return RIG_OK;
+}
+
+// "L RFPOWER <0.0..1.0>"
+static int handle_set_level(int sock, char *args) {
+    char *save;
+    char *name = strtok_r(args, " ", &save);
+    char *value = strtok_r(NULL, " ", &save);
+    char *end;
+
+    if (name == NULL || strcmp(name, "RFPOWER") != 0 || value == NULL) {
+        return RIG_EINVAL;
+    }
+    double level = strtod(value, &end);
+    if (end == value || level < 0 || level > 1) {
+        return RIG_EINVAL;
+    }
+    return radio_cache_set_power((uint8_t)(level * 100 + 0.5)) == ESP_OK ? RIG_OK : RIG_EIO;
+}
+
+// There is one VFO as far as the keyer is concerned
+static int handle_get_vfo(int sock, char *args) {
+    send_text(sock, "VFOA\n");
+    return RIG_OK;
+}
+
+static int handle_set_vfo(int sock, char *args) {
+    return RIG_OK;
+}
+
+static int handle_get_split_vfo(int sock, char *args) {
+    send_text(sock, "0\nVFOA\n");
+    return RIG_OK;
+}
+
+// 0: commands carry no VFO argument
+static int handle_chk_vfo(int sock, char *args) {
+    send_text(sock, "0\n");
+    return RIG_OK;
+}
+
+static int handle_get_powerstat(int sock, char *args) {
+    send_text(sock, "1\n");
+    return RIG_OK;
+}
+
+static int handle_dump_state(int sock, char *args) {
+    send_all(sock, dump_state, sizeof(dump_state) - 1);
+    return RIG_OK;
+}
+
+// Commands by their one-letter and long names. Set commands answer "RPRT 0" on success;
+// get commands answer with their values. Both answer "RPRT <error>" on failure.
+static const struct {
+    char short_name;
+    const char *long_name;
+    bool set;
+    int (*handler)(int sock, char *args);
+} commands[] = {
+    {'f', "get_freq", false, handle_get_freq},
+    {'F', "set_freq", true, handle_set_freq},
+    {'m', "get_mode", false, handle_get_mode},
+    {'M', "set_mode", true, handle_set_mode},
+    {'t', "get_ptt", false, handle_get_ptt},
+    {'T', "set_ptt", true, handle_set_ptt},
+    {'l', "get_level", false, handle_get_level},
+    {'L', "set_level", true, handle_set_level},
+    {'v', "get_vfo", false, handle_get_vfo},
+    {'V', "set_vfo", true, handle_set_vfo},
+    {'s', "get_split_vfo", false, handle_get_split_vfo},
+    {0, "chk_vfo", false, handle_chk_vfo},
+    {0, "get_powerstat", false, handle_get_powerstat},
+    {0, "dump_state", false, handle_dump_state},
+};
+#define COMMAND_COUNT (sizeof(commands) / sizeof(commands[0]))
+
+// Close the socket and give the slot back to the listener
+static void close_connection(connection_t *connection) {
+    close(connection->sock);
+    portENTER_CRITICAL(&rigctld_lock);
+    connection->sock = -1;
+    stats.connections--;
+    portEXIT_CRITICAL(&rigctld_lock);
+    ESP_LOGI(TAG, "Client disconnected");
+}
+
+// Run one command line; false when the client asked to quit
+static bool run_command(connection_t *connection, char *line) {
+    char *name = line;
+    char *args;
+    int index = -1;
+    int result = RIG_ENIMPL;
+
+    while (*name == ' ') {
+        name++;
+    }
+    if (*name == '\0') {
+        return true;
+    }
+
+    if (*name == '\\') {
+        name++;
+        args = strchr(name, ' ');
+        if (args != NULL) {
+            *args++ = '\0';
+        } else {
+            args = name + strlen(name);
+        }
+        if (strcmp(name, "quit") == 0) {
+            return false;
+        }
+        for (int i = 0; i < COMMAND_COUNT; i++) {
+            if (strcmp(commands[i].long_name, name) == 0) {
+                index = i;
+            }
+        }
+    } else {
+        if (*name == 'q' || *name == 'Q') {
+            return false;
+        }
+        for (int i = 0; i < COMMAND_COUNT; i++) {
+            if (commands[i].short_name == *name) {
+                index = i;
+            }
+        }
+        args = name + 1;
+    }
+    while (*args == ' ') {
+        args++;
+    }
+
+    count(&stats.commands);
+    if (index >= 0) {
+        result = commands[index].handler(connection->sock, args);
+    } else {
+        ESP_LOGD(TAG, "Unsupported command: %s", name);
+    }
+
+    if (result != RIG_OK || commands[index].set) { // index is valid whenever result is RIG_OK
+        char reply[REPLY_SIZE];
+        snprintf(reply, sizeof(reply), "RPRT %d\n", result);
+        send_text(connection->sock, reply);
+    }
+    if (result != RIG_OK) {
+        count(&stats.errors);
+    }
+    return true;
+}
+
+// Wait for what the client sends and run each complete line; false once the client has
+// closed the connection or asked to quit
+static bool receive(connection_t *connection) {
+    char data[LINE_SIZE];
+    int received = recv(connection->sock, data, sizeof(data), 0);
+
+    if (received <= 0) {
+        return false;
+    }
+
+    for (int i = 0; i < received; i++) {
+        char c = data[i];
+        if (c == '\n') {
+            if (connection->overflow) {
+                connection->overflow = false;
+                send_text(connection->sock, "RPRT -1\n");
+                count(&stats.errors);
+            } else {
+                connection->line[connection->length] = '\0';
+                if (!run_command(connection, connection->line)) {
+                    return false;
+                }
+            }
+            connection->length = 0;
+        } else if (c == '\r' || connection->overflow) {
+            continue;
+        } else if (connection->length < LINE_SIZE - 1) {
+            connection->line[connection->length++] = c;
+        } else {
+            connection->overflow = true;
+            connection->length = 0;
+        }
+    }
+    return true;
+}
+
+// Serves one connection at a time, handed over by the listener
+static void connection_task(void *arg) {
+    connection_t *connection = arg;
+
+    cat_register_client(connection->name, CAT_PRIORITY_NORMAL);
+
+    while (1) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        connection->length = 0;
+        connection->overflow = false;
+        while (receive(connection)) {
+        }
+        close_connection(connection);
+    }
+}
+
+static void accept_connection(int listen_sock) {
+    int sock = accept(listen_sock, NULL, NULL);
+    if (sock < 0) {
+        ESP_LOGW(TAG, "Failed to accept connection (errno %d)", errno);
+        return;
+    }
+
+    connection_t *connection = NULL;
+    uint32_t open;
+    portENTER_CRITICAL(&rigctld_lock);
+    for (int i = 0; i < RIGCTLD_MAX_CONNECTIONS && connection == NULL; i++) {
+        if (connections[i].sock < 0) {
+            connection = &connections[i];
+            connection->sock = sock;
+            stats.connections++;
+            stats.accepted++;
+        }
+    }
+    if (connection == NULL) {
+        stats.rejected++;
+    }
+    open = stats.connections;
+    portEXIT_CRITICAL(&rigctld_lock);
+
+    if (connection == NULL) {
+        ESP_LOGW(TAG, "Too many rigctld clients, closing connection");
+        close(sock);
+        return;
+    }
+
+    int nodelay = 1; // Replies are single short lines; send them at once
+    setsockopt(sock, IPPROTO_TCP, TCP_NODELAY, &nodelay, sizeof(nodelay));
+    ESP_LOGI(TAG, "Client connected (%lu open)", open);
+    xTaskNotifyGive(connection->task);
+}
+
+static void listen_task(void *arg) {
+    int listen_sock = (intptr_t)arg;
+
+    while (1) {
+        accept_connection(listen_sock);
+    }
+}
+
+esp_err_t rigctld_init(void) {
+    int listen_sock = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    if (listen_sock < 0) {
+        ESP_LOGE(TAG, "Failed to create socket (errno %d)", errno);
+        return ESP_FAIL;
+    }
+
+    int reuse = 1;
+    setsockopt(listen_sock, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+
+    struct sockaddr_in address = {
+        .sin_family = AF_INET,
+        .sin_port = htons(RIGCTLD_PORT),
+        .sin_addr.s_addr = htonl(INADDR_ANY),
+    };
+    if (bind(listen_sock, (struct sockaddr *)&address, sizeof(address)) != 0 ||
+        listen(listen_sock, 2) != 0) {
+        ESP_LOGE(TAG, "Failed to listen on port %d (errno %d)", RIGCTLD_PORT, errno);
+        close(listen_sock);
+        return ESP_FAIL;
+    }
+
+    for (int i = 0; i < RIGCTLD_MAX_CONNECTIONS; i++) {
+        connections[i].sock = -1;
+        snprintf(connections[i].name, NAME_SIZE, "rigctld %d", i + 1);
+        if (xTaskCreate(connection_task, "rigctld_conn", 3072, &connections[i], 4, &connections[i].task) != pdPASS) {
+            ESP_LOGE(TAG, "Failed to create rigctld connection task");
+            close(listen_sock);
+            return ESP_FAIL;
+        }
+    }
+    if (xTaskCreate(listen_task, "rigctld_task", 2048, (void *)(intptr_t)listen_sock, 4, NULL) != pdPASS) {
+        ESP_LOGE(TAG, "Failed to create rigctld task");
+        close(listen_sock);
+        return ESP_FAIL;
+    }
+
+    ESP_LOGI(TAG, "rigctld server listening on port %d", RIGCTLD_PORT);
+    return ESP_OK;
+}
+
+void rigctld_get_stats(rigctld_stats_t *out) {
+    portENTER_CRITICAL(&rigctld_lock);
+    *out = stats;
+    portEXIT_CRITICAL(&rigctld_lock);
+}
@@ -0,0 +1,23 @@
+#ifndef RIGCTLD_H
+#define RIGCTLD_H
+
+#include "esp_err.h"
+#include <stdint.h>
+
+// Hamlib rigctld protocol server, so logging and digital mode programs on the network
+// can use the radio through the keyer's CAT port (model 2, "NET rigctl")
+#define RIGCTLD_PORT 4532
+#define RIGCTLD_MAX_CONNECTIONS 4 // Each a task and a CAT client
+
+typedef struct {
+    uint32_t connections; // Open now
+    uint32_t accepted;
+    uint32_t rejected; // Turned away when all connections were in use
+    uint32_t commands;
+    uint32_t errors; // Commands answered with a negative RPRT
+} rigctld_stats_t;
+
+esp_err_t rigctld_init(void);
+void rigctld_get_stats(rigctld_stats_t *stats);
+
+#endif // RIGCTLD_H
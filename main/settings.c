@@ -1,9 +1,14 @@
 #include "cJSON.h"
+#include "cat.h"
 #include "config.h"
 #include "esp_log.h"
 #include "http.h"
+#include "paddle.h"
+#include "ptt.h"
+#include "sidetone.h"
 #include "nvs_flash.h"
 #include "status.h"
+#include "timing.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -11,13 +16,25 @@
 static const char *TAG = "SETTINGS";
 
 int wpm = 20;
+int farnsworth_wpm = 0; // 0 disables Farnsworth spacing
+int dah_ratio = DAH_RATIO_DEFAULT;
+int weight = WEIGHT_DEFAULT;
+char my_call[16] = "";
+int iambic_mode = IAMBIC_B;
+int sidetone_pitch = SIDETONE_PITCH_DEFAULT;
+int sidetone_volume = SIDETONE_VOLUME_DEFAULT;
+int paddle_memory = 1; // Latch paddle presses made while an element is being sent
+int ptt_enabled = 0;   // Off by default: the radio's own break-in keys the transmitter
+int ptt_lead_ms = PTT_LEAD_DEFAULT_MS;
+int ptt_tail_ms = PTT_TAIL_DEFAULT_MS;
+int ptt_hang_ms = PTT_HANG_DEFAULT_MS;
 char ap_ssid[32] = "cw_keyer";
 char ap_password[64] = "";
 char sta_ssid[32] = "";
 char sta_password[64] = "";
 int tune_power = 5;
 
-#ifdef CONFIG_RADIO_FT857D
+#ifdef CONFIG_RADIO_PROTOCOL_FT857D
 #define DEFAULT_BAUD_RATE 4800
 #endif
 #ifndef DEFAULT_BAUD_RATE
@@ -38,6 +55,114 @@ void load_settings(void) {
         ESP_LOGI(TAG, "Default WPM saved to NVS: %d", wpm);
     }
 
+    if (get_u8("farnsworth_wpm", &u8_v) == ESP_OK) {
+        ESP_LOGI(TAG, "Loaded Farnsworth WPM from NVS: %d", u8_v);
+        farnsworth_wpm = (int)u8_v;
+    } else {
+        ESP_LOGW(TAG, "Failed to load Farnsworth WPM from NVS, using default: %d", farnsworth_wpm);
+        set_u8("farnsworth_wpm", (uint8_t)farnsworth_wpm);
+        ESP_LOGI(TAG, "Default Farnsworth WPM saved to NVS: %d", farnsworth_wpm);
+    }
+
+    if (get_u8("dah_ratio", &u8_v) == ESP_OK) {
+        ESP_LOGI(TAG, "Loaded dah ratio from NVS: %d", u8_v);
+        dah_ratio = (int)u8_v;
+    } else {
+        ESP_LOGW(TAG, "Failed to load dah ratio from NVS, using default: %d", dah_ratio);
+        set_u8("dah_ratio", (uint8_t)dah_ratio);
+        ESP_LOGI(TAG, "Default dah ratio saved to NVS: %d", dah_ratio);
+    }
+
+    if (get_u8("weight", &u8_v) == ESP_OK) {
+        ESP_LOGI(TAG, "Loaded weight from NVS: %d", u8_v);
+        weight = (int)u8_v;
+    } else {
+        ESP_LOGW(TAG, "Failed to load weight from NVS, using default: %d", weight);
+        set_u8("weight", (uint8_t)weight);
+        ESP_LOGI(TAG, "Default weight saved to NVS: %d", weight);
+    }
+
+    uint32_t u32_v;
+    if (get_u32("sidetone_pitch", &u32_v) == ESP_OK) {
+        ESP_LOGI(TAG, "Loaded sidetone pitch from NVS: %ld", u32_v);
+        sidetone_pitch = (int)u32_v;
+    } else {
+        ESP_LOGW(TAG, "Failed to load sidetone pitch from NVS, using default: %d", sidetone_pitch);
+        set_u32("sidetone_pitch", (uint32_t)sidetone_pitch);
+        ESP_LOGI(TAG, "Default sidetone pitch saved to NVS: %d", sidetone_pitch);
+    }
+
+    if (get_u8("sidetone_volume", &u8_v) == ESP_OK) {
+        ESP_LOGI(TAG, "Loaded sidetone volume from NVS: %d", u8_v);
+        sidetone_volume = (int)u8_v;
+    } else {
+        ESP_LOGW(TAG, "Failed to load sidetone volume from NVS, using default: %d", sidetone_volume);
+        set_u8("sidetone_volume", (uint8_t)sidetone_volume);
+        ESP_LOGI(TAG, "Default sidetone volume saved to NVS: %d", sidetone_volume);
+    }
+
+    if (get_u8("iambic_mode", &u8_v) == ESP_OK) {
+        ESP_LOGI(TAG, "Loaded iambic mode from NVS: %d", u8_v);
+        iambic_mode = (int)u8_v;
+    } else {
+        ESP_LOGW(TAG, "Failed to load iambic mode from NVS, using default: %d", iambic_mode);
+        set_u8("iambic_mode", (uint8_t)iambic_mode);
+        ESP_LOGI(TAG, "Default iambic mode saved to NVS: %d", iambic_mode);
+    }
+
+    if (get_u8("paddle_memory", &u8_v) == ESP_OK) {
+        ESP_LOGI(TAG, "Loaded paddle memory from NVS: %d", u8_v);
+        paddle_memory = (int)u8_v;
+    } else {
+        ESP_LOGW(TAG, "Failed to load paddle memory from NVS, using default: %d", paddle_memory);
+        set_u8("paddle_memory", (uint8_t)paddle_memory);
+        ESP_LOGI(TAG, "Default paddle memory saved to NVS: %d", paddle_memory);
+    }
+
+    if (get_u8("ptt_enabled", &u8_v) == ESP_OK) {
+        ESP_LOGI(TAG, "Loaded PTT enabled from NVS: %d", u8_v);
+        ptt_enabled = (int)u8_v;
+    } else {
+        ESP_LOGW(TAG, "Failed to load PTT enabled from NVS, using default: %d", ptt_enabled);
+        set_u8("ptt_enabled", (uint8_t)ptt_enabled);
+        ESP_LOGI(TAG, "Default PTT enabled saved to NVS: %d", ptt_enabled);
+    }
+
+    if (get_u32("ptt_lead_ms", &u32_v) == ESP_OK) {
+        ESP_LOGI(TAG, "Loaded PTT lead from NVS: %ld ms", u32_v);
+        ptt_lead_ms = (int)u32_v;
+    } else {
+        ESP_LOGW(TAG, "Failed to load PTT lead from NVS, using default: %d ms", ptt_lead_ms);
+        set_u32("ptt_lead_ms", (uint32_t)ptt_lead_ms);
+        ESP_LOGI(TAG, "Default PTT lead saved to NVS: %d ms", ptt_lead_ms);
+    }
+
+    if (get_u32("ptt_tail_ms", &u32_v) == ESP_OK) {
+        ESP_LOGI(TAG, "Loaded PTT tail from NVS: %ld ms", u32_v);
+        ptt_tail_ms = (int)u32_v;
+    } else {
+        ESP_LOGW(TAG, "Failed to load PTT tail from NVS, using default: %d ms", ptt_tail_ms);
+        set_u32("ptt_tail_ms", (uint32_t)ptt_tail_ms);
+        ESP_LOGI(TAG, "Default PTT tail saved to NVS: %d ms", ptt_tail_ms);
+    }
+
+    if (get_u32("ptt_hang_ms", &u32_v) == ESP_OK) {
+        ESP_LOGI(TAG, "Loaded PTT hang from NVS: %ld ms", u32_v);
+        ptt_hang_ms = (int)u32_v;
+    } else {
+        ESP_LOGW(TAG, "Failed to load PTT hang from NVS, using default: %d ms", ptt_hang_ms);
+        set_u32("ptt_hang_ms", (uint32_t)ptt_hang_ms);
+        ESP_LOGI(TAG, "Default PTT hang saved to NVS: %d ms", ptt_hang_ms);
+    }
+
+    if (get_string("my_call", my_call, sizeof(my_call)) == ESP_OK) {
+        ESP_LOGI(TAG, "Loaded my call from NVS: %s", my_call);
+    } else {
+        ESP_LOGW(TAG, "Failed to load my call from NVS, using default: %s", my_call);
+        set_string("my_call", my_call);
+        ESP_LOGI(TAG, "Default my call saved to NVS: %s", my_call);
+    }
+
     if (get_string("ap_ssid", ap_ssid, sizeof(ap_ssid)) == ESP_OK) {
         ESP_LOGI(TAG, "Loaded AP SSID from NVS: %s", ap_ssid);
     } else {
@@ -70,7 +195,6 @@ void load_settings(void) {
         ESP_LOGI(TAG, "Default STA Password saved to NVS: %s", sta_password);
     }
 
-    uint32_t u32_v;
     if (get_u32("baud_rate", &u32_v) == ESP_OK) {
         ESP_LOGI(TAG, "Loaded baud rate from NVS: %ld", u32_v);
         baud_rate = (int)u32_v;
@@ -90,7 +214,7 @@ void load_settings(void) {
 }
 
 static esp_err_t set_settings_handler(httpd_req_t *req) {
-    char content[256];
+    char content[1024];
     int content_len = httpd_req_recv(req, content, sizeof(content) - 1);
 
     if (content_len <= 0) {
@@ -129,6 +253,193 @@ static esp_err_t set_settings_handler(httpd_req_t *req) {
         ESP_LOGE(TAG, "WPM parameter missing or invalid");
     }
 
+    cJSON *farnsworth_wpm_json = cJSON_GetObjectItem(json, "farnsworth_wpm");
+    if (farnsworth_wpm_json && cJSON_IsNumber(farnsworth_wpm_json)) {
+        int new_farnsworth_wpm = farnsworth_wpm_json->valueint;
+        if (new_farnsworth_wpm != 0 && (new_farnsworth_wpm < 5 || new_farnsworth_wpm >= wpm)) {
+            ESP_LOGE(TAG, "Farnsworth WPM out of range (0 or 5 to WPM-1), disabling");
+            new_farnsworth_wpm = 0;
+        }
+        if (new_farnsworth_wpm != farnsworth_wpm) {
+            farnsworth_wpm = new_farnsworth_wpm;
+            set_u8("farnsworth_wpm", (uint8_t)farnsworth_wpm);
+            ESP_LOGI(TAG, "Farnsworth WPM updated and saved to NVS: %d", farnsworth_wpm);
+        }
+    } else {
+        ESP_LOGE(TAG, "Farnsworth WPM parameter missing or invalid");
+    }
+
+    cJSON *dah_ratio_json = cJSON_GetObjectItem(json, "dah_ratio");
+    if (dah_ratio_json && cJSON_IsNumber(dah_ratio_json)) {
+        int new_dah_ratio = dah_ratio_json->valueint;
+        if (new_dah_ratio < 20 || new_dah_ratio > 50) {
+            ESP_LOGE(TAG, "Dah ratio out of range (20-50), using default: %d", DAH_RATIO_DEFAULT);
+            new_dah_ratio = DAH_RATIO_DEFAULT;
+        }
+        if (new_dah_ratio != dah_ratio) {
+            dah_ratio = new_dah_ratio;
+            set_u8("dah_ratio", (uint8_t)dah_ratio);
+            ESP_LOGI(TAG, "Dah ratio updated and saved to NVS: %d", dah_ratio);
+        }
+    } else {
+        ESP_LOGE(TAG, "Dah ratio parameter missing or invalid");
+    }
+
+    cJSON *weight_json = cJSON_GetObjectItem(json, "weight");
+    if (weight_json && cJSON_IsNumber(weight_json)) {
+        int new_weight = weight_json->valueint;
+        if (new_weight < 25 || new_weight > 75) {
+            ESP_LOGE(TAG, "Weight out of range (25-75), using default: %d", WEIGHT_DEFAULT);
+            new_weight = WEIGHT_DEFAULT;
+        }
+        if (new_weight != weight) {
+            weight = new_weight;
+            set_u8("weight", (uint8_t)weight);
+            ESP_LOGI(TAG, "Weight updated and saved to NVS: %d", weight);
+        }
+    } else {
+        ESP_LOGE(TAG, "Weight parameter missing or invalid");
+    }
+
+    bool sidetone_changed = false;
+    cJSON *sidetone_pitch_json = cJSON_GetObjectItem(json, "sidetone_pitch");
+    if (sidetone_pitch_json && cJSON_IsNumber(sidetone_pitch_json)) {
+        int new_sidetone_pitch = sidetone_pitch_json->valueint;
+        if (new_sidetone_pitch < 300 || new_sidetone_pitch > 1200) {
+            ESP_LOGE(TAG, "Sidetone pitch out of range (300-1200), using default: %d", SIDETONE_PITCH_DEFAULT);
+            new_sidetone_pitch = SIDETONE_PITCH_DEFAULT;
+        }
+        if (new_sidetone_pitch != sidetone_pitch) {
+            sidetone_pitch = new_sidetone_pitch;
+            sidetone_changed = true;
+            set_u32("sidetone_pitch", (uint32_t)sidetone_pitch);
+            ESP_LOGI(TAG, "Sidetone pitch updated and saved to NVS: %d", sidetone_pitch);
+        }
+    } else {
+        ESP_LOGE(TAG, "Sidetone pitch parameter missing or invalid");
+    }
+
+    cJSON *sidetone_volume_json = cJSON_GetObjectItem(json, "sidetone_volume");
+    if (sidetone_volume_json && cJSON_IsNumber(sidetone_volume_json)) {
+        int new_sidetone_volume = sidetone_volume_json->valueint;
+        if (new_sidetone_volume < 0 || new_sidetone_volume > 100) {
+            ESP_LOGE(TAG, "Sidetone volume out of range (0-100), using default: %d", SIDETONE_VOLUME_DEFAULT);
+            new_sidetone_volume = SIDETONE_VOLUME_DEFAULT;
+        }
+        if (new_sidetone_volume != sidetone_volume) {
+            sidetone_volume = new_sidetone_volume;
+            sidetone_changed = true;
+            set_u8("sidetone_volume", (uint8_t)sidetone_volume);
+            ESP_LOGI(TAG, "Sidetone volume updated and saved to NVS: %d", sidetone_volume);
+        }
+    } else {
+        ESP_LOGE(TAG, "Sidetone volume parameter missing or invalid");
+    }
+
+    if (sidetone_changed) {
+        sidetone_configure(sidetone_pitch, sidetone_volume);
+    }
+
+    cJSON *iambic_mode_json = cJSON_GetObjectItem(json, "iambic_mode");
+    if (iambic_mode_json && cJSON_IsNumber(iambic_mode_json)) {
+        int new_iambic_mode = iambic_mode_json->valueint;
+        if (new_iambic_mode != IAMBIC_A && new_iambic_mode != IAMBIC_B) {
+            ESP_LOGE(TAG, "Iambic mode out of range (0 = A, 1 = B), using default: %d", IAMBIC_B);
+            new_iambic_mode = IAMBIC_B;
+        }
+        if (new_iambic_mode != iambic_mode) {
+            iambic_mode = new_iambic_mode;
+            set_u8("iambic_mode", (uint8_t)iambic_mode);
+            ESP_LOGI(TAG, "Iambic mode updated and saved to NVS: %d", iambic_mode);
+        }
+    } else {
+        ESP_LOGE(TAG, "Iambic mode parameter missing or invalid");
+    }
+
+    cJSON *paddle_memory_json = cJSON_GetObjectItem(json, "paddle_memory");
+    if (paddle_memory_json && cJSON_IsBool(paddle_memory_json)) {
+        int new_paddle_memory = cJSON_IsTrue(paddle_memory_json) ? 1 : 0;
+        if (new_paddle_memory != paddle_memory) {
+            paddle_memory = new_paddle_memory;
+            set_u8("paddle_memory", (uint8_t)paddle_memory);
+            ESP_LOGI(TAG, "Paddle memory updated and saved to NVS: %d", paddle_memory);
+        }
+    } else {
+        ESP_LOGE(TAG, "Paddle memory parameter missing or invalid");
+    }
+
+    cJSON *ptt_enabled_json = cJSON_GetObjectItem(json, "ptt_enabled");
+    if (ptt_enabled_json && cJSON_IsBool(ptt_enabled_json)) {
+        int new_ptt_enabled = cJSON_IsTrue(ptt_enabled_json) ? 1 : 0;
+        if (new_ptt_enabled != ptt_enabled) {
+            ptt_enabled = new_ptt_enabled;
+            set_u8("ptt_enabled", (uint8_t)ptt_enabled);
+            ESP_LOGI(TAG, "PTT enabled updated and saved to NVS: %d", ptt_enabled);
+        }
+    } else {
+        ESP_LOGE(TAG, "PTT enabled parameter missing or invalid");
+    }
+
+    cJSON *ptt_lead_ms_json = cJSON_GetObjectItem(json, "ptt_lead_ms");
+    if (ptt_lead_ms_json && cJSON_IsNumber(ptt_lead_ms_json)) {
+        int new_ptt_lead_ms = ptt_lead_ms_json->valueint;
+        if (new_ptt_lead_ms < 0 || new_ptt_lead_ms > 1000) {
+            ESP_LOGE(TAG, "PTT lead out of range (0-1000 ms), using default: %d", PTT_LEAD_DEFAULT_MS);
+            new_ptt_lead_ms = PTT_LEAD_DEFAULT_MS;
+        }
+        if (new_ptt_lead_ms != ptt_lead_ms) {
+            ptt_lead_ms = new_ptt_lead_ms;
+            set_u32("ptt_lead_ms", (uint32_t)ptt_lead_ms);
+            ESP_LOGI(TAG, "PTT lead updated and saved to NVS: %d ms", ptt_lead_ms);
+        }
+    } else {
+        ESP_LOGE(TAG, "PTT lead parameter missing or invalid");
+    }
+
+    cJSON *ptt_tail_ms_json = cJSON_GetObjectItem(json, "ptt_tail_ms");
+    if (ptt_tail_ms_json && cJSON_IsNumber(ptt_tail_ms_json)) {
+        int new_ptt_tail_ms = ptt_tail_ms_json->valueint;
+        if (new_ptt_tail_ms < 0 || new_ptt_tail_ms > 1000) {
+            ESP_LOGE(TAG, "PTT tail out of range (0-1000 ms), using default: %d", PTT_TAIL_DEFAULT_MS);
+            new_ptt_tail_ms = PTT_TAIL_DEFAULT_MS;
+        }
+        if (new_ptt_tail_ms != ptt_tail_ms) {
+            ptt_tail_ms = new_ptt_tail_ms;
+            set_u32("ptt_tail_ms", (uint32_t)ptt_tail_ms);
+            ESP_LOGI(TAG, "PTT tail updated and saved to NVS: %d ms", ptt_tail_ms);
+        }
+    } else {
+        ESP_LOGE(TAG, "PTT tail parameter missing or invalid");
+    }
+
+    cJSON *ptt_hang_ms_json = cJSON_GetObjectItem(json, "ptt_hang_ms");
+    if (ptt_hang_ms_json && cJSON_IsNumber(ptt_hang_ms_json)) {
+        int new_ptt_hang_ms = ptt_hang_ms_json->valueint;
+        if (new_ptt_hang_ms < 0 || new_ptt_hang_ms > 5000) {
+            ESP_LOGE(TAG, "PTT hang out of range (0-5000 ms), using default: %d", PTT_HANG_DEFAULT_MS);
+            new_ptt_hang_ms = PTT_HANG_DEFAULT_MS;
+        }
+        if (new_ptt_hang_ms != ptt_hang_ms) {
+            ptt_hang_ms = new_ptt_hang_ms;
+            set_u32("ptt_hang_ms", (uint32_t)ptt_hang_ms);
+            ESP_LOGI(TAG, "PTT hang updated and saved to NVS: %d ms", ptt_hang_ms);
+        }
+    } else {
+        ESP_LOGE(TAG, "PTT hang parameter missing or invalid");
+    }
+
+    cJSON *my_call_json = cJSON_GetObjectItem(json, "my_call");
+    if (my_call_json && cJSON_IsString(my_call_json)) {
+        if (strcmp(my_call, my_call_json->valuestring) != 0) {
+            strncpy(my_call, my_call_json->valuestring, sizeof(my_call) - 1);
+            my_call[sizeof(my_call) - 1] = '\0';
+            set_string("my_call", my_call);
+            ESP_LOGI(TAG, "My call updated and saved to NVS: %s", my_call);
+        }
+    } else {
+        ESP_LOGE(TAG, "My call parameter missing or invalid");
+    }
+
     cJSON *ap_ssid_json = cJSON_GetObjectItem(json, "ap_ssid");
     if (ap_ssid_json && cJSON_IsString(ap_ssid_json)) {
         if (strcmp(ap_ssid, ap_ssid_json->valuestring) != 0) {
@@ -181,9 +492,13 @@ static esp_err_t set_settings_handler(httpd_req_t *req) {
     if (baud_rate_json && cJSON_IsNumber(baud_rate_json)) {
         int new_baud_rate = baud_rate_json->valueint;
         if (new_baud_rate != baud_rate) {
-            baud_rate = new_baud_rate;
-            set_u32("baud_rate", (uint32_t)baud_rate);
-            ESP_LOGI(TAG, "Baud rate updated and saved to NVS: %d", baud_rate);
+            if (cat_set_baud_rate(new_baud_rate) == ESP_OK) {
+                baud_rate = new_baud_rate;
+                set_u32("baud_rate", (uint32_t)baud_rate);
+                ESP_LOGI(TAG, "Baud rate updated, applied and saved to NVS: %d", baud_rate);
+            } else {
+                ESP_LOGE(TAG, "Unsupported baud rate: %d", new_baud_rate);
+            }
         }
     } else {
         ESP_LOGE(TAG, "Baud rate parameter missing or invalid");
@@ -225,6 +540,18 @@ static esp_err_t get_settings_handler(httpd_req_t *req) {
     }
 
     cJSON_AddNumberToObject(json, "wpm", wpm);
+    cJSON_AddNumberToObject(json, "farnsworth_wpm", farnsworth_wpm);
+    cJSON_AddNumberToObject(json, "dah_ratio", dah_ratio);
+    cJSON_AddNumberToObject(json, "weight", weight);
+    cJSON_AddNumberToObject(json, "sidetone_pitch", sidetone_pitch);
+    cJSON_AddNumberToObject(json, "sidetone_volume", sidetone_volume);
+    cJSON_AddNumberToObject(json, "iambic_mode", iambic_mode);
+    cJSON_AddBoolToObject(json, "paddle_memory", paddle_memory);
+    cJSON_AddBoolToObject(json, "ptt_enabled", ptt_enabled);
+    cJSON_AddNumberToObject(json, "ptt_lead_ms", ptt_lead_ms);
+    cJSON_AddNumberToObject(json, "ptt_tail_ms", ptt_tail_ms);
+    cJSON_AddNumberToObject(json, "ptt_hang_ms", ptt_hang_ms);
+    cJSON_AddStringToObject(json, "my_call", my_call);
     cJSON_AddStringToObject(json, "ap_ssid", ap_ssid);
     cJSON_AddStringToObject(json, "ap_password", ap_password);
     cJSON_AddStringToObject(json, "sta_ssid", sta_ssid);
@@ -2,6 +2,18 @@
 #define SETTINGS_H
 
 extern int wpm;
+extern int farnsworth_wpm;
+extern int dah_ratio;
+extern int weight;
+extern char my_call[16];
+extern int sidetone_pitch;
+extern int sidetone_volume;
+extern int iambic_mode;
+extern int paddle_memory;
+extern int ptt_enabled;
+extern int ptt_lead_ms;
+extern int ptt_tail_ms;
+extern int ptt_hang_ms;
 extern char ap_ssid[32];
 extern char ap_password[64];
 extern char sta_ssid[32];
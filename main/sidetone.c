@@ -0,0 +1,89 @@
+#include "sidetone.h"
+#include "driver/ledc.h"
+#include "esp_log.h"
+#include "freertos/FreeRTOS.h"
+#include "pins.h"
+#include "settings.h"
+
+static const char *TAG = "SIDETONE";
+
+#define SIDETONE_MODE LEDC_LOW_SPEED_MODE
+#define SIDETONE_TIMER LEDC_TIMER_0
+#define SIDETONE_CHANNEL LEDC_CHANNEL_0
+#define SIDETONE_RESOLUTION LEDC_TIMER_10_BIT
+#define SIDETONE_MAX_DUTY (1 << (SIDETONE_RESOLUTION - 1)) // 50% is the loudest square wave
+
+// The LEDC timer runs all the time at the pitch; a key edge only switches the channel's
+// duty between 0 and this, so tone and key change on the same call.
+static uint32_t tone_duty = 0;
+static bool initialized = false;
+
+static uint32_t volume_to_duty(int volume) {
+    return (uint32_t)volume * SIDETONE_MAX_DUTY / 100;
+}
+
+esp_err_t sidetone_init(void) {
+    ledc_timer_config_t timer_config = {
+        .speed_mode = SIDETONE_MODE,
+        .duty_resolution = SIDETONE_RESOLUTION,
+        .timer_num = SIDETONE_TIMER,
+        .freq_hz = sidetone_pitch,
+        .clk_cfg = LEDC_AUTO_CLK,
+    };
+    esp_err_t err = ledc_timer_config(&timer_config);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to configure LEDC timer: %s", esp_err_to_name(err));
+        return err;
+    }
+
+    ledc_channel_config_t channel_config = {
+        .gpio_num = SIDETONE_GPIO_PIN,
+        .speed_mode = SIDETONE_MODE,
+        .channel = SIDETONE_CHANNEL,
+        .intr_type = LEDC_INTR_DISABLE,
+        .timer_sel = SIDETONE_TIMER,
+        .duty = 0,
+        .hpoint = 0,
+    };
+    err = ledc_channel_config(&channel_config);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to configure LEDC channel: %s", esp_err_to_name(err));
+        return err;
+    }
+
+    tone_duty = volume_to_duty(sidetone_volume);
+    initialized = true;
+    ESP_LOGI(TAG, "Sidetone initialized on GPIO %d: %d Hz, volume %d%%", SIDETONE_GPIO_PIN, sidetone_pitch,
+             sidetone_volume);
+    return ESP_OK;
+}
+
+// Apply new settings; takes effect from the next key edge
+esp_err_t sidetone_configure(int pitch, int volume) {
+    if (!initialized) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    esp_err_t err = ledc_set_freq(SIDETONE_MODE, SIDETONE_TIMER, pitch);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to set pitch %d Hz: %s", pitch, esp_err_to_name(err));
+        return err;
+    }
+    tone_duty = volume_to_duty(volume);
+    return ESP_OK;
+}
+
+// Called from the keyer ISR on every key edge, next to key_down()/led_on()
+void IRAM_ATTR sidetone_on(void) {
+    if (initialized) {
+        ledc_set_duty(SIDETONE_MODE, SIDETONE_CHANNEL, tone_duty);
+        ledc_update_duty(SIDETONE_MODE, SIDETONE_CHANNEL);
+    }
+}
+
+void IRAM_ATTR sidetone_off(void) {
+    if (initialized) {
+        ledc_set_duty(SIDETONE_MODE, SIDETONE_CHANNEL, 0);
+        ledc_update_duty(SIDETONE_MODE, SIDETONE_CHANNEL);
+    }
+}
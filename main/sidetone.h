@@ -0,0 +1,14 @@
+#ifndef SIDETONE_H
+#define SIDETONE_H
+
+#include "esp_err.h"
+
+#define SIDETONE_PITCH_DEFAULT 600 // Hz
+#define SIDETONE_VOLUME_DEFAULT 50 // Percent, 0 = off
+
+esp_err_t sidetone_init(void);
+esp_err_t sidetone_configure(int pitch, int volume);
+void sidetone_on(void);
+void sidetone_off(void);
+
+#endif // SIDETONE_H
@@ -1,25 +1,146 @@
+#include "cJSON.h"
+#include "cat.h"
+#include "cat_sim.h"
 #include "esp_http_server.h"
 #include "esp_log.h"
 #include "http.h"
 #include "message.h"
+#include "morse.h"
+#include "ptt.h"
+#include "radio_cache.h"
+#include "rigctld.h"
+#include "sdkconfig.h"
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 
 static const char *TAG = "API";
-extern bool busy;
 
 static esp_err_t status_handler(httpd_req_t *req) {
-    char response[256];
+    morse_status_t morse_status;
+    morse_get_status(&morse_status);
+    ptt_status_t ptt_status;
+    ptt_get_status(&ptt_status);
+    cat_stats_t cat_stats;
+    cat_get_stats(&cat_stats);
+    radio_cache_stats_t cache_stats;
+    radio_cache_get_stats(&cache_stats);
+    rigctld_stats_t rigctld_stats;
+    rigctld_get_stats(&rigctld_stats);
+
+    char response[1280];
     snprintf(response, sizeof(response),
-             "{\"status\": \"ok\", \"busy\": %s}",
-             busy ? "true" : "false");
+             "{\"status\": \"ok\", \"busy\": %s, \"queued\": %u, \"priority_queued\": %u, "
+             "\"free_slots\": %u, \"aborted\": %lu, \"typeahead_pending\": %u, "
+             "\"typeahead_latency_us\": %lu, \"typeahead_max_latency_us\": %lu, "
+             "\"ptt\": %s, \"ptt_transmissions\": %lu, \"ptt_failures\": %lu, "
+             "\"cat_rx_bytes\": %lu, \"cat_responses\": %lu, \"cat_stream_calls\": %lu, "
+             "\"cat_timeouts\": %lu, \"cat_overflows\": %lu, \"cat_requests\": %lu, "
+             "\"cat_queue_full\": %lu, \"cat_discarded\": %lu, \"cat_unmatched\": %lu, "
+             "\"cat_unsolicited\": %lu, \"cache_hits\": %lu, \"cache_misses\": %lu, "
+             "\"cache_skipped_writes\": %lu, \"cache_pushes\": %lu, \"cat_baud_rate\": %lu, "
+             "\"cat_baud_searches\": %lu, \"cat_radio_missing\": %s, \"cat_fast_failures\": %lu, "
+             "\"cat_resyncs\": %lu, \"rigctld_connections\": %lu, \"rigctld_commands\": %lu, "
+             "\"rigctld_errors\": %lu}",
+             morse_status.busy ? "true" : "false", morse_status.queued, morse_status.priority_queued,
+             morse_status.free_slots, morse_status.aborted, morse_status.typeahead_pending,
+             morse_status.typeahead_latency_us, morse_status.typeahead_max_latency_us,
+             ptt_status.on ? "true" : "false", ptt_status.transmissions, ptt_status.failures,
+             cat_stats.rx_bytes, cat_stats.responses, cat_stats.rx_chunks + cat_stats.rx_reads,
+             cat_stats.timeouts, cat_stats.overflows, cat_stats.requests,
+             cat_stats.queue_full, cat_stats.discarded, cat_stats.unmatched,
+             cat_stats.unsolicited, cache_stats.hits, cache_stats.misses,
+             cache_stats.skipped_writes, cache_stats.pushes, cat_stats.baud_rate,
+             cat_stats.baud_searches, cat_stats.radio_missing ? "true" : "false", cat_stats.fast_failures,
+             cat_stats.resyncs, rigctld_stats.connections, rigctld_stats.commands,
+             rigctld_stats.errors);
 
     httpd_resp_set_type(req, "application/json");
     httpd_resp_send(req, response, strlen(response));
     return ESP_OK;
 }
 
+// Per-client CAT arbitration: how long each client waited for the port and held it.
+// Also the measured round trip and current timeout of each command.
+static esp_err_t cat_clients_handler(httpd_req_t *req) {
+    cat_client_stats_t clients[CAT_MAX_CLIENTS];
+    int count = cat_get_client_stats(clients, CAT_MAX_CLIENTS);
+    cat_rtt_stats_t commands[8];
+    int command_count = cat_get_rtt_stats(commands, sizeof(commands) / sizeof(commands[0]));
+
+    cJSON *json = cJSON_CreateObject();
+    cJSON *array = json ? cJSON_AddArrayToObject(json, "clients") : NULL;
+    cJSON *rtt_array = json ? cJSON_AddArrayToObject(json, "commands") : NULL;
+    if (!array || !rtt_array) {
+        ESP_LOGE(TAG, "Failed to create JSON object");
+        cJSON_Delete(json);
+        httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Failed to create JSON response");
+        return ESP_FAIL;
+    }
+
+    for (int i = 0; i < count; i++) {
+        cat_client_stats_t *client = &clients[i];
+        uint32_t n = client->transactions > 0 ? client->transactions : 1;
+        cJSON *item = cJSON_CreateObject();
+        cJSON_AddStringToObject(item, "name", client->name);
+        cJSON_AddNumberToObject(item, "priority", client->priority);
+        cJSON_AddNumberToObject(item, "transactions", client->transactions);
+        cJSON_AddNumberToObject(item, "queue_full", client->queue_full);
+        cJSON_AddNumberToObject(item, "avg_wait_us", (double)(client->wait_us / n));
+        cJSON_AddNumberToObject(item, "max_wait_us", client->max_wait_us);
+        cJSON_AddNumberToObject(item, "avg_hold_us", (double)(client->hold_us / n));
+        cJSON_AddNumberToObject(item, "max_hold_us", client->max_hold_us);
+        cJSON_AddNumberToObject(item, "sessions", client->sessions);
+        cJSON_AddNumberToObject(item, "max_session_us", client->max_session_us);
+        cJSON_AddItemToArray(array, item);
+    }
+
+    for (int i = 0; i < command_count; i++) {
+        cat_rtt_stats_t *command = &commands[i];
+        cJSON *item = cJSON_CreateObject();
+        cJSON_AddStringToObject(item, "command", command->command);
+        cJSON_AddNumberToObject(item, "srtt_us", command->srtt_us);
+        cJSON_AddNumberToObject(item, "rttvar_us", command->rttvar_us);
+        cJSON_AddNumberToObject(item, "timeout_us", command->timeout_us);
+        cJSON_AddNumberToObject(item, "last_rtt_us", command->last_rtt_us);
+        cJSON_AddNumberToObject(item, "samples", command->samples);
+        cJSON_AddNumberToObject(item, "timeouts", command->timeouts);
+        cJSON_AddItemToArray(rtt_array, item);
+    }
+
+#ifdef CONFIG_RADIO_SIMULATOR
+    // What the simulated radio saw, to set against the CAT counters in a benchmark
+    radio_sim_stats_t sim_stats;
+    cat_sim_get_stats(&sim_stats);
+    cJSON *sim = cJSON_AddObjectToObject(json, "simulator");
+    if (sim) {
+        cJSON_AddNumberToObject(sim, "commands", sim_stats.commands);
+        cJSON_AddNumberToObject(sim, "rejected", sim_stats.rejected);
+        cJSON_AddNumberToObject(sim, "garbled", sim_stats.garbled);
+        cJSON_AddNumberToObject(sim, "tx_bytes", sim_stats.tx_bytes);
+        cJSON_AddNumberToObject(sim, "dropped", sim_stats.dropped);
+        cJSON_AddNumberToObject(sim, "pushes", sim_stats.pushes);
+    }
+#endif
+
+    const char *response = cJSON_PrintUnformatted(json);
+    if (!response) {
+        ESP_LOGE(TAG, "Failed to print JSON response");
+        cJSON_Delete(json);
+        httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Failed to create JSON response");
+        return ESP_FAIL;
+    }
+
+    httpd_resp_set_type(req, "application/json");
+    httpd_resp_send(req, response, strlen(response));
+
+    cJSON_Delete(json);
+    free((void *)response);
+    return ESP_OK;
+}
+
 void register_status_endpoints(void) {
     register_html_page("/api/status", HTTP_GET, status_handler);
+    register_html_page("/api/cat", HTTP_GET, cat_clients_handler);
     ESP_LOGI(TAG, "API endpoints registered");
 }
@@ -0,0 +1,224 @@
+#include "template.h"
+#include "contest.h"
+#include "esp_log.h"
+#include "settings.h"
+#include <stdio.h>
+#include <string.h>
+#include <strings.h>
+
+static const char *TAG = "TEMPLATE";
+
+// Literal text is compiled here first, then copied into the template. Only used from
+// template_compile(), which message.c calls with its mutex held.
+static timeline_t scratch;
+
+static esp_err_t add_token(template_t *template, const template_token_t *token) {
+    if (template->token_count >= TEMPLATE_MAX_TOKENS) {
+        ESP_LOGE(TAG, "Too many tokens (%d)", TEMPLATE_MAX_TOKENS);
+        return ESP_ERR_INVALID_SIZE;
+    }
+    template->tokens[template->token_count++] = *token;
+    return ESP_OK;
+}
+
+// Compile `length` characters of the source from `start` into the runs left in the
+// template, or leave them to be compiled on send if they do not fit. *in_prosign is
+// whether the text starts between < and >, and is updated to where it ends; macros
+// between two texts never open or close a prosign.
+static esp_err_t compile_text(template_t *template, size_t start, size_t length, size_t run_capacity,
+                              bool *in_prosign) {
+    bool breaks_join = false;
+
+    timeline_init(&scratch);
+    scratch.timing = template->timing;
+    scratch.in_prosign = *in_prosign;
+    for (size_t i = 0; i < length; i++) {
+        char c = template->text[start + i];
+        breaks_join |= scratch.count == 0 && (c == '<' || c == '>');
+        esp_err_t err = timeline_append_char(&scratch, c);
+        if (err != ESP_OK) {
+            return err;
+        }
+    }
+    *in_prosign = scratch.in_prosign;
+
+    template_token_t token = {
+        .type = TOKEN_TEXT,
+        .join =
+            {
+                .breaks_join = breaks_join,
+                .letter_gap_owed = scratch.letter_gap_owed,
+                .in_prosign = scratch.in_prosign,
+                .joined = scratch.joined,
+            },
+        .text_start = start,
+        .text_length = length,
+    };
+    if (template->run_count + scratch.count <= run_capacity) {
+        token.compiled = true;
+        token.first_run = template->run_count;
+        token.run_count = scratch.count;
+        memcpy(&template->runs[template->run_count], scratch.runs, scratch.count * sizeof(keyer_run_t));
+        template->run_count += scratch.count;
+    } else {
+        ESP_LOGW(TAG, "No room for %d runs, compiling \"%.*s\" on send", scratch.count, (int)length,
+                 &template->text[start]);
+    }
+    return add_token(template, &token);
+}
+
+// Parse the name between the braces, e.g. "CALL" or "NR:TN"
+static esp_err_t parse_macro(const char *name, size_t length, template_token_t *token) {
+    static const struct {
+        const char *name;
+        template_token_type_t type;
+    } macros[] = {
+        {"CALL", TOKEN_CALL}, {"MYCALL", TOKEN_MYCALL}, {"RST", TOKEN_RST}, {"NR", TOKEN_NR}, {"LNR", TOKEN_LNR},
+    };
+
+    const char *colon = memchr(name, ':', length);
+    size_t name_length = colon ? (size_t)(colon - name) : length;
+
+    memset(token, 0, sizeof(*token));
+    size_t i;
+    for (i = 0; i < sizeof(macros) / sizeof(macros[0]); i++) {
+        if (strlen(macros[i].name) == name_length && strncasecmp(macros[i].name, name, name_length) == 0) {
+            token->type = macros[i].type;
+            break;
+        }
+    }
+    if (i == sizeof(macros) / sizeof(macros[0])) {
+        ESP_LOGE(TAG, "Unknown macro {%.*s}", (int)length, name);
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    if (colon == NULL) {
+        return ESP_OK;
+    }
+    if (token->type != TOKEN_NR && token->type != TOKEN_LNR) {
+        ESP_LOGE(TAG, "Macro {%.*s} takes no options", (int)length, name);
+        return ESP_ERR_INVALID_ARG;
+    }
+    for (const char *p = colon + 1; p < name + length; p++) {
+        switch (*p) {
+        case 'T':
+        case 't':
+            token->cut |= CUT_T;
+            break;
+        case 'N':
+        case 'n':
+            token->cut |= CUT_N;
+            break;
+        case 'A':
+        case 'a':
+            token->cut |= CUT_A;
+            break;
+        default:
+            ESP_LOGE(TAG, "Unknown cut number '%c' in {%.*s}", *p, (int)length, name);
+            return ESP_ERR_INVALID_ARG;
+        }
+    }
+    return ESP_OK;
+}
+
+// Parse a message into literal text and {MACRO} tokens at the current speed settings,
+// compiling the text into up to `run_capacity` runs at `runs`
+esp_err_t template_compile(template_t *template, const char *text, keyer_run_t *runs, size_t run_capacity) {
+    timing_current(&template->timing);
+    template->text = text;
+    template->runs = runs;
+    template->token_count = 0;
+    template->run_count = 0;
+
+    bool in_prosign = false;
+    const char *p = text;
+    while (*p != '\0') {
+        esp_err_t err;
+        if (*p == '{') {
+            const char *end = strchr(p, '}');
+            if (end == NULL) {
+                ESP_LOGE(TAG, "Unterminated macro: %s", p);
+                return ESP_ERR_INVALID_ARG;
+            }
+
+            template_token_t token;
+            err = parse_macro(p + 1, end - p - 1, &token);
+            if (err == ESP_OK) {
+                err = add_token(template, &token);
+            }
+            p = end + 1;
+        } else {
+            const char *end = strchr(p, '{');
+            if (end == NULL) {
+                end = p + strlen(p);
+            }
+            err = compile_text(template, p - text, end - p, run_capacity, &in_prosign);
+            p = end;
+        }
+
+        if (err != ESP_OK) {
+            return err;
+        }
+    }
+    return ESP_OK;
+}
+
+bool template_is_current(const template_t *template) {
+    morse_timing_t timing;
+    timing_current(&timing);
+    return timing_equal(&template->timing, &timing);
+}
+
+// Build the timeline to key. *serial is set to the serial sent by {NR}, or 0 if there is none,
+// so the caller can advance the counter once the message has actually gone out.
+esp_err_t template_expand(const template_t *template, timeline_t *timeline, uint32_t *serial) {
+    timeline_init(timeline);
+    timeline->timing = template->timing;
+    *serial = 0;
+
+    esp_err_t err = ESP_OK;
+    for (size_t i = 0; i < template->token_count && err == ESP_OK; i++) {
+        const template_token_t *token = &template->tokens[i];
+        char text[CONTEST_CALL_MAX_SIZE] = "";
+
+        switch (token->type) {
+        case TOKEN_TEXT:
+            if (token->compiled) {
+                err = timeline_append_runs(timeline, &template->runs[token->first_run], token->run_count,
+                                           &token->join);
+            }
+            for (size_t j = 0; j < token->text_length && !token->compiled && err == ESP_OK; j++) {
+                err = timeline_append_char(timeline, template->text[token->text_start + j]);
+            }
+            continue;
+        case TOKEN_CALL:
+            contest_get_call(text, sizeof(text));
+            break;
+        case TOKEN_MYCALL:
+            snprintf(text, sizeof(text), "%s", my_call);
+            break;
+        case TOKEN_RST:
+            contest_get_rst(text, sizeof(text));
+            break;
+        case TOKEN_NR:
+            if (*serial == 0) {
+                *serial = contest_get_serial(); // The same number however often it appears
+            }
+            contest_format_serial(*serial, token->cut, text, sizeof(text));
+            break;
+        case TOKEN_LNR: {
+            uint32_t last = contest_get_last_serial();
+            if (last != 0) {
+                contest_format_serial(last, token->cut, text, sizeof(text));
+            }
+            break;
+        }
+        }
+
+        if (text[0] == '\0') {
+            ESP_LOGW(TAG, "Macro %d expands to nothing", token->type);
+        }
+        err = timeline_append(timeline, text);
+    }
+    return err;
+}
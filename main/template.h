@@ -0,0 +1,52 @@
+#ifndef TEMPLATE_H
+#define TEMPLATE_H
+
+#include "esp_err.h"
+#include "keyer.h"
+#include "timeline.h"
+#include "timing.h"
+#include <stddef.h>
+#include <stdint.h>
+
+// Text and macros alternate, and the shortest macro is 4 characters, so a 64-character
+// message has at most 26 tokens
+#define TEMPLATE_MAX_TOKENS 32
+
+typedef enum {
+    TOKEN_TEXT,   // Literal text, already compiled to runs
+    TOKEN_CALL,   // {CALL}: the station being worked
+    TOKEN_MYCALL, // {MYCALL}
+    TOKEN_RST,    // {RST}
+    TOKEN_NR,     // {NR}: the current serial, {NR:TNA} with cut numbers
+    TOKEN_LNR,    // {LNR}: the serial sent last, for repeats
+} template_token_type_t;
+
+typedef struct {
+    uint8_t type;
+    uint8_t cut;          // CUT_* flags for TOKEN_NR and TOKEN_LNR
+    bool compiled;        // TOKEN_TEXT: the runs are in the template, else compiled on send
+    timeline_text_t join; // TOKEN_TEXT: how the runs join on, and the state after them
+    uint16_t first_run;
+    uint16_t run_count;
+    uint16_t text_start; // TOKEN_TEXT: where the text is in the source
+    uint16_t text_length;
+} template_token_t;
+
+// A message parsed into tokens once when it is saved. Literal text is compiled up front
+// into runs the caller provides room for, sized to what the text needs, so expanding it
+// only compiles the macros and copies the rest. Text that finds no room is compiled when
+// the template is expanded instead.
+typedef struct {
+    morse_timing_t timing;
+    const char *text;  // The source, which must outlive the template
+    keyer_run_t *runs; // The compiled text
+    size_t run_count;
+    size_t token_count;
+    template_token_t tokens[TEMPLATE_MAX_TOKENS];
+} template_t;
+
+esp_err_t template_compile(template_t *template, const char *text, keyer_run_t *runs, size_t run_capacity);
+bool template_is_current(const template_t *template);
+esp_err_t template_expand(const template_t *template, timeline_t *timeline, uint32_t *serial);
+
+#endif // TEMPLATE_H
@@ -0,0 +1,132 @@
+#include "timeline.h"
+#include "esp_log.h"
+#include "morse_code_characters.h"
+
+static const char *TAG = "TIMELINE";
+
+// Append a run, merging it into the previous one when the level is the same
+static esp_err_t push_run(timeline_t *timeline, bool level, uint32_t duration_us) {
+    if (duration_us == 0) {
+        return ESP_OK;
+    }
+
+    if (timeline->count > 0) {
+        keyer_run_t *last = &timeline->runs[timeline->count - 1];
+        if (last->level == level) {
+            last->duration_us += duration_us;
+            return ESP_OK;
+        }
+    }
+
+    if (timeline->count >= TIMELINE_MAX_RUNS) {
+        ESP_LOGE(TAG, "Timeline full (%d runs)", TIMELINE_MAX_RUNS);
+        return ESP_ERR_INVALID_SIZE;
+    }
+
+    timeline->runs[timeline->count].level = level;
+    timeline->runs[timeline->count].duration_us = duration_us;
+    timeline->count++;
+    return ESP_OK;
+}
+
+// Gap owed before the next character: only an element gap inside a prosign
+static uint32_t owed_gap_us(const timeline_t *timeline) {
+    return timeline->joined ? timeline->timing.element_gap_us : timeline->timing.letter_gap_us;
+}
+
+// Start an empty timeline at the current speed settings
+void timeline_init(timeline_t *timeline) {
+    timeline->count = 0;
+    timing_current(&timeline->timing);
+    timeline->letter_gap_owed = false;
+    timeline->in_prosign = false;
+    timeline->joined = false;
+}
+
+// Check whether a timeline was compiled with the current speed settings
+bool timeline_is_current(const timeline_t *timeline) {
+    morse_timing_t timing;
+    timing_current(&timing);
+    return timing_equal(&timeline->timing, &timing);
+}
+
+// Append one character. The gap after a character is only emitted once the next
+// character is known, so a trailing gap never ends up at the end of the timeline.
+esp_err_t timeline_append_char(timeline_t *timeline, char c) {
+    const morse_timing_t *timing = &timeline->timing;
+
+    if (c == ' ') {
+        timeline->letter_gap_owed = false;
+        return push_run(timeline, false, timing->word_gap_us); // Space between words
+    }
+    if (c == '<' || c == '>') {
+        timeline->in_prosign = c == '<';
+        timeline->joined = false; // A prosign is still a letter apart from its neighbours
+        return ESP_OK;
+    }
+
+    morse_code_t code = char_to_morse(c);
+    if (code == MORSE_NONE) {
+        ESP_LOGW(TAG, "No Morse code for character 0x%02x", (unsigned char)c);
+        return ESP_OK;
+    }
+
+    esp_err_t err = ESP_OK;
+    if (timeline->letter_gap_owed) {
+        err = push_run(timeline, false, owed_gap_us(timeline)); // Space between letters
+    }
+
+    int length = morse_length(code);
+    for (int j = 0; j < length && err == ESP_OK; j++) {
+        if (j > 0) {
+            err = push_run(timeline, false, timing->element_gap_us); // Space between DITs and DAHs
+        }
+        if (err == ESP_OK) {
+            err = push_run(timeline, true, morse_element(code, j) == DAH ? timing->dah_us : timing->dit_us);
+        }
+    }
+
+    timeline->letter_gap_owed = true;
+    timeline->joined = timeline->in_prosign;
+    return err;
+}
+
+esp_err_t timeline_append(timeline_t *timeline, const char *text) {
+    for (const char *p = text; *p != '\0'; p++) {
+        esp_err_t err = timeline_append_char(timeline, *p);
+        if (err != ESP_OK) {
+            return err;
+        }
+    }
+    return ESP_OK;
+}
+
+// Append runs compiled on their own, e.g. a literal part of a template, as if their
+// characters had been appended one by one. `text` says how they join on and the state
+// they leave; text with no runs, such as a lone "<", still opens or closes a prosign.
+esp_err_t timeline_append_runs(timeline_t *timeline, const keyer_run_t *runs, size_t count, const timeline_text_t *text) {
+    esp_err_t err = ESP_OK;
+
+    if (text->breaks_join) {
+        timeline->joined = false;
+    }
+    if (count > 0 && timeline->letter_gap_owed && runs[0].level) {
+        err = push_run(timeline, false, owed_gap_us(timeline)); // Space between letters
+    }
+    for (size_t i = 0; i < count && err == ESP_OK; i++) {
+        err = push_run(timeline, runs[i].level, runs[i].duration_us);
+    }
+
+    if (count > 0) {
+        timeline->letter_gap_owed = text->letter_gap_owed;
+        timeline->joined = text->joined;
+    }
+    timeline->in_prosign = text->in_prosign;
+    return err;
+}
+
+// Compile a whole message at the current speed settings
+esp_err_t timeline_compile(timeline_t *timeline, const char *message) {
+    timeline_init(timeline);
+    return timeline_append(timeline, message);
+}
@@ -0,0 +1,43 @@
+#ifndef TIMELINE_H
+#define TIMELINE_H
+
+#include "esp_err.h"
+#include "keyer.h"
+#include "timing.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Longest character is 7 elements: 7 marks, 6 element gaps and the letter gap
+#define TIMELINE_MAX_CHARS 64
+#define TIMELINE_RUNS_PER_CHAR 14
+#define TIMELINE_MAX_RUNS (TIMELINE_MAX_CHARS * TIMELINE_RUNS_PER_CHAR)
+
+// A message compiled to run-length keying runs, ready for keyer_play(). Characters written
+// between < and >, e.g. <AR> or <SK>, are sent as one prosign with no letter gaps.
+typedef struct {
+    size_t count;
+    morse_timing_t timing; // Element lengths the timeline was compiled with
+    bool letter_gap_owed;  // A letter gap goes before the next character
+    bool in_prosign;       // Between < and >
+    bool joined;           // The owed gap is inside a prosign, so only an element gap
+    keyer_run_t runs[TIMELINE_MAX_RUNS];
+} timeline_t;
+
+// How text compiled on its own, e.g. a literal part of a template, fits in among what is
+// around it when its runs are appended to a timeline
+typedef struct {
+    bool breaks_join;     // A < or > comes before the first element, so a letter gap goes before it
+    bool letter_gap_owed; // The state after the text
+    bool in_prosign;
+    bool joined;
+} timeline_text_t;
+
+void timeline_init(timeline_t *timeline);
+bool timeline_is_current(const timeline_t *timeline);
+esp_err_t timeline_append_char(timeline_t *timeline, char c);
+esp_err_t timeline_append(timeline_t *timeline, const char *text);
+esp_err_t timeline_append_runs(timeline_t *timeline, const keyer_run_t *runs, size_t count, const timeline_text_t *text);
+esp_err_t timeline_compile(timeline_t *timeline, const char *message);
+
+#endif // TIMELINE_H
@@ -0,0 +1,47 @@
+#include "timing.h"
+#include "morse_code_characters.h"
+#include "settings.h"
+
+// "PARIS" is 50 dits long, so one dit at 1 WPM lasts 60 s / 50 = 1.2 s
+#define DIT_US_AT_1_WPM 1200000ULL
+
+/**
+ * Calculate element and gap lengths in microseconds.
+ * @param char_wpm Speed at which characters are sent.
+ * @param effective_wpm Farnsworth overall speed; 0 or >= char_wpm disables it.
+ * @param dah_ratio Dah length in tenths of a dit (30 = 3:1).
+ * @param weight Mark weight in percent; the extra mark time is taken from the following space.
+ */
+void timing_compute(morse_timing_t *timing, int char_wpm, int effective_wpm, int dah_ratio, int weight) {
+    uint32_t dit_us = DIT_US_AT_1_WPM / char_wpm;
+    int32_t weight_us = (int32_t)dit_us * (weight - WEIGHT_DEFAULT) / WEIGHT_DEFAULT;
+
+    uint32_t letter_gap_us = LETTER_SPACE * dit_us;
+    uint32_t word_gap_us = WORD_SPACE * dit_us;
+
+    if (effective_wpm > 0 && effective_wpm < char_wpm) {
+        // ARRL Farnsworth: the extra time ta = (60c - 37.2s) / (sc) seconds is
+        // spread over the 19 dits of letter and word gaps in "PARIS "
+        uint64_t c = char_wpm;
+        uint64_t s = effective_wpm;
+        uint64_t delay_us = (60000000ULL * c - 37200000ULL * s) / (s * c);
+        letter_gap_us = delay_us * LETTER_SPACE / 19;
+        word_gap_us = delay_us * WORD_SPACE / 19;
+    }
+
+    timing->dit_us = dit_us + weight_us;
+    timing->dah_us = dit_us * dah_ratio / 10 + weight_us;
+    timing->element_gap_us = SPACE * dit_us - weight_us;
+    timing->letter_gap_us = letter_gap_us - weight_us;
+    timing->word_gap_us = word_gap_us - weight_us;
+}
+
+// Timing for the current speed settings
+void timing_current(morse_timing_t *timing) {
+    timing_compute(timing, wpm, farnsworth_wpm, dah_ratio, weight);
+}
+
+bool timing_equal(const morse_timing_t *a, const morse_timing_t *b) {
+    return a->dit_us == b->dit_us && a->dah_us == b->dah_us && a->element_gap_us == b->element_gap_us &&
+           a->letter_gap_us == b->letter_gap_us && a->word_gap_us == b->word_gap_us;
+}
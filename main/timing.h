@@ -0,0 +1,23 @@
+#ifndef TIMING_H
+#define TIMING_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define DAH_RATIO_DEFAULT 30 // Dah length in tenths of a dit
+#define WEIGHT_DEFAULT 50    // Percent, 50 keeps marks and spaces equal
+
+// Element and gap lengths in microseconds
+typedef struct {
+    uint32_t dit_us;
+    uint32_t dah_us;
+    uint32_t element_gap_us;
+    uint32_t letter_gap_us;
+    uint32_t word_gap_us;
+} morse_timing_t;
+
+void timing_compute(morse_timing_t *timing, int char_wpm, int effective_wpm, int dah_ratio, int weight);
+void timing_current(morse_timing_t *timing);
+bool timing_equal(const morse_timing_t *a, const morse_timing_t *b);
+
+#endif // TIMING_H
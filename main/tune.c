@@ -1,7 +1,9 @@
 #include "tune.h"
+#include "cat.h"
 #include "esp_log.h"
 #include "gpio.h"
 #include "radio.h"
+#include "radio_cache.h"
 #include "settings.h" // Include settings header to access tune_power
 #include <stdio.h>
 #include <string.h>
@@ -41,39 +43,19 @@ static bool is_inband(uint32_t frequency) {
     return false;
 }
 
-// Start the tuning process
-void tune_start(tune_data_t *tune_data) {
-    ESP_LOGI(TAG, "Starting tuning process...");
-
+// Save the radio's settings, switch to the tune settings and key down
+static void start_tuning(tune_data_t *tune_data) {
     // Save the current frequency, mode, and power
-    if (get_frequency(&tune_data->frequency) != ESP_OK) {
-        ESP_LOGE(TAG, "Failed to get current frequency");
-        return;
-    }
-    if (get_mode(&tune_data->mode) != ESP_OK) {
-        ESP_LOGE(TAG, "Failed to get current mode");
+    if (radio_cache_get_frequency_and_mode(&tune_data->frequency, &tune_data->mode) != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to get current frequency and mode");
         return;
     }
-    if (get_power(&tune_data->power) != ESP_OK) {
+    if (radio_cache_get_power(&tune_data->power) != ESP_OK) {
         ESP_LOGE(TAG, "Failed to get current power");
         return;
     }
     ESP_LOGI(TAG, "Saved frequency: %lu Hz, mode: %s, power: %u", tune_data->frequency, mode_to_string(tune_data->mode), tune_data->power);
 
-    // Set mode for tuning
-    uint8_t tune_mode = string_to_mode(TUNE_MODE);
-    if (set_mode(tune_mode) != ESP_OK) {
-        ESP_LOGE(TAG, "Failed to set tune mode");
-        return;
-    }
-
-    // Set power for tuning
-    if (set_power(tune_power) != ESP_OK) {
-        ESP_LOGE(TAG, "Failed to set tune power");
-        return;
-    }
-    ESP_LOGI(TAG, "Power set to: %u", tune_power);
-
     // Adjust frequency for tuning
     const char *mode_str = mode_to_string(tune_data->mode);
     uint32_t tune_offset = 5000;
@@ -93,41 +75,46 @@ void tune_start(tune_data_t *tune_data) {
         }
     }
 
-    if (set_frequency(new_frequency) != ESP_OK) {
-        ESP_LOGE(TAG, "Failed to set tuning frequency");
+    // Set mode, power and frequency for tuning in one go
+    uint8_t tune_mode = string_to_mode(TUNE_MODE);
+    if (radio_cache_set_mode_power_frequency(tune_mode, tune_power, new_frequency) != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to set tune mode, power and frequency");
         return;
     }
-    ESP_LOGI(TAG, "Tuning frequency set to: %lu Hz", new_frequency);
+    ESP_LOGI(TAG, "Tuning on %lu Hz, %s, power %u", new_frequency, TUNE_MODE, tune_power);
 
     key_down();
     ESP_LOGI(TAG, "Key down for tuning...");
 }
 
-// Stop the tuning process
-void tune_stop(tune_data_t *tune_data) {
-    ESP_LOGI(TAG, "Stopping tuning process...");
-
+// Key up and put back the settings saved by start_tuning()
+static void stop_tuning(tune_data_t *tune_data) {
     key_up();
     ESP_LOGI(TAG, "Key up after tuning...");
 
-    // Restore the original power
-    if (set_power(tune_data->power) != ESP_OK) {
-        ESP_LOGE(TAG, "Failed to restore power");
+    // Restore the original mode, power and frequency
+    if (radio_cache_set_mode_power_frequency(tune_data->mode, tune_data->power, tune_data->frequency) != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to restore mode, power and frequency");
         return;
     }
-    ESP_LOGI(TAG, "Restored power: %u", tune_data->power);
+    ESP_LOGI(TAG, "Restored frequency: %lu Hz, mode: %s, power: %u", tune_data->frequency, mode_to_string(tune_data->mode), tune_data->power);
+}
 
-    // Restore the original mode
-    if (set_mode(tune_data->mode) != ESP_OK) {
-        ESP_LOGE(TAG, "Failed to restore mode");
-        return;
-    }
-    ESP_LOGI(TAG, "Restored mode: %s", mode_to_string(tune_data->mode));
+// Start the tuning process. The save and the switch run as one CAT session so nothing
+// else can change the radio between reading its settings and overwriting them.
+void tune_start(tune_data_t *tune_data) {
+    ESP_LOGI(TAG, "Starting tuning process...");
 
-    // Restore the original frequency
-    if (set_frequency(tune_data->frequency) != ESP_OK) {
-        ESP_LOGE(TAG, "Failed to restore frequency");
-        return;
-    }
-    ESP_LOGI(TAG, "Restored frequency: %lu Hz", tune_data->frequency);
+    cat_begin();
+    start_tuning(tune_data);
+    cat_end();
+}
+
+// Stop the tuning process
+void tune_stop(tune_data_t *tune_data) {
+    ESP_LOGI(TAG, "Stopping tuning process...");
+
+    cat_begin();
+    stop_tuning(tune_data);
+    cat_end();
 }
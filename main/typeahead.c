@@ -0,0 +1,82 @@
+#include "typeahead.h"
+#include <stdatomic.h>
+
+// Indices are 8 bits wide and wrap naturally, so the ring holds up to 255 characters
+#define RING_SIZE 256
+
+// Head, tail and a change counter packed into one word so that every update is a
+// single compare-and-swap. The counter stops a pop from succeeding on a slot that a
+// backspace cancelled and a new push refilled in the meantime.
+#define TAIL(state) ((uint8_t)(state))
+#define HEAD(state) ((uint8_t)((state) >> 8))
+#define GENERATION(state) ((uint16_t)((state) >> 16))
+#define STATE(generation, head, tail) ((uint32_t)(uint16_t)(generation) << 16 | (uint32_t)(uint8_t)(head) << 8 | (uint8_t)(tail))
+
+static char characters[RING_SIZE];
+static uint32_t arrivals[RING_SIZE];
+static _Atomic uint32_t ring_state = 0;
+
+bool typeahead_push(char c, uint32_t arrival_us) {
+    uint32_t state = atomic_load(&ring_state);
+    uint32_t next;
+
+    do {
+        uint8_t head = HEAD(state);
+        if ((uint8_t)(head + 1) == TAIL(state)) {
+            return false; // Full
+        }
+        // The slot at head is not visible to the consumer until the swap succeeds
+        characters[head] = c;
+        arrivals[head] = arrival_us;
+        next = STATE(GENERATION(state) + 1, head + 1, TAIL(state));
+    } while (!atomic_compare_exchange_weak(&ring_state, &state, next));
+
+    return true;
+}
+
+// Cancel the most recently typed character if it has not been taken yet
+bool typeahead_backspace(void) {
+    uint32_t state = atomic_load(&ring_state);
+    uint32_t next;
+
+    do {
+        if (HEAD(state) == TAIL(state)) {
+            return false; // Nothing left to cancel
+        }
+        next = STATE(GENERATION(state) + 1, HEAD(state) - 1, TAIL(state));
+    } while (!atomic_compare_exchange_weak(&ring_state, &state, next));
+
+    return true;
+}
+
+bool typeahead_pop(char *c, uint32_t *arrival_us) {
+    uint32_t state = atomic_load(&ring_state);
+    uint32_t next;
+
+    do {
+        uint8_t tail = TAIL(state);
+        if (HEAD(state) == tail) {
+            return false; // Empty
+        }
+        *c = characters[tail];
+        *arrival_us = arrivals[tail];
+        next = STATE(GENERATION(state), HEAD(state), tail + 1);
+    } while (!atomic_compare_exchange_weak(&ring_state, &state, next));
+
+    return true;
+}
+
+// Drop everything that has not been sent yet
+void typeahead_clear(void) {
+    uint32_t state = atomic_load(&ring_state);
+    uint32_t next;
+
+    do {
+        next = STATE(GENERATION(state) + 1, HEAD(state), HEAD(state));
+    } while (!atomic_compare_exchange_weak(&ring_state, &state, next));
+}
+
+size_t typeahead_pending(void) {
+    uint32_t state = atomic_load(&ring_state);
+    return (uint8_t)(HEAD(state) - TAIL(state));
+}
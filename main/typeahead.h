@@ -0,0 +1,16 @@
+#ifndef TYPEAHEAD_H
+#define TYPEAHEAD_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Characters typed ahead of the keyer. One producer (the WebSocket handler) pushes and
+// cancels, one consumer (morse_code_task) pops; neither side takes a lock.
+bool typeahead_push(char c, uint32_t arrival_us);
+bool typeahead_backspace(void);
+bool typeahead_pop(char *c, uint32_t *arrival_us);
+void typeahead_clear(void);
+size_t typeahead_pending(void);
+
+#endif // TYPEAHEAD_H
@@ -0,0 +1,60 @@
+#include "esp_log.h"
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+static int log_level = -1;
+
+static const char level_letters[] = "NEWIDV";
+
+void esp_log_level_set(const char *tag, esp_log_level_t level) {
+    (void)tag;
+    log_level = level;
+}
+
+void esp_log_write(esp_log_level_t level, const char *tag, const char *format, ...) {
+    va_list args;
+
+    if (log_level < 0) {
+        const char *env = getenv("ESP_LOG_LEVEL");
+        log_level = env != NULL ? atoi(env) : ESP_LOG_WARN;
+    }
+    if ((int)level > log_level) {
+        return;
+    }
+
+    fprintf(stderr, "%c (%s) ", level_letters[level], tag);
+    va_start(args, format);
+    vfprintf(stderr, format, args);
+    va_end(args);
+    fputc('\n', stderr);
+}
+
+const char *esp_err_to_name(esp_err_t code) {
+    switch (code) {
+    case ESP_OK:
+        return "ESP_OK";
+    case ESP_FAIL:
+        return "ESP_FAIL";
+    case ESP_ERR_NO_MEM:
+        return "ESP_ERR_NO_MEM";
+    case ESP_ERR_INVALID_ARG:
+        return "ESP_ERR_INVALID_ARG";
+    case ESP_ERR_INVALID_STATE:
+        return "ESP_ERR_INVALID_STATE";
+    case ESP_ERR_INVALID_SIZE:
+        return "ESP_ERR_INVALID_SIZE";
+    case ESP_ERR_NOT_FOUND:
+        return "ESP_ERR_NOT_FOUND";
+    case ESP_ERR_NOT_SUPPORTED:
+        return "ESP_ERR_NOT_SUPPORTED";
+    case ESP_ERR_TIMEOUT:
+        return "ESP_ERR_TIMEOUT";
+    case ESP_ERR_INVALID_RESPONSE:
+        return "ESP_ERR_INVALID_RESPONSE";
+    case ESP_ERR_NOT_FINISHED:
+        return "ESP_ERR_NOT_FINISHED";
+    default:
+        return "UNKNOWN ERROR";
+    }
+}
@@ -0,0 +1,786 @@
+#define _GNU_SOURCE
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+#include "freertos/stream_buffer.h"
+#include "freertos/task.h"
+#include "freertos/timers.h"
+#include "esp_timer.h"
+#include "host_port.h"
+#include <errno.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+// Every kernel object is guarded by one lock, and every change wakes every waiter, which
+// then checks whether it can go on. That is far slower than FreeRTOS, but simple enough
+// to be obviously right, and the firmware only ever has a handful of tasks.
+static pthread_mutex_t kernel_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t kernel_changed;
+static pthread_once_t kernel_once = PTHREAD_ONCE_INIT;
+static pthread_mutex_t critical_lock;
+static port_stats_t port_stats;
+static struct timespec start_time;
+
+struct port_task {
+    pthread_t thread;
+    char name[16];
+    TaskFunction_t function;
+    void *arg;
+    uint32_t notify_value;
+    bool notify_pending;
+};
+
+static __thread struct port_task *current_task = NULL;
+
+static void kernel_init(void) {
+    pthread_condattr_t cond_attr;
+    pthread_condattr_init(&cond_attr);
+    pthread_condattr_setclock(&cond_attr, CLOCK_MONOTONIC);
+    pthread_cond_init(&kernel_changed, &cond_attr);
+
+    pthread_mutexattr_t mutex_attr;
+    pthread_mutexattr_init(&mutex_attr);
+    pthread_mutexattr_settype(&mutex_attr, PTHREAD_MUTEX_RECURSIVE);
+    pthread_mutex_init(&critical_lock, &mutex_attr);
+
+    clock_gettime(CLOCK_MONOTONIC, &start_time);
+}
+
+static void lock(void) {
+    pthread_once(&kernel_once, kernel_init);
+    pthread_mutex_lock(&kernel_lock);
+    port_stats.kernel_calls++;
+}
+
+static void unlock_changed(void) {
+    pthread_cond_broadcast(&kernel_changed);
+    pthread_mutex_unlock(&kernel_lock);
+}
+
+static void unlock(void) {
+    pthread_mutex_unlock(&kernel_lock);
+}
+
+void port_init(void) {
+    cpu_set_t cpus;
+
+    pthread_once(&kernel_once, kernel_init);
+    CPU_ZERO(&cpus);
+    CPU_SET(sched_getcpu() >= 0 ? sched_getcpu() : 0, &cpus);
+    sched_setaffinity(0, sizeof(cpus), &cpus);
+    setvbuf(stdout, NULL, _IOLBF, 0);
+}
+
+void port_get_stats(port_stats_t *stats) {
+    pthread_mutex_lock(&kernel_lock);
+    *stats = port_stats;
+    pthread_mutex_unlock(&kernel_lock);
+}
+
+void port_reset_stats(void) {
+    pthread_mutex_lock(&kernel_lock);
+    memset(&port_stats, 0, sizeof(port_stats));
+    pthread_mutex_unlock(&kernel_lock);
+}
+
+uint64_t port_cpu_time_us(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &now);
+    return (uint64_t)now.tv_sec * 1000000 + now.tv_nsec / 1000;
+}
+
+int64_t esp_timer_get_time(void) {
+    struct timespec now;
+
+    pthread_once(&kernel_once, kernel_init);
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (int64_t)(now.tv_sec - start_time.tv_sec) * 1000000 + (now.tv_nsec - start_time.tv_nsec) / 1000;
+}
+
+TickType_t xTaskGetTickCount(void) {
+    return (TickType_t)(esp_timer_get_time() / (1000000 / configTICK_RATE_HZ));
+}
+
+// Absolute time `us` after now, on the clock the condition variable uses
+static struct timespec deadline_after_us(int64_t us) {
+    struct timespec deadline;
+
+    clock_gettime(CLOCK_MONOTONIC, &deadline);
+    deadline.tv_sec += us / 1000000;
+    deadline.tv_nsec += (us % 1000000) * 1000;
+    if (deadline.tv_nsec >= 1000000000) {
+        deadline.tv_sec++;
+        deadline.tv_nsec -= 1000000000;
+    }
+    return deadline;
+}
+
+// Wait `ticks` from now, counted from the start of the current tick as FreeRTOS does
+static struct timespec deadline_after(TickType_t ticks) {
+    int64_t tick_us = 1000000 / configTICK_RATE_HZ;
+    int64_t now_us = esp_timer_get_time();
+    return deadline_after_us((int64_t)ticks * tick_us - now_us % tick_us);
+}
+
+// Sleep until something changes. False once the deadline has passed.
+static bool wait_changed(TickType_t ticks, const struct timespec *deadline) {
+    if (ticks == 0) {
+        return false;
+    }
+    if (ticks == portMAX_DELAY) {
+        pthread_cond_wait(&kernel_changed, &kernel_lock);
+        return true;
+    }
+    return pthread_cond_timedwait(&kernel_changed, &kernel_lock, deadline) != ETIMEDOUT;
+}
+
+void port_enter_critical(void) {
+    pthread_once(&kernel_once, kernel_init);
+    pthread_mutex_lock(&critical_lock);
+}
+
+void port_exit_critical(void) {
+    pthread_mutex_unlock(&critical_lock);
+}
+
+/* Tasks */
+
+static struct port_task *self(void) {
+    if (current_task == NULL) {
+        current_task = calloc(1, sizeof(*current_task)); // main() or a thread not made here
+        current_task->thread = pthread_self();
+        snprintf(current_task->name, sizeof(current_task->name), "main");
+    }
+    return current_task;
+}
+
+static void *task_entry(void *arg) {
+    current_task = arg;
+    current_task->function(current_task->arg);
+    return NULL;
+}
+
+BaseType_t xTaskCreate(TaskFunction_t function, const char *name, uint32_t stack_depth, void *arg,
+                       UBaseType_t priority, TaskHandle_t *created) {
+    struct port_task *task = calloc(1, sizeof(*task));
+    pthread_attr_t attr;
+
+    (void)stack_depth; // Host stacks are far larger; the firmware's sizes are checked on target
+    (void)priority;
+    if (task == NULL) {
+        return pdFAIL;
+    }
+    snprintf(task->name, sizeof(task->name), "%s", name);
+    task->function = function;
+    task->arg = arg;
+    if (created != NULL) {
+        *created = task; // Before the task runs, as the task may use its own handle
+    }
+
+    pthread_attr_init(&attr);
+    pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+    if (pthread_create(&task->thread, &attr, task_entry, task) != 0) {
+        free(task);
+        return pdFAIL;
+    }
+    return pdPASS;
+}
+
+void vTaskDelete(TaskHandle_t task) {
+    if (task == NULL || task == current_task) {
+        pthread_exit(NULL); // The handle stays valid, so late notifications are harmless
+    }
+    fprintf(stderr, "vTaskDelete() of another task is not supported on the host\n");
+    abort();
+}
+
+void vTaskDelay(TickType_t ticks) {
+    struct timespec deadline = deadline_after(ticks);
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &deadline, NULL) == EINTR) {
+    }
+}
+
+TaskHandle_t xTaskGetCurrentTaskHandle(void) {
+    return self();
+}
+
+const char *pcTaskGetName(TaskHandle_t task) {
+    return (task != NULL ? task : self())->name;
+}
+
+BaseType_t xTaskNotify(TaskHandle_t task, uint32_t value, eNotifyAction action) {
+    BaseType_t result = pdPASS;
+
+    lock();
+    switch (action) {
+    case eNoAction:
+        break;
+    case eSetBits:
+        task->notify_value |= value;
+        break;
+    case eIncrement:
+        task->notify_value++;
+        break;
+    case eSetValueWithOverwrite:
+        task->notify_value = value;
+        break;
+    case eSetValueWithoutOverwrite:
+        if (task->notify_pending) {
+            result = pdFAIL;
+        } else {
+            task->notify_value = value;
+        }
+        break;
+    }
+    task->notify_pending = true;
+    unlock_changed();
+    return result;
+}
+
+BaseType_t xTaskNotifyGive(TaskHandle_t task) {
+    return xTaskNotify(task, 0, eIncrement);
+}
+
+BaseType_t xTaskNotifyFromISR(TaskHandle_t task, uint32_t value, eNotifyAction action, BaseType_t *woken) {
+    (void)woken;
+    return xTaskNotify(task, value, action);
+}
+
+void vTaskNotifyGiveFromISR(TaskHandle_t task, BaseType_t *woken) {
+    (void)woken;
+    xTaskNotifyGive(task);
+}
+
+uint32_t ulTaskNotifyTake(BaseType_t clear_on_exit, TickType_t ticks) {
+    struct port_task *task = self();
+    struct timespec deadline = deadline_after(ticks);
+    bool blocked = false;
+
+    lock();
+    while (task->notify_value == 0) {
+        if (!blocked && ticks != 0) {
+            blocked = true;
+            port_stats.blocks++;
+        }
+        if (!wait_changed(ticks, &deadline) && task->notify_value == 0) {
+            break;
+        }
+    }
+    uint32_t value = task->notify_value;
+    if (value != 0) {
+        task->notify_value = clear_on_exit ? 0 : value - 1;
+    }
+    task->notify_pending = false;
+    unlock();
+    return value;
+}
+
+BaseType_t xTaskNotifyWait(uint32_t clear_on_entry, uint32_t clear_on_exit, uint32_t *value, TickType_t ticks) {
+    struct port_task *task = self();
+    struct timespec deadline = deadline_after(ticks);
+    bool blocked = false;
+
+    lock();
+    if (!task->notify_pending) {
+        task->notify_value &= ~clear_on_entry;
+    }
+    while (!task->notify_pending) {
+        if (!blocked && ticks != 0) {
+            blocked = true;
+            port_stats.blocks++;
+        }
+        if (!wait_changed(ticks, &deadline) && !task->notify_pending) {
+            break;
+        }
+    }
+    if (value != NULL) {
+        *value = task->notify_value;
+    }
+    BaseType_t received = task->notify_pending ? pdTRUE : pdFALSE;
+    if (received) {
+        task->notify_value &= ~clear_on_exit;
+    }
+    task->notify_pending = false;
+    unlock();
+    return received;
+}
+
+/* Queues and semaphores */
+
+struct port_queue {
+    uint8_t *storage;
+    size_t item_size;
+    size_t length;
+    size_t head;
+    size_t count;
+    bool allocated;
+};
+
+_Static_assert(sizeof(struct port_queue) <= sizeof(StaticSemaphore_t), "StaticSemaphore_t too small");
+
+static void queue_init(struct port_queue *queue, size_t length, size_t item_size, uint8_t *storage, bool allocated) {
+    queue->storage = storage;
+    queue->item_size = item_size;
+    queue->length = length;
+    queue->head = 0;
+    queue->count = 0;
+    queue->allocated = allocated;
+}
+
+QueueHandle_t xQueueCreate(UBaseType_t length, UBaseType_t item_size) {
+    struct port_queue *queue = malloc(sizeof(*queue) + (size_t)length * item_size);
+
+    if (queue != NULL) {
+        queue_init(queue, length, item_size, (uint8_t *)(queue + 1), true);
+    }
+    return queue;
+}
+
+void vQueueDelete(QueueHandle_t queue) {
+    if (queue != NULL && queue->allocated) {
+        free(queue);
+    }
+}
+
+static BaseType_t queue_send(QueueHandle_t queue, const void *item, TickType_t ticks, bool front) {
+    struct timespec deadline = deadline_after(ticks);
+    bool blocked = false;
+
+    lock();
+    while (queue->count == queue->length) {
+        if (!blocked && ticks != 0) {
+            blocked = true;
+            port_stats.blocks++;
+        }
+        if (!wait_changed(ticks, &deadline) && queue->count == queue->length) {
+            unlock();
+            return pdFAIL;
+        }
+    }
+
+    size_t slot;
+    if (front) {
+        queue->head = (queue->head + queue->length - 1) % queue->length;
+        slot = queue->head;
+    } else {
+        slot = (queue->head + queue->count) % queue->length;
+    }
+    if (queue->item_size > 0) {
+        memcpy(queue->storage + slot * queue->item_size, item, queue->item_size);
+    }
+    queue->count++;
+    unlock_changed();
+    return pdPASS;
+}
+
+BaseType_t xQueueSend(QueueHandle_t queue, const void *item, TickType_t ticks) {
+    return queue_send(queue, item, ticks, false);
+}
+
+BaseType_t xQueueSendToFront(QueueHandle_t queue, const void *item, TickType_t ticks) {
+    return queue_send(queue, item, ticks, true);
+}
+
+static BaseType_t queue_receive(QueueHandle_t queue, void *item, TickType_t ticks, bool remove) {
+    struct timespec deadline = deadline_after(ticks);
+    bool blocked = false;
+
+    lock();
+    while (queue->count == 0) {
+        if (!blocked && ticks != 0) {
+            blocked = true;
+            port_stats.blocks++;
+        }
+        if (!wait_changed(ticks, &deadline) && queue->count == 0) {
+            unlock();
+            return pdFAIL;
+        }
+    }
+
+    if (queue->item_size > 0 && item != NULL) {
+        memcpy(item, queue->storage + queue->head * queue->item_size, queue->item_size);
+    }
+    if (!remove) {
+        unlock();
+        return pdPASS;
+    }
+    queue->head = (queue->head + 1) % queue->length;
+    queue->count--;
+    unlock_changed();
+    return pdPASS;
+}
+
+BaseType_t xQueueReceive(QueueHandle_t queue, void *item, TickType_t ticks) {
+    return queue_receive(queue, item, ticks, true);
+}
+
+BaseType_t xQueuePeek(QueueHandle_t queue, void *item, TickType_t ticks) {
+    return queue_receive(queue, item, ticks, false);
+}
+
+BaseType_t xQueueReset(QueueHandle_t queue) {
+    lock();
+    queue->head = 0;
+    queue->count = 0;
+    unlock_changed();
+    return pdPASS;
+}
+
+UBaseType_t uxQueueMessagesWaiting(QueueHandle_t queue) {
+    lock();
+    UBaseType_t count = queue->count;
+    unlock();
+    return count;
+}
+
+UBaseType_t uxQueueSpacesAvailable(QueueHandle_t queue) {
+    lock();
+    UBaseType_t spaces = queue->length - queue->count;
+    unlock();
+    return spaces;
+}
+
+SemaphoreHandle_t xSemaphoreCreateBinary(void) {
+    return xQueueCreate(1, 0);
+}
+
+SemaphoreHandle_t xSemaphoreCreateBinaryStatic(StaticSemaphore_t *buffer) {
+    struct port_queue *queue = (struct port_queue *)buffer;
+    queue_init(queue, 1, 0, NULL, false);
+    return queue;
+}
+
+SemaphoreHandle_t xSemaphoreCreateCounting(UBaseType_t max_count, UBaseType_t initial_count) {
+    QueueHandle_t queue = xQueueCreate(max_count, 0);
+    if (queue != NULL) {
+        queue->count = initial_count;
+    }
+    return queue;
+}
+
+SemaphoreHandle_t xSemaphoreCreateMutex(void) {
+    return xSemaphoreCreateCounting(1, 1);
+}
+
+BaseType_t xSemaphoreTake(SemaphoreHandle_t semaphore, TickType_t ticks) {
+    return xQueueReceive(semaphore, NULL, ticks);
+}
+
+BaseType_t xSemaphoreGive(SemaphoreHandle_t semaphore) {
+    return xQueueSend(semaphore, NULL, 0);
+}
+
+/* Stream buffers */
+
+struct port_stream {
+    uint8_t *data;
+    size_t size;
+    size_t trigger_level;
+    size_t head;
+    size_t count;
+};
+
+StreamBufferHandle_t xStreamBufferCreate(size_t size, size_t trigger_level) {
+    struct port_stream *stream = malloc(sizeof(*stream) + size);
+
+    if (stream != NULL) {
+        stream->data = (uint8_t *)(stream + 1);
+        stream->size = size;
+        stream->trigger_level = trigger_level > 0 ? trigger_level : 1;
+        stream->head = 0;
+        stream->count = 0;
+    }
+    return stream;
+}
+
+void vStreamBufferDelete(StreamBufferHandle_t stream) {
+    free(stream);
+}
+
+// Sends what fits, waiting up to `ticks` for room for the rest
+size_t xStreamBufferSend(StreamBufferHandle_t stream, const void *data, size_t length, TickType_t ticks) {
+    struct timespec deadline = deadline_after(ticks);
+    const uint8_t *bytes = data;
+    size_t sent = 0;
+    bool blocked = false;
+
+    lock();
+    while (true) {
+        while (sent < length && stream->count < stream->size) {
+            stream->data[(stream->head + stream->count) % stream->size] = bytes[sent++];
+            stream->count++;
+        }
+        if (sent == length) {
+            break;
+        }
+        if (!blocked && ticks != 0) {
+            blocked = true;
+            port_stats.blocks++;
+        }
+        pthread_cond_broadcast(&kernel_changed);
+        if (!wait_changed(ticks, &deadline) && stream->count == stream->size) {
+            break;
+        }
+    }
+    unlock_changed();
+    return sent;
+}
+
+// Waits up to `ticks` for the trigger level, then takes whatever has arrived
+size_t xStreamBufferReceive(StreamBufferHandle_t stream, void *data, size_t length, TickType_t ticks) {
+    struct timespec deadline = deadline_after(ticks);
+    size_t wanted = length < stream->trigger_level ? length : stream->trigger_level;
+    uint8_t *bytes = data;
+    size_t received = 0;
+    bool blocked = false;
+
+    lock();
+    while (stream->count < wanted) {
+        if (!blocked && ticks != 0) {
+            blocked = true;
+            port_stats.blocks++;
+        }
+        if (!wait_changed(ticks, &deadline)) {
+            break;
+        }
+    }
+    while (received < length && stream->count > 0) {
+        bytes[received++] = stream->data[stream->head];
+        stream->head = (stream->head + 1) % stream->size;
+        stream->count--;
+    }
+    if (received > 0) {
+        unlock_changed();
+    } else {
+        unlock();
+    }
+    return received;
+}
+
+size_t xStreamBufferBytesAvailable(StreamBufferHandle_t stream) {
+    lock();
+    size_t count = stream->count;
+    unlock();
+    return count;
+}
+
+BaseType_t xStreamBufferReset(StreamBufferHandle_t stream) {
+    lock();
+    stream->head = 0;
+    stream->count = 0;
+    unlock_changed();
+    return pdPASS;
+}
+
+/* Timers */
+
+// A service thread runs the callbacks of its timers in due order: one for esp_timer and
+// one standing in for the FreeRTOS timer daemon task
+typedef struct {
+    const char *name;
+    pthread_once_t once;
+    struct port_timer *timers;
+} timer_service_t;
+
+struct port_timer {
+    timer_service_t *service;
+    struct port_timer *next;
+    char name[16];
+    bool armed;
+    bool deleted;
+    int64_t due_us;
+    int64_t period_us; // 0: one-shot
+    esp_timer_cb_t esp_callback;
+    void *arg;
+    TimerCallbackFunction_t callback;
+    void *id;
+    int64_t interval_us; // FreeRTOS timers: the period set at creation or changed since
+    bool auto_reload;
+};
+
+static timer_service_t esp_timer_service = {.name = "esp_timer", .once = PTHREAD_ONCE_INIT};
+static timer_service_t daemon_service = {.name = "Tmr Svc", .once = PTHREAD_ONCE_INIT};
+
+static void timer_service_task(void *arg) {
+    timer_service_t *service = arg;
+
+    pthread_mutex_lock(&kernel_lock);
+    while (true) {
+        struct port_timer *next = NULL;
+        for (struct port_timer *timer = service->timers; timer != NULL; timer = timer->next) {
+            if (timer->armed && (next == NULL || timer->due_us < next->due_us)) {
+                next = timer;
+            }
+        }
+        if (next == NULL) {
+            pthread_cond_wait(&kernel_changed, &kernel_lock);
+            continue;
+        }
+
+        int64_t wait_us = next->due_us - esp_timer_get_time();
+        if (wait_us > 0) {
+            struct timespec deadline = deadline_after_us(wait_us);
+            pthread_cond_timedwait(&kernel_changed, &kernel_lock, &deadline);
+            continue; // The timers may have changed while waiting
+        }
+
+        if (next->period_us > 0) {
+            next->due_us += next->period_us;
+        } else {
+            next->armed = false;
+        }
+        pthread_mutex_unlock(&kernel_lock);
+        if (next->esp_callback != NULL) {
+            next->esp_callback(next->arg);
+        } else {
+            next->callback(next);
+        }
+        pthread_mutex_lock(&kernel_lock);
+    }
+}
+
+static void start_esp_timer_service(void) {
+    xTaskCreate(timer_service_task, esp_timer_service.name, 0, &esp_timer_service, 22, NULL);
+}
+
+static void start_daemon_service(void) {
+    xTaskCreate(timer_service_task, daemon_service.name, 0, &daemon_service, 1, NULL);
+}
+
+static struct port_timer *new_timer(timer_service_t *service, const char *name) {
+    struct port_timer *timer = calloc(1, sizeof(*timer));
+
+    if (timer == NULL) {
+        return NULL;
+    }
+    pthread_once(service == &esp_timer_service ? &esp_timer_service.once : &daemon_service.once,
+                 service == &esp_timer_service ? start_esp_timer_service : start_daemon_service);
+    timer->service = service;
+    snprintf(timer->name, sizeof(timer->name), "%s", name != NULL ? name : "");
+
+    lock();
+    timer->next = service->timers;
+    service->timers = timer;
+    unlock();
+    return timer;
+}
+
+static void timer_arm(struct port_timer *timer, int64_t delay_us, int64_t period_us) {
+    lock();
+    timer->due_us = esp_timer_get_time() + delay_us;
+    timer->period_us = period_us;
+    timer->armed = true;
+    unlock_changed();
+}
+
+static bool timer_disarm(struct port_timer *timer) {
+    lock();
+    bool was_armed = timer->armed;
+    timer->armed = false;
+    unlock_changed();
+    return was_armed;
+}
+
+esp_err_t esp_timer_create(const esp_timer_create_args_t *args, esp_timer_handle_t *out_handle) {
+    if (args == NULL || args->callback == NULL || out_handle == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    struct port_timer *timer = new_timer(&esp_timer_service, args->name);
+    if (timer == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    timer->esp_callback = args->callback;
+    timer->arg = args->arg;
+    *out_handle = timer;
+    return ESP_OK;
+}
+
+esp_err_t esp_timer_start_once(esp_timer_handle_t timer, uint64_t timeout_us) {
+    if (esp_timer_is_active(timer)) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    timer_arm(timer, (int64_t)timeout_us, 0);
+    return ESP_OK;
+}
+
+esp_err_t esp_timer_start_periodic(esp_timer_handle_t timer, uint64_t period_us) {
+    if (esp_timer_is_active(timer)) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    timer_arm(timer, (int64_t)period_us, (int64_t)period_us);
+    return ESP_OK;
+}
+
+esp_err_t esp_timer_stop(esp_timer_handle_t timer) {
+    return timer_disarm(timer) ? ESP_OK : ESP_ERR_INVALID_STATE;
+}
+
+// The timer stays allocated, as its callback may still be running
+esp_err_t esp_timer_delete(esp_timer_handle_t timer) {
+    if (esp_timer_is_active(timer)) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    timer->deleted = true;
+    return ESP_OK;
+}
+
+bool esp_timer_is_active(esp_timer_handle_t timer) {
+    lock();
+    bool armed = timer->armed;
+    unlock();
+    return armed;
+}
+
+TimerHandle_t xTimerCreate(const char *name, TickType_t period, UBaseType_t auto_reload, void *id,
+                           TimerCallbackFunction_t callback) {
+    struct port_timer *timer = new_timer(&daemon_service, name);
+
+    if (timer != NULL) {
+        timer->callback = callback;
+        timer->id = id;
+        timer->interval_us = (int64_t)pdTICKS_TO_MS(period) * 1000;
+        timer->auto_reload = auto_reload;
+    }
+    return timer;
+}
+
+// Starting a running timer restarts it, as in FreeRTOS
+BaseType_t xTimerStart(TimerHandle_t timer, TickType_t ticks) {
+    (void)ticks;
+    timer_arm(timer, timer->interval_us, timer->auto_reload ? timer->interval_us : 0);
+    return pdPASS;
+}
+
+BaseType_t xTimerReset(TimerHandle_t timer, TickType_t ticks) {
+    return xTimerStart(timer, ticks);
+}
+
+BaseType_t xTimerChangePeriod(TimerHandle_t timer, TickType_t period, TickType_t ticks) {
+    timer->interval_us = (int64_t)pdTICKS_TO_MS(period) * 1000;
+    return xTimerStart(timer, ticks);
+}
+
+BaseType_t xTimerStop(TimerHandle_t timer, TickType_t ticks) {
+    (void)ticks;
+    timer_disarm(timer);
+    return pdPASS;
+}
+
+BaseType_t xTimerDelete(TimerHandle_t timer, TickType_t ticks) {
+    (void)ticks;
+    timer_disarm(timer);
+    timer->deleted = true;
+    return pdPASS;
+}
+
+BaseType_t xTimerIsTimerActive(TimerHandle_t timer) {
+    return esp_timer_is_active(timer) ? pdTRUE : pdFALSE;
+}
+
+void *pvTimerGetTimerID(TimerHandle_t timer) {
+    return timer->id;
+}
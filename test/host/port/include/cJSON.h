@@ -0,0 +1,26 @@
+#ifndef CJSON_H
+#define CJSON_H
+
+// Only what the modules under test use to parse and build request bodies; a test linking
+// such a module stubs the calls it makes
+
+typedef int cJSON_bool;
+
+typedef struct cJSON {
+    struct cJSON *next;
+    struct cJSON *prev;
+    struct cJSON *child;
+    int type;
+    char *valuestring;
+    int valueint;
+    double valuedouble;
+    char *string;
+} cJSON;
+
+cJSON *cJSON_Parse(const char *value);
+void cJSON_Delete(cJSON *item);
+cJSON *cJSON_GetObjectItem(const cJSON *object, const char *string);
+cJSON_bool cJSON_IsTrue(const cJSON *item);
+cJSON_bool cJSON_IsNumber(const cJSON *item);
+
+#endif // CJSON_H
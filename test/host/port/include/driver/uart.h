@@ -0,0 +1,9 @@
+#ifndef DRIVER_UART_H
+#define DRIVER_UART_H
+
+// The host builds only run the CAT path over the radio simulator, which needs no UART
+
+#define UART_NUM_1 1
+#define UART_PIN_NO_CHANGE -1
+
+#endif // DRIVER_UART_H
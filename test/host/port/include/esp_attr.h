@@ -0,0 +1,7 @@
+#ifndef ESP_ATTR_H
+#define ESP_ATTR_H
+
+// Everything runs from RAM on the host
+#define IRAM_ATTR
+
+#endif // ESP_ATTR_H
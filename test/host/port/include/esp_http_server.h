@@ -0,0 +1,59 @@
+#ifndef ESP_HTTP_SERVER_H
+#define ESP_HTTP_SERVER_H
+
+#include "esp_err.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+// Only what the modules under test use to declare their endpoints; no server runs on the
+// host, so a test linking such a module stubs the calls it makes
+
+#define HTTPD_RESP_USE_STRLEN -1
+
+typedef enum {
+    HTTP_DELETE = 0,
+    HTTP_GET = 1,
+    HTTP_POST = 3,
+    HTTP_PUT = 4,
+} httpd_method_t;
+
+typedef enum {
+    HTTPD_400_BAD_REQUEST,
+    HTTPD_404_NOT_FOUND,
+    HTTPD_500_INTERNAL_SERVER_ERROR,
+} httpd_err_code_t;
+
+typedef enum {
+    HTTPD_WS_TYPE_CONTINUE = 0x0,
+    HTTPD_WS_TYPE_TEXT = 0x1,
+    HTTPD_WS_TYPE_BINARY = 0x2,
+    HTTPD_WS_TYPE_CLOSE = 0x8,
+    HTTPD_WS_TYPE_PING = 0x9,
+    HTTPD_WS_TYPE_PONG = 0xA,
+} httpd_ws_type_t;
+
+typedef struct {
+    int method;
+    size_t content_len;
+} httpd_req_t;
+
+typedef struct {
+    bool final;
+    bool fragmented;
+    httpd_ws_type_t type;
+    uint8_t *payload;
+    size_t len;
+} httpd_ws_frame_t;
+
+int httpd_req_recv(httpd_req_t *req, char *buf, size_t buf_len);
+esp_err_t httpd_resp_set_status(httpd_req_t *req, const char *status);
+esp_err_t httpd_resp_set_hdr(httpd_req_t *req, const char *field, const char *value);
+esp_err_t httpd_resp_set_type(httpd_req_t *req, const char *type);
+esp_err_t httpd_resp_send(httpd_req_t *req, const char *buf, ssize_t buf_len);
+esp_err_t httpd_resp_send_err(httpd_req_t *req, httpd_err_code_t error, const char *message);
+esp_err_t httpd_ws_recv_frame(httpd_req_t *req, httpd_ws_frame_t *frame, size_t max_len);
+esp_err_t httpd_ws_send_frame(httpd_req_t *req, httpd_ws_frame_t *frame);
+
+#endif // ESP_HTTP_SERVER_H
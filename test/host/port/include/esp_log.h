@@ -0,0 +1,36 @@
+#ifndef ESP_LOG_H
+#define ESP_LOG_H
+
+#include "esp_err.h"
+
+typedef enum {
+    ESP_LOG_NONE,
+    ESP_LOG_ERROR,
+    ESP_LOG_WARN,
+    ESP_LOG_INFO,
+    ESP_LOG_DEBUG,
+    ESP_LOG_VERBOSE,
+} esp_log_level_t;
+
+// Only the "*" tag is honoured; the host level starts at ESP_LOG_WARN, or at
+// ESP_LOG_LEVEL from the environment (0-5)
+void esp_log_level_set(const char *tag, esp_log_level_t level);
+void esp_log_write(esp_log_level_t level, const char *tag, const char *format, ...)
+    __attribute__((format(printf, 3, 4)));
+
+#define ESP_LOGE(tag, format, ...) esp_log_write(ESP_LOG_ERROR, tag, format, ##__VA_ARGS__)
+#define ESP_LOGW(tag, format, ...) esp_log_write(ESP_LOG_WARN, tag, format, ##__VA_ARGS__)
+#define ESP_LOGI(tag, format, ...) esp_log_write(ESP_LOG_INFO, tag, format, ##__VA_ARGS__)
+#define ESP_LOGD(tag, format, ...) esp_log_write(ESP_LOG_DEBUG, tag, format, ##__VA_ARGS__)
+#define ESP_LOGV(tag, format, ...) esp_log_write(ESP_LOG_VERBOSE, tag, format, ##__VA_ARGS__)
+
+#define ESP_ERROR_CHECK(x)                                                                                             \
+    do {                                                                                                               \
+        esp_err_t err_rc_ = (x);                                                                                       \
+        if (err_rc_ != ESP_OK) {                                                                                       \
+            esp_log_write(ESP_LOG_ERROR, "ESP_ERROR_CHECK", "%s failed: %s", #x, esp_err_to_name(err_rc_));            \
+            abort();                                                                                                   \
+        }                                                                                                              \
+    } while (0)
+
+#endif // ESP_LOG_H
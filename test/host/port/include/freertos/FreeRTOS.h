@@ -0,0 +1,40 @@
+#ifndef FREERTOS_H
+#define FREERTOS_H
+
+// FreeRTOS on POSIX threads, for running firmware modules on a Linux host. Tasks are
+// threads and priorities are ignored; with the process on one CPU (see port_init())
+// tasks interleave as on the single-core ESP32-C3, though not in priority order.
+
+#include "sdkconfig.h"
+#include <assert.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+typedef int BaseType_t;
+typedef unsigned int UBaseType_t;
+typedef uint32_t TickType_t;
+
+#define pdTRUE 1
+#define pdFALSE 0
+#define pdPASS pdTRUE
+#define pdFAIL pdFALSE
+#define portMAX_DELAY ((TickType_t)0xffffffffUL)
+#define configTICK_RATE_HZ CONFIG_FREERTOS_HZ
+#define portTICK_PERIOD_MS (1000 / configTICK_RATE_HZ)
+#define pdMS_TO_TICKS(ms) ((TickType_t)(((uint64_t)(ms) * configTICK_RATE_HZ) / 1000))
+#define pdTICKS_TO_MS(ticks) ((uint32_t)(((uint64_t)(ticks) * 1000) / configTICK_RATE_HZ))
+#define configASSERT(x) assert(x)
+
+// Critical sections share one recursive lock, as if interrupts were masked
+typedef int portMUX_TYPE;
+#define portMUX_INITIALIZER_UNLOCKED 0
+void port_enter_critical(void);
+void port_exit_critical(void);
+#define portENTER_CRITICAL(mux) ((void)(mux), port_enter_critical())
+#define portEXIT_CRITICAL(mux) ((void)(mux), port_exit_critical())
+#define portENTER_CRITICAL_ISR(mux) portENTER_CRITICAL(mux)
+#define portEXIT_CRITICAL_ISR(mux) portEXIT_CRITICAL(mux)
+#define portYIELD_FROM_ISR(...) ((void)0)
+
+#endif // FREERTOS_H
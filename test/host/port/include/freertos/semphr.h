@@ -0,0 +1,28 @@
+#ifndef FREERTOS_SEMPHR_H
+#define FREERTOS_SEMPHR_H
+
+#include "freertos/queue.h"
+
+// Semaphores are queues of empty items, as in FreeRTOS. Mutexes have no priority
+// inheritance, since the host ignores priorities.
+
+typedef QueueHandle_t SemaphoreHandle_t;
+
+// Room for a semaphore, for xSemaphoreCreateBinaryStatic()
+typedef struct {
+    void *storage[8];
+} StaticSemaphore_t;
+
+SemaphoreHandle_t xSemaphoreCreateBinary(void);
+SemaphoreHandle_t xSemaphoreCreateBinaryStatic(StaticSemaphore_t *buffer);
+SemaphoreHandle_t xSemaphoreCreateCounting(UBaseType_t max_count, UBaseType_t initial_count);
+SemaphoreHandle_t xSemaphoreCreateMutex(void);
+BaseType_t xSemaphoreTake(SemaphoreHandle_t semaphore, TickType_t ticks);
+BaseType_t xSemaphoreGive(SemaphoreHandle_t semaphore);
+
+#define vSemaphoreDelete(semaphore) vQueueDelete(semaphore)
+#define uxSemaphoreGetCount(semaphore) uxQueueMessagesWaiting(semaphore)
+#define xSemaphoreGiveFromISR(semaphore, woken) ((void)(woken), xSemaphoreGive(semaphore))
+#define xSemaphoreTakeFromISR(semaphore, woken) ((void)(woken), xSemaphoreTake(semaphore, 0))
+
+#endif // FREERTOS_SEMPHR_H
@@ -0,0 +1,17 @@
+#ifndef FREERTOS_STREAM_BUFFER_H
+#define FREERTOS_STREAM_BUFFER_H
+
+#include "freertos/FreeRTOS.h"
+
+typedef struct port_stream *StreamBufferHandle_t;
+
+StreamBufferHandle_t xStreamBufferCreate(size_t size, size_t trigger_level);
+void vStreamBufferDelete(StreamBufferHandle_t stream);
+size_t xStreamBufferSend(StreamBufferHandle_t stream, const void *data, size_t length, TickType_t ticks);
+size_t xStreamBufferReceive(StreamBufferHandle_t stream, void *data, size_t length, TickType_t ticks);
+size_t xStreamBufferBytesAvailable(StreamBufferHandle_t stream);
+BaseType_t xStreamBufferReset(StreamBufferHandle_t stream);
+
+#define xStreamBufferSendFromISR(stream, data, length, woken) ((void)(woken), xStreamBufferSend(stream, data, length, 0))
+
+#endif // FREERTOS_STREAM_BUFFER_H
@@ -0,0 +1,25 @@
+#ifndef FREERTOS_TIMERS_H
+#define FREERTOS_TIMERS_H
+
+#include "freertos/FreeRTOS.h"
+
+// Software timers. Callbacks run in a "Tmr Svc" thread, the timer daemon task.
+
+typedef struct port_timer *TimerHandle_t;
+typedef void (*TimerCallbackFunction_t)(TimerHandle_t timer);
+
+TimerHandle_t xTimerCreate(const char *name, TickType_t period, UBaseType_t auto_reload, void *id,
+                           TimerCallbackFunction_t callback);
+BaseType_t xTimerStart(TimerHandle_t timer, TickType_t ticks);
+BaseType_t xTimerStop(TimerHandle_t timer, TickType_t ticks);
+BaseType_t xTimerReset(TimerHandle_t timer, TickType_t ticks);
+BaseType_t xTimerChangePeriod(TimerHandle_t timer, TickType_t period, TickType_t ticks);
+BaseType_t xTimerDelete(TimerHandle_t timer, TickType_t ticks);
+BaseType_t xTimerIsTimerActive(TimerHandle_t timer);
+void *pvTimerGetTimerID(TimerHandle_t timer);
+
+#define xTimerStartFromISR(timer, woken) ((void)(woken), xTimerStart(timer, 0))
+#define xTimerStopFromISR(timer, woken) ((void)(woken), xTimerStop(timer, 0))
+#define xTimerResetFromISR(timer, woken) ((void)(woken), xTimerReset(timer, 0))
+
+#endif // FREERTOS_TIMERS_H
@@ -0,0 +1,20 @@
+#ifndef HOST_PORT_H
+#define HOST_PORT_H
+
+#include <stdint.h>
+
+// Counters kept by the host port, for benchmarks that compare kernel work
+typedef struct {
+    uint64_t kernel_calls; // Calls on queues, semaphores, stream buffers, notifications and timers
+    uint64_t blocks;       // Calls that found nothing to take and put the task to sleep
+} port_stats_t;
+
+// Pin the process to one CPU, like the single-core ESP32-C3. Call first in main().
+void port_init(void);
+void port_get_stats(port_stats_t *stats);
+void port_reset_stats(void);
+
+// CPU time used by the whole process, all tasks included
+uint64_t port_cpu_time_us(void);
+
+#endif // HOST_PORT_H
@@ -0,0 +1,14 @@
+#ifndef LWIP_SOCKETS_H
+#define LWIP_SOCKETS_H
+
+// lwIP's BSD socket API is the host's own
+
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/select.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#endif // LWIP_SOCKETS_H
@@ -0,0 +1,9 @@
+#ifndef SDKCONFIG_H
+#define SDKCONFIG_H
+
+// Each host test sets the CONFIG_ options it builds with on the compiler command line,
+// see test/host/CMakeLists.txt
+
+#define CONFIG_FREERTOS_HZ 100
+
+#endif // SDKCONFIG_H
@@ -0,0 +1,113 @@
+#include "config.h"
+#include "paddle.h"
+#include "ptt.h"
+#include "settings.h"
+#include "sdkconfig.h"
+#include "sidetone.h"
+#include "timing.h"
+#include <stdio.h>
+#include <string.h>
+
+// The settings of main/settings.c with the same defaults, and NVS kept in RAM, so
+// modules that read settings link without NVS or the web server
+
+int wpm = 20;
+int farnsworth_wpm = 0;
+int dah_ratio = DAH_RATIO_DEFAULT;
+int weight = WEIGHT_DEFAULT;
+char my_call[16] = "";
+int iambic_mode = IAMBIC_B;
+int sidetone_pitch = SIDETONE_PITCH_DEFAULT;
+int sidetone_volume = SIDETONE_VOLUME_DEFAULT;
+int paddle_memory = 1;
+int ptt_enabled = 0;
+int ptt_lead_ms = PTT_LEAD_DEFAULT_MS;
+int ptt_tail_ms = PTT_TAIL_DEFAULT_MS;
+int ptt_hang_ms = PTT_HANG_DEFAULT_MS;
+char ap_ssid[32] = "cw_keyer";
+char ap_password[64] = "";
+char sta_ssid[32] = "";
+char sta_password[64] = "";
+int tune_power = 5;
+
+#ifdef CONFIG_RADIO_PROTOCOL_FT857D
+int baud_rate = 4800;
+#else
+int baud_rate = 38400;
+#endif
+
+#define NVS_ENTRIES 32
+#define NVS_VALUE_SIZE 256
+
+typedef struct {
+    char key[16];
+    size_t length;
+    uint8_t value[NVS_VALUE_SIZE];
+} nvs_entry_t;
+
+static nvs_entry_t nvs[NVS_ENTRIES];
+static int nvs_count = 0;
+
+static nvs_entry_t *find(const char *key, bool create) {
+    for (int i = 0; i < nvs_count; i++) {
+        if (strcmp(nvs[i].key, key) == 0) {
+            return &nvs[i];
+        }
+    }
+    if (!create || nvs_count == NVS_ENTRIES) {
+        return NULL;
+    }
+    snprintf(nvs[nvs_count].key, sizeof(nvs[nvs_count].key), "%s", key);
+    return &nvs[nvs_count++];
+}
+
+esp_err_t set_blob(const char *key, const void *value, size_t length) {
+    nvs_entry_t *entry = find(key, true);
+    if (entry == NULL || length > NVS_VALUE_SIZE) {
+        return ESP_ERR_NO_MEM;
+    }
+    memcpy(entry->value, value, length);
+    entry->length = length;
+    return ESP_OK;
+}
+
+esp_err_t get_blob(const char *key, void *value, size_t *length) {
+    nvs_entry_t *entry = find(key, false);
+    if (entry == NULL) {
+        return ESP_ERR_NOT_FOUND;
+    }
+    if (value != NULL) {
+        if (*length < entry->length) {
+            return ESP_ERR_INVALID_SIZE;
+        }
+        memcpy(value, entry->value, entry->length);
+    }
+    *length = entry->length;
+    return ESP_OK;
+}
+
+esp_err_t set_u8(const char *key, uint8_t value) {
+    return set_blob(key, &value, sizeof(value));
+}
+
+esp_err_t get_u8(const char *key, uint8_t *value) {
+    size_t length = sizeof(*value);
+    return get_blob(key, value, &length);
+}
+
+esp_err_t set_u32(const char *key, uint32_t value) {
+    return set_blob(key, &value, sizeof(value));
+}
+
+esp_err_t get_u32(const char *key, uint32_t *value) {
+    size_t length = sizeof(*value);
+    return get_blob(key, value, &length);
+}
+
+esp_err_t set_string(const char *key, const char *value) {
+    return set_blob(key, value, strlen(value) + 1);
+}
+
+esp_err_t get_string(const char *key, char *value, size_t max_len) {
+    return get_blob(key, value, &max_len);
+}
@@ -0,0 +1,41 @@
+#ifndef TEST_H
+#define TEST_H
+
+#include <stdbool.h>
+#include <stdio.h>
+
+// Checks for the host tests: a failed check is reported and the test carries on, and
+// main() returns test_result() so ctest sees the failure
+
+static int test_failures = 0;
+
+#define CHECK(condition) test_check((condition), #condition, __FILE__, __LINE__)
+#define CHECK_EQ(actual, expected)                                                                                     \
+    test_check_eq((long long)(actual), (long long)(expected), #actual, __FILE__, __LINE__)
+
+static inline bool test_check(bool ok, const char *condition, const char *file, int line) {
+    if (!ok) {
+        printf("%s:%d: check failed: %s\n", file, line, condition);
+        test_failures++;
+    }
+    return ok;
+}
+
+static inline bool test_check_eq(long long actual, long long expected, const char *what, const char *file, int line) {
+    if (actual != expected) {
+        printf("%s:%d: %s is %lld, expected %lld\n", file, line, what, actual, expected);
+        test_failures++;
+    }
+    return actual == expected;
+}
+
+static inline int test_result(void) {
+    if (test_failures > 0) {
+        printf("%d check(s) failed\n", test_failures);
+        return 1;
+    }
+    printf("All checks passed\n");
+    return 0;
+}
+
+#endif // TEST_H
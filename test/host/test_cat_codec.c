@@ -0,0 +1,238 @@
+// CAT codec: encoded text frames and BCD round-trip for random values, widths and bases
+// and agree with snprintf; decoding random bytes agrees with a reference parser; nothing
+// is written past the caller's buffer. Then a microbenchmark against snprintf and sscanf,
+// which the codec replaced.
+
+#include "cat_codec.h"
+#include "esp_timer.h"
+#include "test.h"
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define ROUNDS 200000
+#define BENCH_ROUNDS 1000000
+
+// Fixed seed, so a failure repeats
+static uint32_t rng_state = 0x2545F491;
+
+static uint32_t rng(void) {
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 17;
+    rng_state ^= rng_state << 5;
+    return rng_state;
+}
+
+static const char *const prefixes[] = {"FA", "FB", "MD0", "PC", "IF", "MC", "AI", "TX", ""};
+#define PREFIX_COUNT (sizeof(prefixes) / sizeof(prefixes[0]))
+
+// Largest value `digits` digits of `base` hold, capped to 32 bits
+static uint32_t field_max(int digits, int base) {
+    uint64_t max = 1;
+    for (int i = 0; i < digits && max <= UINT32_MAX; i++) {
+        max *= base;
+    }
+    return max - 1 > UINT32_MAX ? UINT32_MAX : (uint32_t)(max - 1);
+}
+
+static void fuzz_text_round_trip(void) {
+    char frame[32];
+    char expected[32];
+
+    for (int i = 0; i < ROUNDS; i++) {
+        const char *prefix = prefixes[rng() % PREFIX_COUNT];
+        int base = rng() & 1 ? CODEC_HEX : CODEC_DECIMAL;
+        int digits = rng() % (base == CODEC_HEX ? 9 : 11);
+        uint32_t max = field_max(digits, base);
+        uint32_t value = max == UINT32_MAX ? rng() : rng() % (max + 1);
+
+        size_t length = codec_encode_text(frame, sizeof(frame), prefix, value, digits, base);
+        snprintf(expected, sizeof(expected), base == CODEC_HEX ? "%s%0*" PRIX32 ";" : "%s%0*" PRIu32 ";", prefix,
+                 digits, value);
+        if (digits == 0) {
+            snprintf(expected, sizeof(expected), "%s;", prefix); // A zero width still prints a 0
+        }
+        if (!CHECK_EQ(length, strlen(expected)) || !CHECK(strcmp(frame, expected) == 0)) {
+            printf("Encoding %" PRIu32 " in %d digits of base %d: \"%s\", expected \"%s\"\n", value, digits, base,
+                   frame, expected);
+            return;
+        }
+
+        uint32_t decoded = ~value;
+        CHECK(codec_text_has_prefix(frame, length, prefix));
+        CHECK(codec_decode_text_field(frame, length, strlen(prefix), digits, base, &decoded));
+        if (digits > 0 && !CHECK_EQ(decoded, value)) {
+            return;
+        }
+
+        // One more than the field holds is refused
+        if (max < UINT32_MAX) {
+            CHECK_EQ(codec_encode_text(frame, sizeof(frame), prefix, max + 1, digits, base), 0);
+        }
+    }
+}
+
+// A buffer too small for the frame is refused and not written past
+static void fuzz_text_buffer_size(void) {
+    char buffer[40];
+
+    for (int i = 0; i < ROUNDS; i++) {
+        const char *prefix = prefixes[rng() % PREFIX_COUNT];
+        int digits = rng() % 11;
+        size_t needed = strlen(prefix) + digits + 2;
+        size_t size = rng() % (needed + 1);
+
+        memset(buffer, 0x5A, sizeof(buffer));
+        size_t length = codec_encode_text(buffer, size, prefix, 0, digits, CODEC_DECIMAL);
+        CHECK_EQ(length, size < needed ? 0 : needed - 1);
+        for (size_t j = size; j < sizeof(buffer); j++) {
+            if (!CHECK_EQ(buffer[j], 0x5A)) {
+                printf("Wrote byte %zu of a %zu-byte buffer\n", j, size);
+                return;
+            }
+        }
+    }
+}
+
+// What the decoder should make of a field: each character a digit of the base, and the
+// whole value within 32 bits
+static bool reference_decode(const char *field, int digits, int base, uint32_t *value) {
+    char copy[16];
+    memcpy(copy, field, digits);
+    copy[digits] = '\0';
+
+    for (int i = 0; i < digits; i++) {
+        char c = copy[i];
+        bool ok = (c >= '0' && c <= '9') || (base == 16 && ((c >= 'A' && c <= 'F') || (c >= 'a' && c <= 'f')));
+        if (!ok) {
+            return false;
+        }
+    }
+    unsigned long long result = digits > 0 ? strtoull(copy, NULL, base) : 0;
+    if (result > UINT32_MAX) {
+        return false;
+    }
+    *value = (uint32_t)result;
+    return true;
+}
+
+static void fuzz_text_decode(void) {
+    static const char alphabet[] = "0123456789ABCDEFabcdefGZ;+- \xff";
+    char frame[16];
+
+    for (int i = 0; i < ROUNDS; i++) {
+        size_t length = rng() % sizeof(frame);
+        for (size_t j = 0; j < length; j++) {
+            // Mostly digits, so that long valid fields come up
+            frame[j] = rng() % 4 ? '0' + rng() % 10 : alphabet[rng() % (sizeof(alphabet) - 1)];
+        }
+        size_t offset = rng() % 4;
+        int digits = rng() % 11;
+        int base = rng() & 1 ? CODEC_HEX : CODEC_DECIMAL;
+
+        uint32_t value = 0;
+        uint32_t expected = 0;
+        bool ok = codec_decode_text_field(frame, length, offset, digits, base, &value);
+        bool expected_ok = offset + digits <= length && reference_decode(&frame[offset], digits, base, &expected);
+        if (!CHECK_EQ(ok, expected_ok) || (ok && !CHECK_EQ(value, expected))) {
+            printf("Decoding \"%.*s\" at %zu, %d digits of base %d\n", (int)length, frame, offset, digits, base);
+            return;
+        }
+    }
+}
+
+static void fuzz_bcd(void) {
+    uint8_t bcd[5];
+    char digits[16];
+
+    for (int i = 0; i < ROUNDS; i++) {
+        size_t length = 1 + rng() % sizeof(bcd);
+        uint32_t max = field_max(2 * length, 10);
+        uint32_t value = max == UINT32_MAX ? rng() : rng() % (max + 1);
+
+        // Each nibble is the matching decimal digit
+        codec_encode_bcd(value, bcd, length);
+        snprintf(digits, sizeof(digits), "%0*" PRIu32, (int)(2 * length), value);
+        for (size_t j = 0; j < length; j++) {
+            if (!CHECK_EQ(bcd[j], (digits[2 * j] - '0') << 4 | (digits[2 * j + 1] - '0'))) {
+                printf("BCD of %" PRIu32 " in %zu bytes\n", value, length);
+                return;
+            }
+        }
+
+        uint32_t decoded = ~value;
+        CHECK(codec_decode_bcd(bcd, length, &decoded));
+        if (!CHECK_EQ(decoded, value)) {
+            return;
+        }
+
+        // Random bytes decode only if every nibble is a decimal digit and the value fits
+        bool valid = true;
+        uint64_t reference = 0;
+        for (size_t j = 0; j < length; j++) {
+            bcd[j] = rng();
+            valid &= (bcd[j] >> 4) <= 9 && (bcd[j] & 0x0F) <= 9;
+            reference = reference * 100 + (bcd[j] >> 4) * 10 + (bcd[j] & 0x0F);
+        }
+        valid &= reference <= UINT32_MAX;
+        bool ok = codec_decode_bcd(bcd, length, &decoded);
+        if (!CHECK_EQ(ok, valid) || (ok && !CHECK_EQ(decoded, reference))) {
+            return;
+        }
+    }
+}
+
+// Sink for benchmark results, so the compiler keeps the work
+static volatile uint32_t sink;
+
+static double ns_per_call(int64_t start_us) {
+    return (double)(esp_timer_get_time() - start_us) * 1000 / BENCH_ROUNDS;
+}
+
+static void benchmark(void) {
+    char frame[32];
+    uint32_t value;
+
+    int64_t start_us = esp_timer_get_time();
+    for (uint32_t i = 0; i < BENCH_ROUNDS; i++) {
+        sink += codec_encode_text(frame, sizeof(frame), "FA", 14074000 + i, 9, CODEC_DECIMAL);
+    }
+    double encode_ns = ns_per_call(start_us);
+
+    start_us = esp_timer_get_time();
+    for (uint32_t i = 0; i < BENCH_ROUNDS; i++) {
+        sink += snprintf(frame, sizeof(frame), "FA%09" PRIu32 ";", 14074000 + i);
+    }
+    double snprintf_ns = ns_per_call(start_us);
+
+    start_us = esp_timer_get_time();
+    for (uint32_t i = 0; i < BENCH_ROUNDS; i++) {
+        frame[10] = '0' + i % 10;
+        if (codec_decode_text_field(frame, 12, 2, 9, CODEC_DECIMAL, &value)) {
+            sink += value;
+        }
+    }
+    double decode_ns = ns_per_call(start_us);
+
+    start_us = esp_timer_get_time();
+    for (uint32_t i = 0; i < BENCH_ROUNDS; i++) {
+        frame[10] = '0' + i % 10;
+        if (sscanf(frame, "FA%9" SCNu32 ";", &value) == 1) {
+            sink += value;
+        }
+    }
+    double sscanf_ns = ns_per_call(start_us);
+
+    printf("Encode \"FA014074000;\": codec %.1f ns, snprintf %.1f ns\n", encode_ns, snprintf_ns);
+    printf("Decode \"FA014074000;\": codec %.1f ns, sscanf %.1f ns\n", decode_ns, sscanf_ns);
+}
+
+int main(void) {
+    fuzz_text_round_trip();
+    fuzz_text_buffer_size();
+    fuzz_text_decode();
+    fuzz_bcd();
+    benchmark();
+    return test_result();
+}
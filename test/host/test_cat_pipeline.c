@@ -0,0 +1,317 @@
+// Pipelined memory channel transfers with the FT-991A driver over a simulated line that
+// loses reply bytes. MW commands are checked field by field before anything is sent.
+// Then backup-style reads run until the pipeline has lost its place several times. A
+// read may fail, but it must never return another channel's data. The reads after a
+// loss must still be answered. Pipelined writes must be paced by the line, though
+// nothing answers them. Last, a write the radio refuses is caught by reading the channel
+// back, as the restore does, and the write behind it still reads back as written.
+
+#include "cat.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+#include "host_port.h"
+#include "radio.h"
+#include "test.h"
+#include <string.h>
+
+#define CHANNELS 40      // Programmed by the simulator at power on, channel n at 7 MHz + n kHz
+#define MIN_LOSSES 3     // Timeouts that fail the pipeline, to see it recover each time
+#define MAX_PASSES 50
+#define READ_ATTEMPTS 3  // As the backup makes
+#define WRITE_CHANNEL 50 // Empty until written
+#define PACED_WRITES 12  // To channels from WRITE_CHANNEL + 1 on
+#define REFUSED_CHANNEL 5 // Programmed, and left so by a refused write
+#define RESTORED_CHANNEL (WRITE_CHANNEL + PACED_WRITES + 1)
+#define BAUD_RATE 38400
+// No more than the client's queue holds, however late the CAT task takes them
+#define IN_FLIGHT CAT_CLIENT_QUEUE_LENGTH
+
+static SemaphoreHandle_t results;
+static volatile int ok_count;
+static volatile int failed_count;
+static volatile int wrong_count;
+static volatile bool read_ok[CHANNELS + 1];
+
+static bool wait_for_radio(void) {
+    uint32_t frequency;
+    for (int i = 0; i < 50; i++) {
+        if (get_frequency(&frequency) == ESP_OK) {
+            return true;
+        }
+        vTaskDelay(pdMS_TO_TICKS(100));
+    }
+    return false;
+}
+
+// `valid` with one field changed must be refused
+#define CHECK_REFUSED(field, value)                                                                                   \
+    do {                                                                                                               \
+        radio_memory_t memory = valid;                                                                                 \
+        cat_request_t request;                                                                                         \
+        memory.field = value;                                                                                          \
+        CHECK_EQ(memory_write_request(&memory, &request), ESP_ERR_INVALID_ARG);                                        \
+    } while (0)
+
+static void check_write_request(void) {
+    const radio_memory_t valid = {
+        .channel = 1,
+        .frequency = 7030000,
+        .clarifier = -120,
+        .mode = 3,
+        .flags = RADIO_MEMORY_RX_CLARIFIER,
+        .tone = 4,
+        .shift = 2,
+    };
+    cat_request_t request;
+
+    CHECK_EQ(memory_write_request(&valid, &request), ESP_OK);
+    CHECK_EQ(request.command_size, 28);
+    CHECK(memcmp(request.command, "MW001007030000-012010304002;", 28) == 0);
+
+    // Each field just past its range
+    CHECK_REFUSED(channel, 0);
+    CHECK_REFUSED(channel, memory_channel_count() + 1);
+    CHECK_REFUSED(frequency, 29999);
+    CHECK_REFUSED(frequency, 470000001);
+    CHECK_REFUSED(frequency, 1000000000); // Ten digits
+    CHECK_REFUSED(clarifier, 10000);
+    CHECK_REFUSED(clarifier, -10000);
+    CHECK_REFUSED(mode, 0);
+    CHECK_REFUSED(mode, 0xF);
+    CHECK_REFUSED(tone, 5);
+    CHECK_REFUSED(shift, 3);
+}
+
+static void read_done(esp_err_t result, const uint8_t *response, size_t length, void *arg) {
+    uint16_t channel = (uintptr_t)arg;
+    radio_memory_t memory;
+
+    if (memory_decode(channel, result, response, length, &memory) != ESP_OK) {
+        failed_count++;
+    } else if (memory.channel != channel || memory.frequency != 7000000 + channel * 1000 || memory.mode != 3) {
+        wrong_count++;
+    } else {
+        ok_count++;
+        read_ok[channel] = true;
+    }
+    xSemaphoreGive(results);
+}
+
+static void write_done(esp_err_t result, const uint8_t *response, size_t length, void *arg) {
+    if (result != ESP_OK) {
+        failed_count++;
+    }
+    xSemaphoreGive(results);
+}
+
+// Writes get no reply, but each stays in the window until it has crossed the line, so a
+// run of them finishes no sooner than the line can carry it
+static void check_write_pacing(void) {
+    size_t bytes = 0;
+    int in_flight = 0;
+    int failed = failed_count;
+    int64_t start_us = esp_timer_get_time();
+
+    for (int i = 0; i < PACED_WRITES || in_flight > 0;) {
+        if (i < PACED_WRITES && in_flight < IN_FLIGHT) {
+            radio_memory_t memory = {.channel = WRITE_CHANNEL + 1 + i, .frequency = 7100000, .mode = 3};
+            cat_request_t request;
+            CHECK_EQ(memory_write_request(&memory, &request), ESP_OK);
+            request.callback = write_done;
+            bytes += request.command_size;
+            if (!CHECK_EQ(cat_submit(&request), ESP_OK)) {
+                return;
+            }
+            i++;
+            in_flight++;
+        } else if (CHECK(xSemaphoreTake(results, pdMS_TO_TICKS(10000)) == pdTRUE)) {
+            in_flight--;
+        } else {
+            return;
+        }
+    }
+
+    int64_t elapsed_us = esp_timer_get_time() - start_us;
+    int64_t line_us = (int64_t)bytes * 10 * 1000000 / BAUD_RATE;
+    printf("%d writes done in %lld us, %lld us on the line\n", PACED_WRITES, (long long)elapsed_us, (long long)line_us);
+    CHECK(elapsed_us >= line_us);
+    CHECK_EQ(failed_count, failed);
+}
+
+typedef struct {
+    esp_err_t result;
+    radio_memory_t memory;
+} read_back_t;
+
+static read_back_t read_backs[2];
+
+static void read_back_done(esp_err_t result, const uint8_t *response, size_t length, void *arg) {
+    uint16_t index = (uintptr_t)arg;
+    read_back_t *read_back = &read_backs[index];
+
+    read_back->result = memory_decode(index == 0 ? REFUSED_CHANNEL : RESTORED_CHANNEL, result, response, length,
+                                      &read_back->memory);
+    xSemaphoreGive(results);
+}
+
+static bool submit_write(radio_memory_t *memory, bool refused) {
+    cat_request_t request;
+
+    if (!CHECK_EQ(memory_write_request(memory, &request), ESP_OK)) {
+        return false;
+    }
+    if (refused) {
+        memcpy(request.command + 5, "000000001", 9); // Below the radio's range; the driver would refuse it
+    }
+    request.callback = write_done;
+    return CHECK_EQ(cat_submit(&request), ESP_OK);
+}
+
+static bool submit_read_back(uint16_t channel, int index) {
+    cat_request_t request;
+
+    memory_read_request(channel, &request);
+    request.callback = read_back_done;
+    request.arg = (void *)(uintptr_t)index;
+    return CHECK_EQ(cat_submit(&request), ESP_OK);
+}
+
+// The restore's pairs of write and read-back: the refused write answers "?;", so its
+// read-back fails or finds the channel as it was, and the next pair is not put out of step
+static void check_refused_write(void) {
+    radio_memory_t refused = {.channel = REFUSED_CHANNEL, .frequency = 7100000, .mode = 3};
+    radio_memory_t restored = {.channel = RESTORED_CHANNEL, .frequency = 21074000, .mode = 2};
+    bool refused_seen = false;
+    bool restored_seen = false;
+
+    for (int attempt = 0; attempt < READ_ATTEMPTS && !restored_seen; attempt++) {
+        if (!submit_write(&refused, true) || !submit_read_back(REFUSED_CHANNEL, 0) ||
+            !submit_write(&restored, false) || !submit_read_back(RESTORED_CHANNEL, 1)) {
+            return;
+        }
+        for (int i = 0; i < 4; i++) {
+            if (!CHECK(xSemaphoreTake(results, pdMS_TO_TICKS(10000)) == pdTRUE)) {
+                return;
+            }
+        }
+
+        const radio_memory_t *read = &read_backs[0].memory;
+        refused_seen |= read_backs[0].result != ESP_OK || read->frequency != refused.frequency;
+        read = &read_backs[1].memory;
+        restored_seen = read_backs[1].result == ESP_OK && read->channel == restored.channel &&
+                        read->frequency == restored.frequency && read->mode == restored.mode;
+        CHECK(read_backs[1].result != ESP_OK || read->channel == restored.channel);
+    }
+    printf("Refused write %s, the next write %s\n", refused_seen ? "caught" : "missed",
+           restored_seen ? "read back as written" : "never read back");
+    CHECK(refused_seen);
+    CHECK(restored_seen);
+}
+
+// Read every channel with IN_FLIGHT submitted at a time, as the backup does
+static bool read_channels(void) {
+    int in_flight = 0;
+
+    for (uint16_t channel = 1; channel <= CHANNELS || in_flight > 0;) {
+        if (channel <= CHANNELS && in_flight < IN_FLIGHT) {
+            cat_request_t request;
+            memory_read_request(channel, &request);
+            request.callback = read_done;
+            request.arg = (void *)(uintptr_t)channel;
+            if (!CHECK_EQ(cat_submit(&request), ESP_OK)) {
+                return false;
+            }
+            channel++;
+            in_flight++;
+        } else if (CHECK(xSemaphoreTake(results, pdMS_TO_TICKS(10000)) == pdTRUE)) {
+            in_flight--;
+        } else {
+            return false; // A request never completed
+        }
+    }
+    return true;
+}
+
+// With up to READ_ATTEMPTS reads of a channel, as the backup makes, every channel comes
+// through the lossy line
+static void check_retries(void) {
+    int missing = 0;
+
+    memset((void *)read_ok, 0, sizeof(read_ok));
+    for (int attempt = 0; attempt < READ_ATTEMPTS && read_channels(); attempt++) {
+        missing = 0;
+        for (uint16_t channel = 1; channel <= CHANNELS; channel++) {
+            missing += !read_ok[channel];
+        }
+        if (missing == 0) {
+            break;
+        }
+    }
+    printf("%d channels still unread after %d attempts\n", missing, READ_ATTEMPTS);
+    CHECK_EQ(missing, 0);
+}
+
+static void check_losses(void) {
+    cat_stats_t before, after;
+    int passes = 0;
+
+    cat_get_stats(&before);
+    after = before;
+    while (after.timeouts - before.timeouts < MIN_LOSSES && passes < MAX_PASSES && read_channels()) {
+        passes++;
+        cat_get_stats(&after);
+    }
+
+    printf("%d reads in %d passes: %d good, %d failed, %d wrong; %lu timeouts, %lu unmatched frames\n",
+           passes * CHANNELS, passes, ok_count, failed_count, wrong_count,
+           (unsigned long)(after.timeouts - before.timeouts), (unsigned long)(after.unmatched - before.unmatched));
+    CHECK(after.timeouts - before.timeouts >= MIN_LOSSES);
+    CHECK_EQ(wrong_count, 0);
+    CHECK(ok_count > failed_count);
+
+    // Back in step: the radio is still answered after the last loss
+    CHECK(wait_for_radio());
+}
+
+// A pipelined write, read back until a reply survives the line
+static void check_write_read_back(void) {
+    radio_memory_t memory = {.channel = WRITE_CHANNEL, .frequency = 14074000, .mode = 2, .tone = 1, .shift = 1};
+    cat_request_t request;
+    uint8_t response[CAT_RESPONSE_MAX_SIZE];
+    size_t length;
+    radio_memory_t read = {0};
+    esp_err_t err = ESP_FAIL;
+
+    CHECK_EQ(memory_write_request(&memory, &request), ESP_OK);
+    CHECK_EQ(cat_transact(&request, response, sizeof(response), &length), ESP_OK);
+    for (int i = 0; i < 10 && err != ESP_OK; i++) {
+        CHECK_EQ(memory_read_request(WRITE_CHANNEL, &request), ESP_OK);
+        esp_err_t result = cat_transact(&request, response, sizeof(response), &length);
+        err = memory_decode(WRITE_CHANNEL, result, response, length, &read);
+    }
+    CHECK_EQ(err, ESP_OK);
+    CHECK_EQ(read.frequency, memory.frequency);
+    CHECK_EQ(read.mode, memory.mode);
+    CHECK_EQ(read.tone, memory.tone);
+    CHECK_EQ(read.shift, memory.shift);
+}
+
+int main(void) {
+    port_init();
+    CHECK_EQ(init_radio(), ESP_OK);
+    cat_register_client("test", CAT_PRIORITY_NORMAL);
+    results = xSemaphoreCreateCounting(CHANNELS, 0);
+
+    check_write_request();
+    if (!CHECK(wait_for_radio())) {
+        return test_result();
+    }
+    check_losses();
+    check_retries();
+    check_write_read_back();
+    check_write_pacing();
+    check_refused_write();
+    return test_result();
+}
@@ -0,0 +1,187 @@
+// Cost of the CAT receive path per response: the per-byte queue cat.c used to have
+// against the stream buffer it has now. A stand-in for the UART event task hands each
+// reply over in UART_DATA-sized chunks, and the reader frames it up to the ';'.
+//
+// Both readers are copies: the queue path as it was before the stream buffer went in,
+// and the stream path as receive_bytes(), read_some() and recv_frame() in cat.c, without
+// the statistics. Kernel calls and blocks are counted by the host port; a block is a
+// reader or writer going to sleep, which is a context switch on the radio. The host
+// schedules threads rather than FreeRTOS priorities, so blocks are an upper bound.
+
+#include "esp_err.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+#include "freertos/stream_buffer.h"
+#include "freertos/task.h"
+#include "host_port.h"
+#include "test.h"
+#include <string.h>
+
+#define RESPONSES 2000
+#define BUF_SIZE 1024
+#define RESPONSE_TIMEOUT_MS 1000
+
+typedef enum {
+    PATH_QUEUE,
+    PATH_STREAM,
+} path_t;
+
+typedef struct {
+    const char *reply;
+    size_t chunk_size; // Bytes per UART_DATA event
+} scenario_t;
+
+static path_t path;
+static const scenario_t *scenario;
+static TaskHandle_t uart_task_handle;
+
+// The queue path: one item per byte
+static QueueHandle_t data_queue;
+
+static esp_err_t queue_recv_until(uint8_t *response, size_t response_size, char terminator) {
+    size_t i = 0;
+    while (i < response_size) {
+        if (xQueueReceive(data_queue, &response[i], pdMS_TO_TICKS(RESPONSE_TIMEOUT_MS)) != pdPASS) {
+            return ESP_FAIL;
+        }
+        if (response[i] == terminator) {
+            response[i + 1] = '\0';
+            return ESP_OK;
+        }
+        i++;
+    }
+    return ESP_FAIL;
+}
+
+// The stream path: one send per chunk, reads take whatever has arrived
+static StreamBufferHandle_t rx_stream;
+static uint8_t carry[BUF_SIZE];
+static size_t carry_length = 0;
+
+static size_t read_some(uint8_t *buffer, size_t size, TickType_t deadline) {
+    if (carry_length > 0) {
+        size_t n = carry_length < size ? carry_length : size;
+        memcpy(buffer, carry, n);
+        memmove(carry, carry + n, carry_length - n);
+        carry_length -= n;
+        return n;
+    }
+
+    int32_t remaining = (int32_t)(deadline - xTaskGetTickCount());
+    TickType_t wait = remaining > 0 ? (TickType_t)remaining : 0;
+    return xStreamBufferReceive(rx_stream, buffer, size, wait);
+}
+
+static esp_err_t stream_recv_frame(uint8_t *response, size_t response_size, char terminator) {
+    TickType_t deadline = xTaskGetTickCount() + pdMS_TO_TICKS(RESPONSE_TIMEOUT_MS);
+    size_t received = 0;
+
+    while (received < response_size - 1) {
+        size_t n = read_some(response + received, response_size - 1 - received, deadline);
+        if (n == 0) {
+            return ESP_ERR_TIMEOUT;
+        }
+
+        uint8_t *end = memchr(response + received, terminator, n);
+        received += n;
+        if (end != NULL) {
+            size_t used = end - response + 1;
+            size_t leftover = received - used;
+            memmove(carry + leftover, carry, carry_length);
+            memcpy(carry, response + used, leftover);
+            carry_length += leftover;
+            response[used] = '\0';
+            return ESP_OK;
+        }
+    }
+    return ESP_ERR_INVALID_SIZE;
+}
+
+// Stands in for the UART event task: each notification is a command sent, answered by
+// the reply in chunks
+static void uart_event_task(void *arg) {
+    while (1) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+
+        // Taken once, as the reader may move on to the next scenario before this loop ends
+        path_t current = path;
+        size_t chunk_size = scenario->chunk_size;
+        const uint8_t *reply = (const uint8_t *)scenario->reply;
+        size_t length = strlen(scenario->reply);
+        for (size_t offset = 0; offset < length; offset += chunk_size) {
+            size_t len = length - offset < chunk_size ? length - offset : chunk_size;
+            if (current == PATH_QUEUE) {
+                for (size_t i = 0; i < len; i++) {
+                    xQueueSend(data_queue, &reply[offset + i], portMAX_DELAY);
+                }
+            } else {
+                xStreamBufferSend(rx_stream, &reply[offset], len, 0);
+            }
+        }
+    }
+}
+
+typedef struct {
+    double kernel_calls;
+    double blocks;
+    double cpu_us;
+} cost_t;
+
+static cost_t measure(path_t which, const scenario_t *s) {
+    uint8_t response[64];
+    path = which;
+    scenario = s;
+
+    port_reset_stats();
+    uint64_t cpu_start_us = port_cpu_time_us();
+    for (int i = 0; i < RESPONSES; i++) {
+        xTaskNotifyGive(uart_task_handle);
+        esp_err_t err = which == PATH_QUEUE ? queue_recv_until(response, sizeof(response), ';')
+                                            : stream_recv_frame(response, sizeof(response), ';');
+        if (!CHECK_EQ(err, ESP_OK) || !CHECK(strcmp((char *)response, s->reply) == 0)) {
+            break;
+        }
+    }
+    uint64_t cpu_us = port_cpu_time_us() - cpu_start_us;
+
+    port_stats_t stats;
+    port_get_stats(&stats);
+    return (cost_t){
+        .kernel_calls = (double)stats.kernel_calls / RESPONSES,
+        .blocks = (double)stats.blocks / RESPONSES,
+        .cpu_us = (double)cpu_us / RESPONSES,
+    };
+}
+
+int main(void) {
+    port_init();
+
+    data_queue = xQueueCreate(BUF_SIZE, sizeof(uint8_t));
+    rx_stream = xStreamBufferCreate(BUF_SIZE, 1);
+    CHECK(data_queue != NULL && rx_stream != NULL);
+    CHECK_EQ(xTaskCreate(uart_event_task, "uart_event_task", 2048, NULL, 12, &uart_task_handle), pdPASS);
+
+    // A frequency read, and the 28-byte IF status, whole and in the 8-byte pieces a slow
+    // line gives when the UART's receive timeout fires between bytes
+    static const scenario_t scenarios[] = {
+        {"FA014074000;", 64},
+        {"IF001014074000+000000C00000;", 64},
+        {"IF001014074000+000000C00000;", 8},
+    };
+
+    printf("%-30s %5s  %14s  %14s  %14s\n", "reply", "chunk", "kernel calls", "blocks", "CPU us");
+    for (size_t i = 0; i < sizeof(scenarios) / sizeof(scenarios[0]); i++) {
+        cost_t before = measure(PATH_QUEUE, &scenarios[i]);
+        cost_t after = measure(PATH_STREAM, &scenarios[i]);
+        printf("%-30s %5zu  %6.1f -> %5.1f  %6.1f -> %5.1f  %6.1f -> %5.1f\n", scenarios[i].reply,
+               scenarios[i].chunk_size, before.kernel_calls, after.kernel_calls, before.blocks, after.blocks,
+               before.cpu_us, after.cpu_us);
+
+        // Two calls a byte against a send a chunk and a read or two: the counts do not
+        // depend on scheduling, so this holds on any host
+        size_t chunks = (strlen(scenarios[i].reply) + scenarios[i].chunk_size - 1) / scenarios[i].chunk_size;
+        CHECK(before.kernel_calls >= 2 * strlen(scenarios[i].reply));
+        CHECK(after.kernel_calls <= 2 + 3 * chunks + 1);
+    }
+    return test_result();
+}
@@ -0,0 +1,219 @@
+// The CAT engine and the radio driver against the simulated radio, built once per
+// protocol: reads and writes round-trip, then benchmarks of back-to-back reads,
+// pipelined memory reads (FT-991A) and the tune sequence behind a long press.
+//
+// Each transaction should take the line time of the command and its reply plus the
+// radio's latency, and only a scheduling tick or two more on the host.
+
+#include "cat.h"
+#include "cat_sim.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+#include "gpio.h"
+#include "host_port.h"
+#include "radio.h"
+#include "radio_cache.h"
+#include "sdkconfig.h"
+#include "test.h"
+#include "tune.h"
+#include <string.h>
+
+#ifdef CONFIG_RADIO_PROTOCOL_FT857D
+#define PROTOCOL "FT-857D"
+#define READ_BYTES (5 + 5) // Command, then four BCD bytes and the mode
+#else
+#define PROTOCOL "FT-991A"
+#define READ_BYTES (3 + 12) // "FA;", then "FA014074000;"
+#endif
+
+#define READS 50
+#define MEMORY_READS 40
+#define TICK_US (portTICK_PERIOD_MS * 1000)
+
+// tune.c keys the transmitter; the key line is not part of this test
+static bool key_is_down = false;
+void key_down(void) { key_is_down = true; }
+void key_up(void) { key_is_down = false; }
+
+static uint32_t line_time_us(size_t bytes) {
+    return bytes * 10 * 1000000ULL / CONFIG_RADIO_SIMULATOR_BAUD_RATE;
+}
+
+static bool wait_for_radio(void) {
+    uint32_t frequency;
+    for (int i = 0; i < 50; i++) {
+        if (get_frequency(&frequency) == ESP_OK) {
+            return true;
+        }
+        vTaskDelay(pdMS_TO_TICKS(100));
+    }
+    return false;
+}
+
+static void check_round_trips(void) {
+    uint32_t frequency = 0;
+    uint8_t mode = 0xFF;
+
+    CHECK_EQ(set_frequency(7030000), ESP_OK);
+    CHECK_EQ(get_frequency(&frequency), ESP_OK);
+    CHECK_EQ(frequency, 7030000);
+
+    CHECK_EQ(set_mode(string_to_mode("CW")), ESP_OK);
+    CHECK_EQ(get_mode(&mode), ESP_OK);
+    CHECK(strcmp(mode_to_string(mode), "CW") == 0);
+
+    CHECK_EQ(set_mode_power_frequency(string_to_mode("USB"), 20, 14074000,
+                                      RADIO_SET_MODE | RADIO_SET_POWER | RADIO_SET_FREQUENCY),
+             ESP_OK);
+    CHECK_EQ(get_frequency_and_mode(&frequency, &mode), ESP_OK);
+    CHECK_EQ(frequency, 14074000);
+    CHECK(strcmp(mode_to_string(mode), "USB") == 0);
+}
+
+// Back-to-back frequency reads, one in flight at a time
+static void benchmark_reads(void) {
+    uint32_t frequency;
+    int64_t min_us = INT64_MAX;
+    int64_t max_us = 0;
+
+    int64_t start_us = esp_timer_get_time();
+    for (int i = 0; i < READS; i++) {
+        int64_t begin_us = esp_timer_get_time();
+        CHECK_EQ(get_frequency(&frequency), ESP_OK);
+        int64_t took_us = esp_timer_get_time() - begin_us;
+        min_us = took_us < min_us ? took_us : min_us;
+        max_us = took_us > max_us ? took_us : max_us;
+    }
+    int64_t mean_us = (esp_timer_get_time() - start_us) / READS;
+
+    uint32_t floor_us = line_time_us(READ_BYTES) + CONFIG_RADIO_SIMULATOR_LATENCY_US;
+    printf("%s reads: %.1f/s, %lld us each (min %lld, max %lld), line and latency %lu us\n", PROTOCOL,
+           1e6 / mean_us, (long long)mean_us, (long long)min_us, (long long)max_us, (unsigned long)floor_us);
+    CHECK(min_us >= floor_us - TICK_US);
+    CHECK(mean_us <= floor_us + 3 * TICK_US);
+}
+
+// No more than the client's queue holds, however late the CAT task takes them; that
+// still fills the pipeline
+#define IN_FLIGHT CAT_CLIENT_QUEUE_LENGTH
+
+static SemaphoreHandle_t memory_results;
+static volatile int memory_failed;
+
+static void memory_read_done(esp_err_t result, const uint8_t *response, size_t length, void *arg) {
+    radio_memory_t memory;
+    esp_err_t err = memory_decode((uint16_t)(uintptr_t)arg, result, response, length, &memory);
+    if (err != ESP_OK && err != ESP_ERR_NOT_FOUND) {
+        memory_failed++;
+    }
+    xSemaphoreGive(memory_results);
+}
+
+// Pipelined memory reads, as the backup makes them, against the same reads one at a time
+static void benchmark_memory_reads(void) {
+    if (memory_channel_count() == 0) {
+        printf("%s has no memory channel access\n", PROTOCOL);
+        return;
+    }
+    memory_results = xSemaphoreCreateCounting(MEMORY_READS, 0);
+
+    int64_t sequential_us = 0;
+    for (int pass = 0; pass < 2; pass++) {
+        bool pipelined = pass == 1;
+        int limit = pipelined ? IN_FLIGHT : 1;
+        int in_flight = 0;
+        int done = 0;
+        memory_failed = 0;
+
+        int64_t start_us = esp_timer_get_time();
+        for (uint16_t channel = 1; channel <= MEMORY_READS || in_flight > 0;) {
+            if (channel <= MEMORY_READS && in_flight < limit) {
+                cat_request_t request;
+                CHECK_EQ(memory_read_request(channel, &request), ESP_OK);
+                request.callback = memory_read_done;
+                request.arg = (void *)(uintptr_t)channel;
+                request.pipelined = pipelined;
+                if (!CHECK_EQ(cat_submit(&request), ESP_OK)) {
+                    break;
+                }
+                channel++;
+                in_flight++;
+                continue;
+            }
+            if (!CHECK(xSemaphoreTake(memory_results, pdMS_TO_TICKS(5000)) == pdTRUE)) {
+                break;
+            }
+            in_flight--;
+            done++;
+        }
+        int64_t took_us = esp_timer_get_time() - start_us;
+        CHECK_EQ(done, MEMORY_READS);
+        CHECK_EQ(memory_failed, 0);
+
+        printf("%s %s memory reads: %d in %lld ms, %.1f/s\n", PROTOCOL, pipelined ? "pipelined" : "one at a time",
+               MEMORY_READS, (long long)took_us / 1000, MEMORY_READS * 1e6 / took_us);
+        if (!pipelined) {
+            sequential_us = took_us;
+        } else {
+            CHECK(took_us < sequential_us);
+        }
+    }
+}
+
+// A long press: save the radio's settings, switch to the tune settings and key down,
+// then put everything back on release
+static void benchmark_tune(void) {
+    tune_data_t tune_data;
+    cat_stats_t before, after;
+    uint32_t frequency;
+    uint8_t mode;
+
+    CHECK_EQ(set_mode_power_frequency(string_to_mode("USB"), 20, 14074000, RADIO_SET_MODE | RADIO_SET_FREQUENCY),
+             ESP_OK);
+    radio_cache_invalidate(); // As after a while without CAT traffic
+
+    cat_get_stats(&before);
+    int64_t start_us = esp_timer_get_time();
+    tune_start(&tune_data);
+    int64_t start_took_us = esp_timer_get_time() - start_us;
+    cat_get_stats(&after);
+    uint32_t start_requests = after.requests - before.requests;
+
+    CHECK(key_is_down);
+    CHECK_EQ(get_frequency_and_mode(&frequency, &mode), ESP_OK);
+    CHECK_EQ(frequency, 14074000 + 3000);
+    CHECK(strcmp(mode_to_string(mode), "CW") == 0);
+
+    cat_get_stats(&before);
+    start_us = esp_timer_get_time();
+    tune_stop(&tune_data);
+    int64_t stop_took_us = esp_timer_get_time() - start_us;
+    cat_get_stats(&after);
+    uint32_t stop_requests = after.requests - before.requests;
+
+    CHECK(!key_is_down);
+    CHECK_EQ(get_frequency_and_mode(&frequency, &mode), ESP_OK);
+    CHECK_EQ(frequency, 14074000);
+    CHECK(strcmp(mode_to_string(mode), "USB") == 0);
+
+    printf("%s tune: start %lld ms in %lu requests, stop %lld ms in %lu requests\n", PROTOCOL,
+           (long long)start_took_us / 1000, (unsigned long)start_requests, (long long)stop_took_us / 1000,
+           (unsigned long)stop_requests);
+}
+
+int main(void) {
+    port_init();
+    CHECK_EQ(init_radio(), ESP_OK);
+    cat_register_client("test", CAT_PRIORITY_NORMAL);
+    if (!CHECK(wait_for_radio())) {
+        return test_result();
+    }
+
+    check_round_trips();
+    benchmark_reads();
+    benchmark_memory_reads();
+    benchmark_tune();
+    return test_result();
+}
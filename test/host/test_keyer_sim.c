@@ -0,0 +1,162 @@
+// Timing check of the simulated keyer: schedules compiled from text come out with every
+// edge where the reference says, at any speed, and live keying is stepped with no more
+// than timer latency on each element.
+
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "host_port.h"
+#include "keyer.h"
+#include "settings.h"
+#include "test.h"
+#include "timeline.h"
+#include "timing.h"
+#include <stdlib.h>
+#include <string.h>
+
+// Live keying is stepped by a timer thread, so each element is late by the host's wakeup
+// latency; this only catches gross errors such as an element skipped or run twice
+#define LIVE_JITTER_LIMIT_US 20000
+
+// "PAR IS" written out by hand, one letter per string, words apart
+static const char *const reference[] = {".--.", ".-", ".-.", " ", "..", "..."};
+#define REFERENCE_TEXT "PAR IS"
+
+static keyer_run_t expected[TIMELINE_MAX_RUNS];
+static size_t expected_count;
+
+static void expect(bool level, uint32_t duration_us) {
+    expected[expected_count].level = level;
+    expected[expected_count].duration_us = duration_us;
+    expected_count++;
+}
+
+// The reference schedule: marks for each element, with element, letter and word gaps
+static void build_reference(const morse_timing_t *timing) {
+    expected_count = 0;
+    for (size_t i = 0; i < sizeof(reference) / sizeof(reference[0]); i++) {
+        if (reference[i][0] == ' ') {
+            expect(false, timing->word_gap_us);
+            continue;
+        }
+        if (i > 0 && reference[i - 1][0] != ' ') {
+            expect(false, timing->letter_gap_us);
+        }
+        for (const char *element = reference[i]; *element != '\0'; element++) {
+            if (element != reference[i]) {
+                expect(false, timing->element_gap_us);
+            }
+            expect(true, *element == '-' ? timing->dah_us : timing->dit_us);
+        }
+    }
+}
+
+// Play the text at `speed` and compare every recorded edge with the reference
+static void check_schedule(int speed) {
+    static timeline_t timeline;
+    const keyer_sim_edge_t *edges;
+
+    wpm = speed;
+    CHECK_EQ(timeline_compile(&timeline, REFERENCE_TEXT), ESP_OK);
+    build_reference(&timeline.timing);
+
+    int64_t start_us = esp_timer_get_time();
+    CHECK_EQ(keyer_play(timeline.runs, timeline.count, true), ESP_OK);
+    int64_t elapsed_us = esp_timer_get_time() - start_us;
+
+    size_t edge_count = keyer_sim_get_edges(&edges);
+    CHECK_EQ(edge_count, expected_count + 1); // Each run starts with an edge, plus the final key-up
+
+    uint32_t time_us = 0;
+    uint32_t worst_us = 0;
+    uint32_t dit_min_us = UINT32_MAX;
+    uint32_t dit_max_us = 0;
+    for (size_t i = 0; i < expected_count && i < edge_count; i++) {
+        uint32_t error_us = abs((int32_t)(edges[i].time_us - time_us));
+        worst_us = error_us > worst_us ? error_us : worst_us;
+        CHECK_EQ(edges[i].level, expected[i].level);
+        if (expected[i].level && expected[i].duration_us == timeline.timing.dit_us && i + 1 < edge_count) {
+            uint32_t dit_us = edges[i + 1].time_us - edges[i].time_us;
+            dit_min_us = dit_us < dit_min_us ? dit_us : dit_min_us;
+            dit_max_us = dit_us > dit_max_us ? dit_us : dit_max_us;
+        }
+        time_us += expected[i].duration_us;
+    }
+    if (edge_count > expected_count) {
+        CHECK_EQ(edges[expected_count].time_us, time_us);
+        CHECK_EQ(edges[expected_count].level, false);
+    }
+    CHECK_EQ(worst_us, 0);
+    CHECK_EQ(dit_max_us - dit_min_us, 0);
+
+    // The caller is held for the length of the schedule, give or take a tick
+    int64_t tick_us = portTICK_PERIOD_MS * 1000;
+    CHECK(elapsed_us >= (int64_t)time_us - 2 * tick_us);
+    CHECK(elapsed_us <= (int64_t)time_us + 5 * tick_us);
+
+    printf("%2d WPM: %zu edges over %lu us, worst edge error %lu us, dit spread %lu us, played in %lld us\n", speed,
+           edge_count, (unsigned long)time_us, (unsigned long)worst_us, (unsigned long)(dit_max_us - dit_min_us),
+           (long long)elapsed_us);
+}
+
+// Live keying takes runs one at a time from the source, as the paddles supply them
+static size_t live_index;
+
+static bool live_source(keyer_run_t *run) {
+    if (live_index >= expected_count) {
+        return false;
+    }
+    *run = expected[live_index++];
+    return true;
+}
+
+static void check_live(int speed) {
+    const keyer_sim_edge_t *edges;
+    morse_timing_t timing;
+
+    timing_compute(&timing, speed, 0, DAH_RATIO_DEFAULT, WEIGHT_DEFAULT);
+    build_reference(&timing);
+    uint32_t total_us = 0;
+    for (size_t i = 0; i < expected_count; i++) {
+        total_us += expected[i].duration_us;
+    }
+
+    live_index = 0;
+    keyer_set_live_source(live_source);
+    CHECK(!keyer_start_live_from_isr()); // Nothing was playing to break in on
+
+    vTaskDelay(pdMS_TO_TICKS(50));
+    CHECK_EQ(keyer_play(expected, expected_count, true), ESP_ERR_INVALID_STATE); // The paddles have the key
+    CHECK_EQ(keyer_live_idle_us(), 0);
+    vTaskDelay(pdMS_TO_TICKS(total_us / 1000 + 200));
+    int64_t idle_us = keyer_live_idle_us();
+    CHECK(idle_us > 0 && idle_us < 400000); // Ran dry at the end of the reference
+
+    size_t edge_count = keyer_sim_get_edges(&edges);
+    CHECK_EQ(edge_count, expected_count + 1);
+
+    uint32_t worst_us = 0;
+    for (size_t i = 0; i + 1 < edge_count && i < expected_count; i++) {
+        int32_t error_us = (int32_t)(edges[i + 1].time_us - edges[i].time_us) - (int32_t)expected[i].duration_us;
+        uint32_t jitter_us = abs(error_us);
+        worst_us = jitter_us > worst_us ? jitter_us : worst_us;
+    }
+    CHECK(worst_us < LIVE_JITTER_LIMIT_US);
+    printf("Live at %d WPM: %zu edges, worst element error %lu us\n", speed, edge_count, (unsigned long)worst_us);
+    keyer_set_live_source(NULL);
+}
+
+int main(void) {
+    port_init();
+    CHECK_EQ(keyer_init(), ESP_OK);
+    CHECK(keyer_live_idle_us() > 0); // The paddles have never had the key
+
+    // With ticks of 10 ms a tick-timed dit at 40 WPM could only be 20 or 30 ms long
+    static const int speeds[] = {20, 30, 40, 50};
+    for (size_t i = 0; i < sizeof(speeds) / sizeof(speeds[0]); i++) {
+        check_schedule(speeds[i]);
+    }
+
+    check_live(30);
+    return test_result();
+}
@@ -0,0 +1,238 @@
+// The morse task keying through the PTT sequencer, with the simulated keyer and the
+// FT-991A driver over the simulated radio. A message waits out the PTT lead-in before its
+// first element, type-ahead latency is measured to the key-down, and an abort that
+// arrives during the lead-in stops a message or a typed character before it is keyed.
+// The web server is not built here: the endpoints morse.c registers are stubbed below,
+// and typing goes through its WebSocket handler.
+
+#include "cJSON.h"
+#include "contest.h"
+#include "esp_http_server.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "gpio.h"
+#include "host_port.h"
+#include "http.h"
+#include "keyer.h"
+#include "message.h"
+#include "morse.h"
+#include "ptt.h"
+#include "radio.h"
+#include "settings.h"
+#include "sidetone.h"
+#include "test.h"
+#include <string.h>
+
+#define LEAD_MS 300        // Long enough to abort well inside it
+#define ABORT_AFTER_MS 100 // PTT is on by then and the lead-in still running
+#define IDLE_TIMEOUT_MS 3000
+
+static esp_err_t (*ws_handler)(httpd_req_t *req);
+static const char *ws_text; // The next WebSocket frame
+
+static bool wait_for_radio(void) {
+    uint32_t frequency;
+    for (int i = 0; i < 50; i++) {
+        if (get_frequency(&frequency) == ESP_OK) {
+            return true;
+        }
+        vTaskDelay(pdMS_TO_TICKS(100));
+    }
+    return false;
+}
+
+static bool wait_until_idle(void) {
+    morse_status_t status;
+    ptt_status_t ptt;
+
+    for (int i = 0; i < IDLE_TIMEOUT_MS / 10; i++) {
+        morse_get_status(&status);
+        ptt_get_status(&ptt);
+        if (!status.busy && !ptt.on) {
+            return true;
+        }
+        vTaskDelay(pdMS_TO_TICKS(10));
+    }
+    return false;
+}
+
+static size_t edges_keyed(void) {
+    const keyer_sim_edge_t *edges;
+    return keyer_sim_get_edges(&edges);
+}
+
+static void type_text(const char *text) {
+    httpd_req_t req = {.method = HTTP_POST};
+    ws_text = text;
+    CHECK_EQ(ws_handler(&req), ESP_OK);
+}
+
+// The first element only goes out once PTT has been on for the lead-in
+static void check_keyed_after_lead(void) {
+    CHECK(wait_until_idle());
+    int64_t start_us = esp_timer_get_time();
+    CHECK_EQ(queue_morse_code("E", true, false), ESP_OK);
+    vTaskDelay(pdMS_TO_TICKS(10));
+    CHECK(wait_until_idle());
+
+    int64_t elapsed_ms = (esp_timer_get_time() - start_us) / 1000;
+    printf("E keyed and PTT released after %lld ms, lead-in %d ms\n", (long long)elapsed_ms, LEAD_MS);
+    CHECK(elapsed_ms >= LEAD_MS);
+    CHECK_EQ(edges_keyed(), 2); // Down and up
+}
+
+// Abort while the lead-in runs: the morse task lets go at once and the keyer still has
+// the last schedule it played, so nothing new was keyed
+static void check_abort_during_lead(const char *what, void (*send)(void)) {
+    ptt_status_t before, after;
+    morse_status_t status;
+
+    CHECK(wait_until_idle());
+    size_t edges = edges_keyed();
+    ptt_get_status(&before);
+    send();
+    vTaskDelay(pdMS_TO_TICKS(ABORT_AFTER_MS));
+    ptt_get_status(&after);
+    CHECK_EQ(after.transmissions - before.transmissions, 1); // In the lead-in, not yet keying
+    int64_t abort_us = esp_timer_get_time();
+    morse_abort();
+    CHECK(wait_until_idle());
+
+    int64_t elapsed_ms = (esp_timer_get_time() - abort_us) / 1000;
+    morse_get_status(&status);
+    printf("%s aborted in the lead-in: idle %lld ms later, %u edges keyed since\n", what, (long long)elapsed_ms,
+           (unsigned)(edges_keyed() - edges));
+    CHECK_EQ(edges_keyed(), edges);
+    CHECK_EQ(status.typeahead_pending, 0);
+    CHECK(elapsed_ms < LEAD_MS + 500); // Lead-in and PTT off, but not the message
+}
+
+// Type-ahead latency runs to the key-down, so it takes in the lead-in
+static void check_typed_latency(void) {
+    morse_status_t status;
+
+    CHECK(wait_until_idle());
+    type_text("E");
+    vTaskDelay(pdMS_TO_TICKS(10));
+    CHECK(wait_until_idle());
+
+    morse_get_status(&status);
+    printf("Typed E keyed %lu us after it arrived\n", (unsigned long)status.typeahead_latency_us);
+    CHECK_EQ(edges_keyed(), 2);
+    CHECK(status.typeahead_latency_us >= LEAD_MS * 1000);
+    CHECK(status.typeahead_latency_us < (LEAD_MS + 200) * 1000);
+}
+
+static void send_message(void) {
+    CHECK_EQ(queue_morse_code("PARIS PARIS", true, false), ESP_OK);
+}
+
+static void send_typed(void) {
+    type_text("PARIS");
+}
+
+int main(void) {
+    port_init();
+    ptt_enabled = 1;
+    ptt_lead_ms = LEAD_MS;
+    ptt_hang_ms = 0;
+    CHECK_EQ(init_radio(), ESP_OK);
+    if (!CHECK(wait_for_radio())) {
+        return test_result();
+    }
+    CHECK_EQ(ptt_init(), ESP_OK);
+    morse_code_init();
+    register_morse_endpoints();
+    if (!CHECK(ws_handler != NULL)) {
+        return test_result();
+    }
+
+    check_keyed_after_lead();
+    check_typed_latency();
+    check_abort_during_lead("Message", send_message);
+    check_abort_during_lead("Typed character", send_typed);
+    return test_result();
+}
+
+// Hardware and the other modules morse.c calls
+
+void key_init(void) {
+}
+
+void led_init(void) {
+}
+
+esp_err_t sidetone_init(void) {
+    return ESP_OK;
+}
+
+esp_err_t message_get_timeline(int index, timeline_t *timeline, uint32_t *serial) {
+    return ESP_ERR_NOT_FOUND;
+}
+
+void contest_serial_sent(uint32_t serial) {
+}
+
+// The web server: only the type-ahead WebSocket is served, from type_text()
+
+void register_html_page(const char *uri, httpd_method_t method, esp_err_t handler(httpd_req_t *)) {
+}
+
+void register_websocket(const char *uri, esp_err_t handler(httpd_req_t *)) {
+    ws_handler = handler;
+}
+
+esp_err_t httpd_ws_recv_frame(httpd_req_t *req, httpd_ws_frame_t *frame, size_t max_len) {
+    frame->type = HTTPD_WS_TYPE_TEXT;
+    frame->len = strlen(ws_text) < max_len ? strlen(ws_text) : max_len;
+    memcpy(frame->payload, ws_text, frame->len);
+    return ESP_OK;
+}
+
+esp_err_t httpd_ws_send_frame(httpd_req_t *req, httpd_ws_frame_t *frame) {
+    return ESP_OK;
+}
+
+int httpd_req_recv(httpd_req_t *req, char *buf, size_t buf_len) {
+    return 0;
+}
+
+esp_err_t httpd_resp_set_status(httpd_req_t *req, const char *status) {
+    return ESP_OK;
+}
+
+esp_err_t httpd_resp_set_hdr(httpd_req_t *req, const char *field, const char *value) {
+    return ESP_OK;
+}
+
+esp_err_t httpd_resp_set_type(httpd_req_t *req, const char *type) {
+    return ESP_OK;
+}
+
+esp_err_t httpd_resp_send(httpd_req_t *req, const char *buf, ssize_t buf_len) {
+    return ESP_OK;
+}
+
+esp_err_t httpd_resp_send_err(httpd_req_t *req, httpd_err_code_t error, const char *message) {
+    return ESP_OK;
+}
+
+cJSON *cJSON_Parse(const char *value) {
+    return NULL;
+}
+
+void cJSON_Delete(cJSON *item) {
+}
+
+cJSON *cJSON_GetObjectItem(const cJSON *object, const char *string) {
+    return NULL;
+}
+
+cJSON_bool cJSON_IsTrue(const cJSON *item) {
+    return 0;
+}
+
+cJSON_bool cJSON_IsNumber(const cJSON *item) {
+    return 0;
+}
@@ -0,0 +1,171 @@
+// The packed Morse table checked against the table it replaced, copied below as it was
+// before the change. Every character must give the same elements, except where the old
+// scan matched `c - 32` against a symbol: '[' came out as ';', and '_' as '?' because
+// '?' comes first in the table. Those now give nothing, or their own code.
+
+#include "host_port.h"
+#include "morse_code_characters.h"
+#include "test.h"
+#include <string.h>
+
+#define MAX_MORSE_LENGTH 10
+
+typedef struct {
+    char character;
+    int morse[MAX_MORSE_LENGTH];
+} MorseCode;
+
+static const MorseCode morse_table[] = {
+    {'A', {DIT, DAH, END}},
+    {'B', {DAH, DIT, DIT, DIT, END}},
+    {'C', {DAH, DIT, DAH, DIT, END}},
+    {'D', {DAH, DIT, DIT, END}},
+    {'E', {DIT, END}},
+    {'F', {DIT, DIT, DAH, DIT, END}},
+    {'G', {DAH, DAH, DIT, END}},
+    {'H', {DIT, DIT, DIT, DIT, END}},
+    {'I', {DIT, DIT, END}},
+    {'J', {DIT, DAH, DAH, DAH, END}},
+    {'K', {DAH, DIT, DAH, END}},
+    {'L', {DIT, DAH, DIT, DIT, END}},
+    {'M', {DAH, DAH, END}},
+    {'N', {DAH, DIT, END}},
+    {'O', {DAH, DAH, DAH, END}},
+    {'P', {DIT, DAH, DAH, DIT, END}},
+    {'Q', {DAH, DAH, DIT, DAH, END}},
+    {'R', {DIT, DAH, DIT, END}},
+    {'S', {DIT, DIT, DIT, END}},
+    {'T', {DAH, END}},
+    {'U', {DIT, DIT, DAH, END}},
+    {'V', {DIT, DIT, DIT, DAH, END}},
+    {'W', {DIT, DAH, DAH, END}},
+    {'X', {DAH, DIT, DIT, DAH, END}},
+    {'Y', {DAH, DIT, DAH, DAH, END}},
+    {'Z', {DAH, DAH, DIT, DIT, END}},
+    {'1', {DIT, DAH, DAH, DAH, DAH, END}},
+    {'2', {DIT, DIT, DAH, DAH, DAH, END}},
+    {'3', {DIT, DIT, DIT, DAH, DAH, END}},
+    {'4', {DIT, DIT, DIT, DIT, DAH, END}},
+    {'5', {DIT, DIT, DIT, DIT, DIT, END}},
+    {'6', {DAH, DIT, DIT, DIT, DIT, END}},
+    {'7', {DAH, DAH, DIT, DIT, DIT, END}},
+    {'8', {DAH, DAH, DAH, DIT, DIT, END}},
+    {'9', {DAH, DAH, DAH, DAH, DIT, END}},
+    {'0', {DAH, DAH, DAH, DAH, DAH, END}},
+    {'.', {DIT, DAH, DIT, DAH, DIT, DAH, END}},
+    {',', {DAH, DAH, DIT, DIT, DAH, DAH, END}},
+    {'?', {DIT, DIT, DAH, DAH, DIT, DIT, END}},
+    {'\'', {DIT, DAH, DAH, DAH, DAH, DIT, END}},
+    {'!', {DAH, DIT, DAH, DIT, DAH, DAH, END}},
+    {'/', {DAH, DIT, DIT, DAH, DIT, END}},
+    {'(', {DAH, DIT, DAH, DAH, DIT, END}},
+    {')', {DAH, DIT, DAH, DAH, DIT, DAH, END}},
+    {'&', {DIT, DAH, DIT, DIT, DIT, END}},
+    {':', {DAH, DAH, DAH, DIT, DIT, DIT, END}},
+    {';', {DAH, DIT, DAH, DIT, DAH, DIT, END}},
+    {'=', {DAH, DIT, DIT, DIT, DAH, END}},
+    {'+', {DIT, DAH, DIT, DAH, DIT, END}},
+    {'-', {DAH, DIT, DIT, DIT, DIT, DAH, END}},
+    {'_', {DIT, DIT, DAH, DAH, DIT, DAH, END}},
+    {'"', {DIT, DAH, DIT, DIT, DAH, DIT, END}},
+    {'$', {DIT, DIT, DIT, DAH, DIT, DIT, DAH, END}},
+    {'@', {DIT, DAH, DAH, DIT, DAH, DIT, END}}};
+
+// The old lookup, with its static buffer
+static int *original_char_to_morse(char c) {
+    static int morse_code[MAX_MORSE_LENGTH];
+    memset(morse_code, 0, sizeof(morse_code));
+
+    for (int i = 0; i < sizeof(morse_table) / sizeof(MorseCode); i++) {
+        if (morse_table[i].character == c || morse_table[i].character == c - 32) {
+            memcpy(morse_code, morse_table[i].morse, sizeof(morse_table[i].morse));
+            break;
+        }
+    }
+
+    return morse_code;
+}
+
+// The entry the old scan meant to find: the character itself, or a lowercase letter's
+// uppercase form
+static const MorseCode *intended_entry(char c) {
+    for (size_t i = 0; i < sizeof(morse_table) / sizeof(MorseCode); i++) {
+        if (morse_table[i].character == c || (c >= 'a' && c <= 'z' && morse_table[i].character == c - 32)) {
+            return &morse_table[i];
+        }
+    }
+    return NULL;
+}
+
+static int element_count(const int *morse) {
+    int count = 0;
+    while (count < MAX_MORSE_LENGTH && morse[count] != END) {
+        count++;
+    }
+    return count;
+}
+
+// True if the packed code has exactly the old element list
+static bool same_elements(morse_code_t code, const int *morse) {
+    int count = element_count(morse);
+
+    if (morse_length(code) != count) {
+        return false;
+    }
+    for (int i = 0; i < count; i++) {
+        if (morse_element(code, i) != morse[i]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+int main(void) {
+    int matched = 0;
+    int corrected = 0;
+
+    port_init();
+
+    for (int i = -128; i < 128; i++) {
+        char c = (char)i;
+        morse_code_t code = char_to_morse(c);
+        const MorseCode *entry = intended_entry(c);
+        int original[MAX_MORSE_LENGTH];
+        memcpy(original, original_char_to_morse(c), sizeof(original));
+
+        if (entry == NULL) {
+            if (!CHECK_EQ(code, MORSE_NONE)) {
+                printf("  for character 0x%02x\n", (unsigned char)c);
+            }
+            if (element_count(original) > 0) {
+                corrected++; // Matched a symbol through `c - 32`
+            }
+            continue;
+        }
+
+        if (!CHECK(same_elements(code, entry->morse))) {
+            printf("  for character '%c'\n", c);
+        }
+        if (same_elements(code, original)) {
+            matched++;
+        } else {
+            corrected++; // The scan reached `c - 32` first, e.g. '?' for '_'
+        }
+
+        // The decoder maps the code back to the uppercase character
+        char upper = c >= 'a' && c <= 'z' ? c - 32 : c;
+        CHECK_EQ(morse_to_char(code), upper);
+    }
+
+    // Every code fits the packing, and no two characters share one
+    for (size_t i = 0; i < sizeof(morse_table) / sizeof(MorseCode); i++) {
+        CHECK(element_count(morse_table[i].morse) <= MORSE_MAX_ELEMENTS);
+        for (size_t j = i + 1; j < sizeof(morse_table) / sizeof(MorseCode); j++) {
+            CHECK(char_to_morse(morse_table[i].character) != char_to_morse(morse_table[j].character));
+        }
+    }
+    CHECK_EQ(morse_to_char(MORSE_NONE), '\0');
+
+    printf("%d characters match the original lookup, %d false matches of the old scan corrected\n", matched, corrected);
+    return test_result();
+}
@@ -0,0 +1,245 @@
+// The rigctld server as a Hamlib client sees it: rigctl commands over TCP to the server
+// on its port, with the FT-991A driver, the radio cache and the PTT sequencer over the
+// simulated radio. Checks the replies, that PTT is shared with the keyer, that a program
+// waiting on the radio does not hold up another, and that connections past
+// RIGCTLD_MAX_CONNECTIONS are turned away. There is no rigctl here, so the test speaks
+// the protocol itself.
+
+#include "cat.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "host_port.h"
+#include "lwip/sockets.h"
+#include "ptt.h"
+#include "radio.h"
+#include "rigctld.h"
+#include "settings.h"
+#include "test.h"
+#include <string.h>
+#include <sys/time.h>
+
+#define REPLY_SIZE 512 // Room for the state dump
+#define HOLD_MS 300      // A CAT session long enough to see who waits for it
+
+static int connect_client(void) {
+    int sock = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    struct sockaddr_in address = {
+        .sin_family = AF_INET,
+        .sin_port = htons(RIGCTLD_PORT),
+        .sin_addr.s_addr = htonl(INADDR_LOOPBACK),
+    };
+    struct timeval timeout = {.tv_sec = 3};
+
+    setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    if (connect(sock, (struct sockaddr *)&address, sizeof(address)) != 0) {
+        close(sock);
+        return -1;
+    }
+    return sock;
+}
+
+static void send_text(int sock, const char *text) {
+    send(sock, text, strlen(text), 0);
+}
+
+// Read until `lines` lines have arrived; false on timeout or a closed connection
+static bool read_lines(int sock, char *reply, int lines) {
+    size_t length = 0;
+
+    reply[0] = '\0';
+    while (lines > 0) {
+        int received = recv(sock, reply + length, 1, 0);
+        if (received <= 0 || length == REPLY_SIZE - 2) {
+            return false;
+        }
+        lines -= reply[length] == '\n';
+        reply[++length] = '\0';
+    }
+    return true;
+}
+
+// Send a command and compare its reply
+static bool expect(int sock, const char *command, const char *expected) {
+    char reply[REPLY_SIZE];
+    int lines = 0;
+
+    for (const char *c = expected; *c != '\0'; c++) {
+        lines += *c == '\n';
+    }
+    send_text(sock, command);
+    bool ok = read_lines(sock, reply, lines);
+    if (!CHECK(ok && strcmp(reply, expected) == 0)) {
+        printf("  %s", command);
+        printf("  got \"%s\", expected \"%s\"\n", reply, expected);
+        return false;
+    }
+    return true;
+}
+
+static bool wait_for_radio(void) {
+    uint32_t frequency;
+    for (int i = 0; i < 50; i++) {
+        if (get_frequency(&frequency) == ESP_OK) {
+            return true;
+        }
+        vTaskDelay(pdMS_TO_TICKS(100));
+    }
+    return false;
+}
+
+// True once the server has closed the connection
+static bool closed_by_server(int sock) {
+    char c;
+    return recv(sock, &c, 1, 0) == 0;
+}
+
+static void wait_for_connections(uint32_t open) {
+    rigctld_stats_t stats;
+    for (int i = 0; i < 100; i++) {
+        rigctld_get_stats(&stats);
+        if (stats.connections == open) {
+            return;
+        }
+        vTaskDelay(1);
+    }
+    CHECK_EQ(stats.connections, open);
+}
+
+static void check_commands(int sock) {
+    char reply[REPLY_SIZE];
+
+    expect(sock, "t\n", "0\n"); // Never keyed: receiving, not an error
+    expect(sock, "\\get_ptt\n", "0\n");
+
+    expect(sock, "F 14074000\n", "RPRT 0\n");
+    expect(sock, "f\n", "14074000\n");
+    expect(sock, "M USB 0\n", "RPRT 0\n");
+    expect(sock, "m\n", "USB\n0\n");
+    expect(sock, "\\set_mode CW 500\n", "RPRT 0\n");
+    expect(sock, "\\get_mode\n", "CW\n0\n");
+    expect(sock, "L RFPOWER 0.5\n", "RPRT 0\n");
+    expect(sock, "l RFPOWER\n", "0.500000\n");
+
+    expect(sock, "T 1\n", "RPRT 0\n");
+    expect(sock, "t\n", "1\n");
+    expect(sock, "T 0\n", "RPRT 0\n");
+    expect(sock, "t\n", "0\n");
+
+    expect(sock, "v\n", "VFOA\n");
+    expect(sock, "\\chk_vfo\n", "0\n");
+    expect(sock, "F abc\n", "RPRT -1\n");
+    expect(sock, "M XYZ 0\n", "RPRT -1\n");
+    expect(sock, "L AF 0.5\n", "RPRT -1\n");
+    expect(sock, "y\n", "RPRT -4\n");
+
+    // The state dump netrigctl opens with: protocol version 0, model 2, and on to the
+    // set parameters
+    send_text(sock, "\\dump_state\n");
+    CHECK(read_lines(sock, reply, 27));
+    CHECK(strncmp(reply, "0\n2\n2\n", 6) == 0);
+}
+
+// PTT held for a message reads as on, and a program going back to receive does not drop
+// it under the message
+static void check_ptt_shared(int sock) {
+    ptt_enabled = 1;
+    CHECK_EQ(ptt_begin(PTT_SOURCE_MORSE), ESP_OK);
+    expect(sock, "t\n", "1\n");
+    expect(sock, "T 1\n", "RPRT 0\n");
+    expect(sock, "T 0\n", "RPRT 0\n");
+    expect(sock, "t\n", "1\n");
+
+    ptt_hang_ms = 0;
+    ptt_end(PTT_SOURCE_MORSE);
+    vTaskDelay(pdMS_TO_TICKS(ptt_tail_ms + 100));
+    expect(sock, "t\n", "0\n");
+    ptt_enabled = 0;
+}
+
+// While the radio is held, as for a tune, one program's write waits for it; another's
+// read, answered from the cache, does not wait behind it
+static void check_connections_independent(void) {
+    char reply[REPLY_SIZE];
+    int busy = connect_client();
+    int other = connect_client();
+    if (!CHECK(busy >= 0 && other >= 0)) {
+        return;
+    }
+    expect(other, "m\n", "CW\n0\n"); // Fresh in the cache
+
+    CHECK_EQ(cat_begin(), ESP_OK);
+    int64_t start_us = esp_timer_get_time();
+    send_text(busy, "F 7030000\n");
+    vTaskDelay(pdMS_TO_TICKS(50)); // Let it reach the CAT queue
+    int64_t other_start_us = esp_timer_get_time();
+    send_text(other, "m\n");
+    CHECK(read_lines(other, reply, 2));
+    int64_t other_us = esp_timer_get_time() - other_start_us;
+
+    vTaskDelay(pdMS_TO_TICKS(HOLD_MS) - (esp_timer_get_time() - start_us) / 1000 / portTICK_PERIOD_MS);
+    cat_end();
+    CHECK(read_lines(busy, reply, 1) && strcmp(reply, "RPRT 0\n") == 0);
+    int64_t busy_us = esp_timer_get_time() - start_us;
+
+    printf("Radio held %d ms: write answered after %lld ms, cached read on another connection in %lld us\n", HOLD_MS,
+           (long long)busy_us / 1000, (long long)other_us);
+    CHECK(other_us < HOLD_MS * 1000 / 4);
+    CHECK(busy_us >= HOLD_MS * 1000);
+
+    close(busy);
+    close(other);
+}
+
+static void check_connection_limit(void) {
+    int socks[RIGCTLD_MAX_CONNECTIONS];
+    rigctld_stats_t before, after;
+
+    wait_for_connections(0);
+    rigctld_get_stats(&before);
+    for (int i = 0; i < RIGCTLD_MAX_CONNECTIONS; i++) {
+        socks[i] = connect_client();
+        CHECK(socks[i] >= 0);
+        expect(socks[i], "v\n", "VFOA\n"); // Served, so it has a connection task
+    }
+
+    int extra = connect_client();
+    CHECK(extra >= 0 && closed_by_server(extra));
+    close(extra);
+
+    // Quitting frees the connection for the next program
+    send_text(socks[0], "q\n");
+    CHECK(closed_by_server(socks[0]));
+    close(socks[0]);
+    wait_for_connections(RIGCTLD_MAX_CONNECTIONS - 1);
+    socks[0] = connect_client();
+    expect(socks[0], "v\n", "VFOA\n");
+
+    rigctld_get_stats(&after);
+    CHECK_EQ(after.accepted - before.accepted, RIGCTLD_MAX_CONNECTIONS + 1);
+    CHECK_EQ(after.rejected - before.rejected, 1);
+    for (int i = 0; i < RIGCTLD_MAX_CONNECTIONS; i++) {
+        close(socks[i]);
+    }
+}
+
+int main(void) {
+    port_init();
+    CHECK_EQ(init_radio(), ESP_OK);
+    cat_register_client("test", CAT_PRIORITY_NORMAL);
+    if (!CHECK(wait_for_radio()) || !CHECK_EQ(ptt_init(), ESP_OK) || !CHECK_EQ(rigctld_init(), ESP_OK)) {
+        return test_result();
+    }
+
+    int sock = connect_client();
+    if (!CHECK(sock >= 0)) {
+        return test_result();
+    }
+    check_commands(sock);
+    check_ptt_shared(sock);
+    close(sock);
+
+    check_connections_independent();
+    check_connection_limit();
+    return test_result();
+}
@@ -0,0 +1,142 @@
+// Prosign timelines: <AR>, <BT>, <KN> and <SK> come out as one letter with only element
+// gaps inside, matching timelines written by hand, and templates with prosigns around and
+// between macros expand to exactly what compiling the expanded text gives.
+
+#include "contest.h"
+#include "settings.h"
+#include "template.h"
+#include "test.h"
+#include "timeline.h"
+#include "timing.h"
+#include <stdio.h>
+#include <string.h>
+
+// contest.c needs the web server, so the few calls templates make are answered here
+void contest_get_call(char *call, size_t size) { snprintf(call, size, "K1ABC"); }
+void contest_get_rst(char *rst, size_t size) { snprintf(rst, size, "5NN"); }
+uint32_t contest_get_serial(void) { return 7; }
+uint32_t contest_get_last_serial(void) { return 6; }
+void contest_format_serial(uint32_t serial, uint8_t cut, char *text, size_t size) {
+    snprintf(text, size, "%03lu", (unsigned long)serial);
+}
+
+typedef struct {
+    const char *text;
+    const char *const letters[16]; // One string per letter, " " between words
+} reference_t;
+
+static const reference_t references[] = {
+    {"<AR>", {".-.-."}},
+    {"<BT>", {"-...-"}},
+    {"<KN>", {"-.--."}},
+    {"<SK>", {"...-.-"}},
+    {"CQ DE N7GET <KN>",
+     {"-.-.", "--.-", " ", "-..", ".", " ", "-.", "--...", "--.", ".", "-", " ", "-.--."}},
+    {"TU <SK>", {"-", "..-", " ", "...-.-"}},
+    {"R<AR>", {".-.", ".-.-."}},
+    {"<BT>5NN", {"-...-", ".....", "-.", "-."}},
+};
+
+static keyer_run_t expected[TIMELINE_MAX_RUNS];
+static size_t expected_count;
+
+static void expect(bool level, uint32_t duration_us) {
+    expected[expected_count].level = level;
+    expected[expected_count].duration_us = duration_us;
+    expected_count++;
+}
+
+static void build_reference(const reference_t *reference, const morse_timing_t *timing) {
+    expected_count = 0;
+    for (size_t i = 0; reference->letters[i] != NULL; i++) {
+        const char *letter = reference->letters[i];
+        if (letter[0] == ' ') {
+            expect(false, timing->word_gap_us);
+            continue;
+        }
+        if (i > 0 && reference->letters[i - 1][0] != ' ') {
+            expect(false, timing->letter_gap_us);
+        }
+        for (const char *element = letter; *element != '\0'; element++) {
+            if (element != letter) {
+                expect(false, timing->element_gap_us);
+            }
+            expect(true, *element == '-' ? timing->dah_us : timing->dit_us);
+        }
+    }
+}
+
+static bool same_runs(const timeline_t *timeline, const keyer_run_t *runs, size_t count) {
+    if (timeline->count != count) {
+        return false;
+    }
+    for (size_t i = 0; i < count; i++) {
+        if (timeline->runs[i].level != runs[i].level || timeline->runs[i].duration_us != runs[i].duration_us) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static void check_reference(const reference_t *reference) {
+    static timeline_t timeline;
+
+    CHECK_EQ(timeline_compile(&timeline, reference->text), ESP_OK);
+    build_reference(reference, &timeline.timing);
+    if (!same_runs(&timeline, expected, expected_count)) {
+        printf("\"%s\": %zu runs, reference has %zu\n", reference->text, timeline.count, expected_count);
+        CHECK(false);
+    }
+}
+
+typedef struct {
+    const char *source;
+    const char *expanded; // With K1ABC, N7GET and 5NN for {CALL}, {MYCALL} and {RST}
+} expansion_t;
+
+static const expansion_t expansions[] = {
+    {"{CALL} <BT> {RST}", "K1ABC <BT> 5NN"},
+    {"CQ {MYCALL} <KN>", "CQ N7GET <KN>"},
+    {"{CALL}<KN>", "K1ABC<KN>"},
+    {"<{MYCALL}>", "<N7GET>"},
+    {"<AR{CALL}>", "<ARK1ABC>"},
+    {"<{CALL}>{CALL}", "<K1ABC>K1ABC"},
+    {"{CALL}<>{CALL}", "K1ABC<>K1ABC"},
+    {"<A{CALL}B>{RST}<SK>", "<AK1ABCB>5NN<SK>"},
+    {"<{CALL} {RST}> {NR}", "<K1ABC 5NN> 007"},
+};
+
+// Expand `expansion` with room for `run_capacity` compiled runs, so with little room some
+// or all of the text is compiled on send instead
+static void check_expansion(const expansion_t *expansion, size_t run_capacity) {
+    static template_t template;
+    static keyer_run_t runs[TIMELINE_MAX_RUNS];
+    static timeline_t reference;
+    static timeline_t timeline;
+    uint32_t serial;
+
+    CHECK_EQ(template_compile(&template, expansion->source, runs, run_capacity), ESP_OK);
+    CHECK_EQ(template_expand(&template, &timeline, &serial), ESP_OK);
+    CHECK_EQ(timeline_compile(&reference, expansion->expanded), ESP_OK);
+    if (!same_runs(&timeline, reference.runs, reference.count)) {
+        printf("\"%s\" with room for %zu runs: %zu runs, \"%s\" has %zu\n", expansion->source, run_capacity,
+               timeline.count, expansion->expanded, reference.count);
+        CHECK(false);
+    }
+}
+
+int main(void) {
+    strcpy(my_call, "N7GET");
+
+    for (size_t i = 0; i < sizeof(references) / sizeof(references[0]); i++) {
+        check_reference(&references[i]);
+    }
+
+    static const size_t capacities[] = {TIMELINE_MAX_RUNS, 12, 0};
+    for (size_t i = 0; i < sizeof(expansions) / sizeof(expansions[0]); i++) {
+        for (size_t j = 0; j < sizeof(capacities) / sizeof(capacities[0]); j++) {
+            check_expansion(&expansions[i], capacities[j]);
+        }
+    }
+    return test_result();
+}